@@ -6,11 +6,456 @@
  */
 
 #define _GNU_SOURCE
+#include <pthread.h>
+#include <inttypes.h>
+#include <stdatomic.h>
 #include <stdbool.h>
 #include <stdint.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
 #include "gamma.h"
 
+#ifndef GAMMA_SPARSE_FIELDS
+/**
+ * Liczba pól planszy, powyżej której plansza jest przechowywana rzadko.
+ */
+#define GAMMA_SPARSE_FIELDS (UINT64_C(1) << 26)
+#endif
+
+/**
+ * Początkowy rozmiar tablicy haszującej rzadkiej planszy.
+ */
+#define SPARSE_INITIAL_CAPACITY 64
+
+/**
+ * Początkowa liczba miejsc na liście kandydatów do złotego ruchu gracza.
+ */
+#define CANDIDATES_INITIAL_CAPACITY 8
+
+#ifndef GAMMA_PARALLEL_FIELDS
+/**
+ * Liczba pozycji do przejrzenia w gamma_golden_possible, od której
+ * przeglądanie jest dzielone między wątki.
+ */
+#define GAMMA_PARALLEL_FIELDS (UINT64_C(1) << 18)
+#endif
+
+/**
+ * Funkcja wklejana w miejsce każdego wywołania, także bez optymalizacji.
+ * Wywołana ze stałym argumentem @ref layout_t daje osobną kopię kodu dla
+ * danego sposobu przechowywania planszy, bez rozgałęzień na szerokość pól.
+ */
+#define SPECIALIZED static inline __attribute__((always_inline))
+
+#ifdef GAMMA_STATS
+/**
+ * Wykonuje @p code tylko w silniku zbierającym liczniki.
+ */
+#define STATS_ONLY(code) code
+#else
+#define STATS_ONLY(code)
+#endif
+
+/**
+ * Dodaje @p value do licznika @p counter gry @p g. Zapytania tylko do odczytu
+ * też liczą, więc liczniki są atomowe, a stała @p g jest rzutowana.
+ */
+#define STATS_ADD(g, counter, value) STATS_ONLY(atomic_fetch_add_explicit( \
+  &((gamma_t*)(g))->stats.counter, (value), memory_order_relaxed))
+
+/**
+ * Zaczyna mierzyć czas wywołania funkcji interfejsu.
+ */
+#define STATS_START() STATS_ONLY(uint64_t stats_start = stats_clock())
+
+/**
+ * Dolicza wywołanie @p call i jego czas od @ref STATS_START.
+ */
+#define STATS_CALL(g, call) STATS_ONLY(STATS_ADD(g, calls[call], 1); \
+  STATS_ADD(g, ns[call], stats_clock() - stats_start))
+
+#ifdef GAMMA_STATS
+/** @struct stats_counters
+ * Liczniki wewnętrzne silnika, odpowiedniki pól @ref gamma_stats_t.
+ */
+typedef struct stats_counters {
+  _Atomic uint64_t calls[GAMMA_CALLS]; ///< Liczba wywołań funkcji.
+  _Atomic uint64_t ns[GAMMA_CALLS]; ///< Łączny czas wywołań.
+  _Atomic uint64_t find_depth[GAMMA_STATS_FIND_DEPTHS]; ///< Histogram find.
+  _Atomic uint64_t unions; ///< Liczba połączeń obszarów.
+  _Atomic uint64_t split_rebuilds; ///< Liczba przebudów indeksu split.
+  _Atomic uint64_t split_rebuild_cells; ///< Pola odwiedzone przy przebudowach.
+  _Atomic uint64_t golden_scans; ///< Liczba przeglądań planszy.
+  _Atomic uint64_t golden_scan_cells; ///< Pola odwiedzone przy przeglądaniu.
+} stats_counters_t;
+#endif
+
+#if defined(GAMMA_STATS) || defined(GAMMA_TRACE)
+/** @brief Zwraca czas monotoniczny do liczników i śladu.
+ * @return Czas w nanosekundach.
+ */
+static inline uint64_t stats_clock(void) {
+  struct timespec time;
+
+  clock_gettime(CLOCK_MONOTONIC, &time);
+  return (uint64_t)time.tv_sec * 1000000000 + time.tv_nsec;
+}
+#endif
+
+#ifdef GAMMA_TRACE
+#ifndef GAMMA_TRACE_EVENTS
+/**
+ * Liczba zdarzeń w buforze śladu jednego wątku, potęga dwójki. Po jego
+ * zapełnieniu nowe zdarzenia nadpisują najstarsze.
+ */
+#define GAMMA_TRACE_EVENTS (1 << 16)
+#endif
+
+/**
+ * Zapisuje w śladzie początek zdarzenia @p kind z argumentami.
+ */
+#define TRACE_BEGIN(kind, a, b, c) trace_record(kind, 0, a, b, c)
+
+/**
+ * Zapisuje w śladzie koniec zdarzenia @p kind z wynikiem @p a.
+ */
+#define TRACE_END(kind, a) trace_record(kind, 1, a, 0, 0)
+#else
+#define TRACE_BEGIN(kind, a, b, c)
+#define TRACE_END(kind, a)
+#endif
+
+#ifdef GAMMA_TRACE
+/**
+ * Rodzaje zdarzeń śladu.
+ */
+typedef enum trace_kind {
+  TRACE_MOVE,            ///< gamma_move
+  TRACE_GOLDEN_MOVE,     ///< gamma_golden_move
+  TRACE_APPLY_MOVES,     ///< gamma_apply_moves
+  TRACE_GOLDEN_POSSIBLE, ///< gamma_golden_possible
+  TRACE_BOARD,           ///< gamma_board i gamma_query_board
+  TRACE_UNION,           ///< łączenie pola z obszarami sąsiadów
+  TRACE_RELABEL,         ///< podział obszaru okradanego gracza
+  TRACE_SPLIT_REBUILD,   ///< przebudowa indeksu punktów artykulacji
+  TRACE_GOLDEN_SCAN,     ///< przeglądanie planszy w gamma_golden_possible
+  TRACE_KINDS            ///< liczba rodzajów zdarzeń
+} trace_kind_t;
+
+/**
+ * Nazwy zdarzeń śladu.
+ */
+static const char *trace_names[TRACE_KINDS] = {
+  "gamma_move", "gamma_golden_move", "gamma_apply_moves",
+  "gamma_golden_possible", "gamma_board", "union", "relabel",
+  "split_rebuild", "golden_scan"
+};
+
+/**
+ * Nazwy argumentów zdarzeń: osobno dla początku i końca zdarzenia,
+ * NULL oznacza brak argumentu.
+ */
+static const char *trace_arguments[TRACE_KINDS][2][3] = {
+  { { "player", "x", "y" }, { "result" } },
+  { { "player", "x", "y" }, { "result" } },
+  { { "count" }, { "done" } },
+  { { "player" }, { "result" } },
+  { { NULL }, { "bytes" } },
+  { { "player", "x", "y" }, { "areas" } },
+  { { "player", "x", "y" }, { "pieces" } },
+  { { "player" }, { "result" } },
+  { { "player", "tier" }, { "robbed_player" } }
+};
+
+/** @struct trace_event
+ * Zdarzenie śladu.
+ */
+typedef struct trace_event {
+  uint64_t time; ///< Czas monotoniczny w nanosekundach.
+  uint64_t arguments[3]; ///< Argumenty zdarzenia.
+  uint8_t kind; ///< Rodzaj zdarzenia.
+  uint8_t end; ///< 0 dla początku, 1 dla końca zdarzenia.
+} trace_event_t;
+
+/** @struct trace_ring
+ * Bufor cykliczny zdarzeń jednego wątku. Pisze do niego tylko ten wątek,
+ * więc zapis nie wymaga blokady, a czytający poznaje zapisane zdarzenia
+ * po liczniku @p head.
+ */
+typedef struct trace_ring {
+  _Atomic uint64_t head; ///< Liczba zdarzeń zapisanych od początku.
+  uint64_t thread; ///< Numer wątku w śladzie.
+  struct trace_ring *next; ///< Bufor poprzednio zarejestrowanego wątku.
+  trace_event_t events[GAMMA_TRACE_EVENTS]; ///< Zdarzenia.
+} trace_ring_t;
+
+/**
+ * Bufory wszystkich wątków, które zapisały zdarzenie, od najnowszego.
+ */
+static _Atomic(trace_ring_t*) trace_rings = NULL;
+
+/**
+ * Liczba wątków, które zapisały zdarzenie.
+ */
+static _Atomic uint64_t trace_threads = 0;
+
+/**
+ * Bufor bieżącego wątku albo NULL przed jego pierwszym zdarzeniem.
+ */
+static _Thread_local trace_ring_t *trace_ring = NULL;
+
+/** @brief Zapisuje zdarzenie w buforze bieżącego wątku.
+ * Przy pierwszym zdarzeniu wątku alokuje bufor i dokłada go do listy
+ * buforów; bufory żyją do końca programu, żeby dało się je wypisać.
+ * @param[in] kind – rodzaj zdarzenia,
+ * @param[in] end  – 0 dla początku, 1 dla końca zdarzenia,
+ * @param[in] a    – pierwszy argument,
+ * @param[in] b    – drugi argument,
+ * @param[in] c    – trzeci argument.
+ */
+static void trace_record(uint8_t kind, uint8_t end, uint64_t a, uint64_t b,
+  uint64_t c) {
+
+  if (trace_ring == NULL) {
+    trace_ring_t *ring = malloc(sizeof(trace_ring_t));
+    if (ring == NULL) {
+      return;
+    }
+    atomic_init(&ring->head, 0);
+    ring->thread = atomic_fetch_add(&trace_threads, 1) + 1;
+    ring->next = atomic_load(&trace_rings);
+    while (!atomic_compare_exchange_weak(&trace_rings, &ring->next, ring)) {
+    }
+    trace_ring = ring;
+  }
+
+  uint64_t head = atomic_load_explicit(&trace_ring->head,
+    memory_order_relaxed);
+  trace_event_t *event = &trace_ring->events[head % GAMMA_TRACE_EVENTS];
+
+  event->time = stats_clock();
+  event->arguments[0] = a;
+  event->arguments[1] = b;
+  event->arguments[2] = c;
+  event->kind = kind;
+  event->end = end;
+  atomic_store_explicit(&trace_ring->head, head + 1, memory_order_release);
+}
+
+/** @brief Wypisuje zdarzenia jednego bufora w formacie Chrome trace.
+ * Kopiuje zdarzenia, a potem pomija te, które wątek mógł w tym czasie
+ * nadpisać, łącznie z tym, którego miejsce zajmuje właśnie zapisywane
+ * zdarzenie.
+ * @param[in] ring      – bufor wątku,
+ * @param[in,out] file  – plik śladu,
+ * @param[in,out] first – czy nie wypisano jeszcze żadnego zdarzenia.
+ * @return Wartość @p false, gdy nie udało się zaalokować pamięci.
+ */
+static bool trace_write_ring(trace_ring_t *ring, FILE *file, bool *first) {
+  trace_event_t *events = malloc(sizeof(ring->events));
+  if (events == NULL) {
+    return false;
+  }
+
+  uint64_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+  uint64_t begin = head > GAMMA_TRACE_EVENTS ? head - GAMMA_TRACE_EVENTS : 0;
+  for (uint64_t i = begin; i < head; i++) {
+    events[i % GAMMA_TRACE_EVENTS] = ring->events[i % GAMMA_TRACE_EVENTS];
+  }
+  atomic_thread_fence(memory_order_acquire);
+  uint64_t now = atomic_load_explicit(&ring->head, memory_order_relaxed);
+  // wątek, który zapisał zdarzenie now - 1, może już nadpisywać
+  // zdarzenie now - GAMMA_TRACE_EVENTS w tym samym miejscu bufora
+  if (now >= GAMMA_TRACE_EVENTS && now - GAMMA_TRACE_EVENTS + 1 > begin) {
+    begin = now - GAMMA_TRACE_EVENTS + 1;
+  }
+
+  for (uint64_t i = begin; i < head; i++) {
+    const trace_event_t *event = &events[i % GAMMA_TRACE_EVENTS];
+    const char **names = trace_arguments[event->kind][event->end];
+
+    fprintf(file, "%s\n{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%" PRIu64
+      ".%03" PRIu64 ",\"pid\":1,\"tid\":%" PRIu64 ",\"args\":{",
+      *first ? "" : ",", trace_names[event->kind], event->end ? 'E' : 'B',
+      event->time / 1000, event->time % 1000, ring->thread);
+    for (uint8_t j = 0; j < 3 && names[j] != NULL; j++) {
+      fprintf(file, "%s\"%s\":%" PRIu64, j == 0 ? "" : ",", names[j],
+        event->arguments[j]);
+    }
+    fprintf(file, "}}");
+    *first = false;
+  }
+
+  free(events);
+  return true;
+}
+#endif
+
+/** @struct sparse_field
+ * Zajęte pole rzadkiej planszy, slot tablicy haszującej.
+ */
+typedef struct sparse_field {
+  uint64_t field; ///< Numer pola liczony: x + y * width.
+  uint64_t parent; ///< Rodzic pola w strukturze find&union.
+  uint64_t order; ///< Numer pola w kolejności przeszukiwania w głąb.
+  uint32_t player; ///< Numer gracza na polu, 0 oznacza pusty slot.
+  uint8_t rank; ///< Ranga pola w strukturze find&union.
+  uint8_t split; ///< Na ile kawałków rozpadnie się obszar bez tego pola.
+} sparse_field_t;
+
+/** @struct dfs_frame
+ * Ramka stosu przeszukiwania w głąb szukającego punktów artykulacji.
+ */
+typedef struct dfs_frame {
+  uint64_t field; ///< Numer odwiedzanego pola.
+  uint64_t parent; ///< Numer pola, z którego przyszliśmy.
+  uint64_t order; ///< Numer pola w kolejności przeszukiwania.
+  uint64_t low; ///< Najmniejszy numer osiągalny z poddrzewa pola.
+  uint8_t direction; ///< Kierunek następnego sąsiada do sprawdzenia.
+  uint8_t children; ///< Liczba dzieci pola w drzewie przeszukiwania.
+  uint8_t cut_children; ///< Liczba dzieci odcinanych po zabraniu pola.
+} dfs_frame_t;
+
+/**
+ * Bit rangi pola oznaczający, że pole jest już zapisane w dzienniku zmian.
+ * Ranga nigdy nie przekracza 63, więc starsze bity są wolne.
+ */
+#define RANK_JOURNALED 0x80
+
+/**
+ * Bit rangi pola oznaczający, że przeszukiwanie obszaru już je odwiedziło.
+ */
+#define RANK_VISITED 0x40
+
+/**
+ * Maska samej rangi w bajcie rangi pola.
+ */
+#define RANK_MASK 0x3F
+
+/** @struct journal_entry
+ * Wpis dziennika zmian: stan pola w find&union sprzed pierwszej zmiany.
+ */
+typedef struct journal_entry {
+  uint64_t field; ///< Numer pola liczony: x + y * width.
+  uint64_t parent; ///< Poprzedni rodzic pola.
+  uint8_t rank; ///< Poprzednia ranga pola.
+} journal_entry_t;
+
+/**
+ * Sposoby przechowywania planszy. Gęsta plansza trzyma numer gracza
+ * w 1, 2 lub 4 bajtach, a rodzica pola w find&union w 4 lub 8 bajtach;
+ * sposób jest wybierany w gamma_new i nie zmienia się do końca gry.
+ */
+typedef enum layout {
+  LAYOUT_SPARSE, ///< rzadka plansza w tablicy haszującej
+  LAYOUT_8_32,   ///< uint8_t na pole, uint32_t na rodzica
+  LAYOUT_16_32,  ///< uint16_t na pole, uint32_t na rodzica
+  LAYOUT_32_32,  ///< uint32_t na pole, uint32_t na rodzica
+  LAYOUT_8_64,   ///< uint8_t na pole, uint64_t na rodzica
+  LAYOUT_16_64,  ///< uint16_t na pole, uint64_t na rodzica
+  LAYOUT_32_64   ///< uint32_t na pole, uint64_t na rodzica
+} layout_t;
+
+/** @struct golden_cache
+ * Zapamiętana odpowiedź gamma_golden_possible dla jednego gracza.
+ */
+typedef struct golden_cache {
+  bool valid; ///< Czy odpowiedź była już policzona.
+  bool possible; ///< Zapamiętana odpowiedź.
+  bool no_candidates; /**< Czy odpowiedź false wynika z tego, że gracz ma
+  * komplet obszarów i obok jego pól nie ma cudzych pionków. */
+  uint32_t robbed_player; /**< Gracz, któremu można zabrać pole, gdy
+  * odpowiedź to true. */
+  uint64_t board_generation; ///< Pokolenie planszy w chwili liczenia.
+  uint64_t player_generation; ///< Pokolenie gracza w chwili liczenia.
+  uint64_t robbed_generation; /**< Pokolenie gracza @p robbed_player
+  * w chwili liczenia. */
+} golden_cache_t;
+
+/** @struct candidate_list
+ * Cudze pola, które stały się sąsiadami pól gracza, czyli kandydaci do jego
+ * złotego ruchu. Pole trafia na listę, gdy gracz stawia pionek obok niego
+ * albo ktoś inny stawia pionek obok pola gracza. Pola mogą się powtarzać
+ * i przestawać być kandydatami; takie usuwa dopiero porządkowanie listy.
+ */
+typedef struct candidate_list {
+  uint64_t *fields; ///< Numery pól liczone: x + y * width.
+  uint64_t length; ///< Liczba pól na liście.
+  uint64_t capacity; ///< Liczba pól, na które jest miejsce.
+  bool lost; /**< Czy zabrakło pamięci i lista może nie zawierać wszystkich
+  * kandydatów; wtedy szukamy ich na całej planszy. */
+} candidate_list_t;
+
+/** @struct golden_scan
+ * Fragment listy kandydatów albo planszy przeglądany przez jeden wątek
+ * w gamma_golden_possible.
+ */
+typedef struct golden_scan {
+  const struct gamma *g; ///< Przeglądana gra, tylko do odczytu.
+  uint32_t player; ///< Gracz, dla którego szukamy złotego ruchu.
+  uint8_t tier; ///< Poziom sprawdzania: 2 lub 3.
+  const uint64_t *list; /**< Lista kandydatów gracza albo NULL, gdy
+  * przeglądamy zajęte pola całej planszy. */
+  uint64_t begin; ///< Pierwsza pozycja do przejrzenia.
+  uint64_t end; ///< Pozycja tuż za ostatnią do przejrzenia.
+  atomic_bool *stop; ///< Flaga ustawiana, gdy któryś wątek znalazł pole.
+  uint32_t robbed_player; ///< Właściciel znalezionego pola albo 0.
+  bool candidates; ///< Czy w fragmencie było pole obok pola gracza.
+  bool ambiguous; ///< Czy poziom 2 nie rozstrzygnął któregoś kandydata.
+#ifdef GAMMA_STATS
+  uint64_t cells; ///< Liczba przejrzanych pól.
+#endif
+} golden_scan_t;
+
+struct scan_pool;
+
+/** @struct scan_worker
+ * Argument wątku pomocniczego przeglądania kandydatów.
+ */
+typedef struct scan_worker {
+  struct scan_pool *pool; ///< Pula, do której należy wątek.
+  uint32_t index; ///< Numer fragmentu wątku w scans, od 1.
+  uint64_t seen; ///< Numer ostatniego przeglądania, które wątek widział.
+} scan_worker_t;
+
+/** @struct scan_pool
+ * Wątki pomocnicze przeglądania kandydatów jednej gry. Tworzone są przy
+ * pierwszym przeglądaniu, które ich potrzebuje, i czekają na kolejne
+ * aż do zmiany liczby wątków albo usunięcia gry.
+ */
+typedef struct scan_pool {
+  pthread_mutex_t lock; /**< Trzymany przez wątek, który rozdziela
+  * fragmenty; pozostałe przeglądają wtedy same. */
+  pthread_mutex_t work_lock; ///< Chroni pola poniżej.
+  pthread_cond_t work; ///< Budzi wątki pomocnicze do pracy lub końca.
+  pthread_cond_t done; ///< Budzi wątek czekający na koniec fragmentów.
+  pthread_t *ids; ///< Identyfikatory wątków pomocniczych.
+  scan_worker_t *workers; ///< Argumenty wątków pomocniczych.
+  uint32_t size; ///< Liczba działających wątków pomocniczych.
+  bool started; ///< Czy próbowano już utworzyć wątki pomocnicze.
+  golden_scan_t *scans; ///< Fragmenty bieżącego przeglądania.
+  uint32_t jobs; ///< Liczba fragmentów dla wątków pomocniczych.
+  uint32_t running; ///< Liczba fragmentów, które jeszcze trwają.
+  uint64_t generation; ///< Numer bieżącego przeglądania.
+  bool quit; ///< Czy wątki pomocnicze mają skończyć pracę.
+} scan_pool_t;
+
+/** @struct gamma_scratch
+ * Pamięć robocza zapytań tylko do odczytu, osobna dla każdego wątku.
+ */
+struct gamma_scratch {
+  uint32_t *mark; /**< Znaczniki odwiedzenia pozycji planszy: pola gęstej
+  * planszy albo slotu rzadkiej. */
+  uint64_t mark_capacity; ///< Liczba pozycji, na które jest miejsce w mark.
+  uint32_t stamp; ///< Znacznik bieżącego przeszukiwania.
+  uint64_t *stack; ///< Stos przeszukiwania.
+  uint64_t stack_capacity; ///< Liczba pól, na które jest miejsce na stosie.
+  bool failed; ///< Czy któreś przeszukiwanie przerwał brak pamięci.
+};
+
 /** @struct gamma
  * Deklaracja struktury gamma.
 */
@@ -27,940 +472,2955 @@ struct gamma {
   * ilość aren zajmowana przez gracza. */
   uint64_t *free_fields_around; /**< Tablica, analogicznie do golden, ilość
   * legalnych pól do zajęcia przez gracza. */
-  uint64_t **rank; ///< Tablica pomocnicza do find&union.
-  uint64_t **parent; ///< Tablica pomocnicza do find&union.
-  uint64_t **copy_rank; ///< Tablica pomocnicza dla złotego ruchu.
-  uint64_t **copy_parent; ///< Tablica pomocnicza dla złotego ruchu.
-  uint32_t **board; ///< Tablica dwuwymiarowa reprezentująca planszę.
+  bool sparse; /**< Czy plansza jest rzadka, tzn. trzyma tylko zajęte pola
+  * w tablicy haszującej @p cells zamiast tablic board, rank i parent. */
+  sparse_field_t *cells; ///< Tablica haszująca zajętych pól rzadkiej planszy.
+  uint64_t cells_capacity; ///< Liczba slotów @p cells, potęga dwójki.
+  uint8_t cells_shift; ///< 64 minus logarytm z @p cells_capacity.
+  uint8_t cell_size; /**< Liczba bajtów numeru gracza na planszy: 1, 2
+  * lub 4, najmniejsza mieszcząca numer ostatniego gracza. */
+  uint8_t index_size; /**< Liczba bajtów numeru pola w tablicy parent: 4,
+  * gdy numery wszystkich pól mieszczą się w uint32_t, wpp. 8. */
+  layout_t layout; /**< Sposób przechowywania planszy wynikający z @p sparse,
+  * @p cell_size i @p index_size. */
+  uint8_t *rank; ///< Tablica pomocnicza do find&union.
+  void *parent; ///< Tablica pomocnicza do find&union.
+  void *board; /**< Plansza w jednym bloku, pole (x, y) ma
+  * indeks x + y * width. */
+  journal_entry_t *journal; /**< Dziennik zmian find&union próbnego złotego
+  * ruchu, po jednym wpisie na każde zmienione pole. */
+  uint64_t journal_length; ///< Liczba wpisów w dzienniku.
+  uint64_t journal_capacity; ///< Liczba wpisów, na które jest miejsce.
+  bool journaling; ///< Czy zmiany find&union są zapisywane w dzienniku.
+  uint64_t *stack; ///< Stos pól przeszukiwanego obszaru.
+  uint64_t stack_capacity; ///< Liczba pól, na które jest miejsce na stosie.
+  bool *split_dirty; /**< Tablica, analogicznie do golden, czy wartości split
+  * pól gracza są nieaktualne. */
+  uint8_t *split; /**< Tablica, split[i] mówi, na ile kawałków rozpadnie się
+  * obszar pola i po zabraniu go; alokowana przy pierwszym użyciu. */
+  void *order; /**< Tablica numerów pól w kolejności przeszukiwania w głąb,
+  * elementy mają @p index_size bajtów; alokowana razem ze @p split. */
+  uint64_t order_clock; ///< Ostatni nadany numer w kolejności przeszukiwania.
+  dfs_frame_t *frames; ///< Stos przeszukiwania w głąb.
+  uint64_t frames_capacity; ///< Liczba ramek, na które jest miejsce na stosie.
+  uint64_t board_generation; ///< Liczba wykonanych ruchów i złotych ruchów.
+  uint64_t *player_generation; /**< Tablica, analogicznie do golden, rośnie,
+  * gdy zmieniają się pola, obszary lub złoty ruch gracza albo obok jego pola
+  * staje cudzy pionek. */
+  golden_cache_t *golden_cache; /**< Tablica, analogicznie do golden,
+  * zapamiętane odpowiedzi gamma_golden_possible. */
+  candidate_list_t *candidates; /**< Tablica, analogicznie do golden, listy
+  * kandydatów do złotego ruchu. */
+  _Atomic uint64_t golden_tier_hits[GAMMA_GOLDEN_TIERS]; /**< Ile zapytań
+  * gamma_golden_possible rozstrzygnął każdy poziom sprawdzania. */
+  uint32_t threads; ///< Liczba wątków przeglądających planszę.
+  scan_pool_t pool; ///< Wątki pomocnicze przeglądania kandydatów.
+  pthread_rwlock_t lock; ///< Blokada: ruchy piszą, zapytania czytają.
+  pthread_mutex_t cache_lock; /**< Chroni @p golden_cache przed zapytaniami
+  * czytającymi i zapisującymi ją naraz. */
+  pthread_mutex_t split_lock; /**< Chroni indeks punktów artykulacji: split,
+  * order, frames i split_dirty, gdy przebudowuje go zapytanie. */
+#ifdef GAMMA_STATS
+  stats_counters_t stats; ///< Liczniki wewnętrzne silnika.
+#endif
 };
 
-gamma_t* gamma_new(uint32_t width, uint32_t height,
-                   uint32_t players, uint32_t areas) {
+/** @brief Szuka slotu pola w tablicy haszującej rzadkiej planszy.
+ * Przegląda sloty liniowo, zaczynając od wartości funkcji haszującej.
+ * @param[in] g     – wskaźnik na strukturę przechowującą stan gry,
+ * @param[in] field – numer pola liczony: x + y * width.
+ * @return Slot zawierający pole lub pusty slot, w którym należy je wstawić.
+ */
+static inline sparse_field_t *sparse_slot(const gamma_t *g, uint64_t field) {
+  uint64_t mask = g->cells_capacity - 1;
+  uint64_t slot = (field * UINT64_C(0x9E3779B97F4A7C15)) >> g->cells_shift;
 
-  gamma_t *g = NULL;
+  while (g->cells[slot].player != 0 && g->cells[slot].field != field) {
+    slot = (slot + 1) & mask;
+  }
 
-  if ((width == 0 || height == 0) || (players == 0 || areas == 0)) {
-    return g;
+  return &g->cells[slot];
+}
+
+/** @brief Zapewnia w rzadkiej planszy miejsce na jeszcze jedno zajęte pole.
+ * Gdy tablica haszująca byłaby zapełniona w ponad połowie, podwaja ją.
+ * @param[in,out] g – wskaźnik na strukturę przechowującą stan gry.
+ * @return Wartość @p false, gdy nie udało się zaalokować pamięci,
+ * a @p true w przeciwnym przypadku.
+ */
+static bool sparse_reserve(gamma_t *g) {
+  uint64_t taken = (uint64_t)g->width * g->height - g->free_fields;
+
+  if (!g->sparse || 2 * (taken + 1) <= g->cells_capacity) {
+    return true;
   }
-  else {
-    gamma_t *g = malloc(sizeof(gamma_t));
-    if (g == NULL) {
-      free(g);
-      return NULL;
-    }
 
-    g->golden = malloc(players * sizeof(bool));
-    if (g->golden == NULL) {
-      free(g);
-      return NULL;
-    }
+  uint64_t capacity = 2 * g->cells_capacity;
+  sparse_field_t *cells = calloc(capacity, sizeof(sparse_field_t));
+  if (cells == NULL) {
+    return false;
+  }
 
-    g->fields_taken = malloc(players * sizeof(uint64_t));
-    if (g->fields_taken == NULL) {
-      free(g->golden);
-      free(g);
-      return NULL;
+  sparse_field_t *old_cells = g->cells;
+  uint64_t old_capacity = g->cells_capacity;
+  g->cells = cells;
+  g->cells_capacity = capacity;
+  g->cells_shift--;
+  for (uint64_t i = 0; i < old_capacity; i++) {
+    if (old_cells[i].player != 0) {
+      *sparse_slot(g, old_cells[i].field) = old_cells[i];
     }
+  }
 
-    g->free_fields_around = malloc(players * sizeof(uint64_t));
-    if (g->free_fields_around == NULL) {
-      free(g->golden);
-      free(g->fields_taken);
-      free(g);
-      return NULL;
-    }
+  free(old_cells);
+  return true;
+}
 
-    g->areas_taken = malloc(players * sizeof(uint64_t));
-    if (g->areas_taken == NULL) {
-      free(g->golden);
-      free(g->fields_taken);
-      free(g->free_fields_around);
-      free(g);
-      return NULL;
-    }
+/** @brief Podaje numer gracza stojącego na polu.
+ * @param[in] g      – wskaźnik na strukturę przechowującą stan gry,
+ * @param[in] layout – sposób przechowywania planszy @p g,
+ * @param[in] field  – numer pola liczony: x + y * width.
+ * @return Numer gracza lub 0, gdy pole jest wolne.
+ */
+SPECIALIZED uint32_t owner_in(const gamma_t *g, layout_t layout,
+  uint64_t field) {
+
+  switch (layout) {
+    case LAYOUT_SPARSE:
+      return sparse_slot(g, field)->player;
+    case LAYOUT_8_32:
+    case LAYOUT_8_64:
+      return ((const uint8_t *)g->board)[field];
+    case LAYOUT_16_32:
+    case LAYOUT_16_64:
+      return ((const uint16_t *)g->board)[field];
+    default:
+      return ((const uint32_t *)g->board)[field];
+  }
+}
 
-    g->board = malloc(width * sizeof(uint32_t *));
-    if (g->board == NULL) {
-      free(g->golden);
-      free(g->fields_taken);
-      free(g->free_fields_around);
-      free(g->areas_taken);
-      free(g);
-      return NULL;
-    }
-    for (uint32_t i = 0; i < width; i++) {
-      g->board[i] = malloc(height * sizeof(uint32_t));
-      if (g->board[i] == NULL) {
-        free(g->golden);
-        free(g->fields_taken);
-        free(g->free_fields_around);
-        free(g->areas_taken);
-        for (uint32_t k = 0; k < i; k++) {
-          free(g->board[k]);
-        }
-        free(g->board);
-        free(g);
-        return NULL;
-      }
-    }
+/** @brief Podaje numer gracza stojącego na polu.
+ * @param[in] g     – wskaźnik na strukturę przechowującą stan gry,
+ * @param[in] field – numer pola liczony: x + y * width.
+ * @return Numer gracza lub 0, gdy pole jest wolne.
+ */
+static inline uint32_t field_owner(const gamma_t *g, uint64_t field) {
+  return owner_in(g, g->layout, field);
+}
 
-    g->rank = malloc(width * sizeof(uint64_t *));
-    if (g->rank == NULL) {
-      free(g->golden);
-      free(g->fields_taken);
-      free(g->free_fields_around);
-      free(g->areas_taken);
-      for (uint32_t k = 0; k < width; k++) {
-        free(g->board[k]);
-      }
-      free(g->board);
-      free(g);
-      return NULL;
-    }
-    for (uint32_t i = 0; i < width; i++) {
-      g->rank[i] = malloc(height * sizeof(uint64_t));
-      if (g->rank[i] == NULL) {
-        free(g->golden);
-        free(g->fields_taken);
-        free(g->free_fields_around);
-        free(g->areas_taken);
-        for (uint32_t k = 0; k < width; k++) {
-          free(g->board[k]);
-        }
-        for (uint32_t k = 0; k < i; k++) {
-          free(g->rank[k]);
-        }
-        free(g->board);
-        free(g->rank);
-        free(g);
-        return NULL;
+/** @brief Stawia na polu pionek gracza.
+ * Na rzadkiej planszy wstawia pole do tablicy haszującej, jeśli go w niej
+ * nie było, więc wcześniej trzeba wywołać @ref sparse_reserve.
+ * @param[in,out] g  – wskaźnik na strukturę przechowującą stan gry,
+ * @param[in] layout – sposób przechowywania planszy @p g,
+ * @param[in] field  – numer pola liczony: x + y * width,
+ * @param[in] player – numer gracza, mieszczący się w @p cell_size bajtach.
+ */
+SPECIALIZED void set_owner_in(gamma_t *g, layout_t layout, uint64_t field,
+  uint32_t player) {
+
+  switch (layout) {
+    case LAYOUT_SPARSE: {
+      sparse_field_t *slot = sparse_slot(g, field);
+      if (slot->player == 0) {
+        slot->field = field;
+        slot->parent = field;
+        slot->rank = 0;
       }
+      slot->player = player;
+      break;
     }
+    case LAYOUT_8_32:
+    case LAYOUT_8_64:
+      ((uint8_t *)g->board)[field] = player;
+      break;
+    case LAYOUT_16_32:
+    case LAYOUT_16_64:
+      ((uint16_t *)g->board)[field] = player;
+      break;
+    default:
+      ((uint32_t *)g->board)[field] = player;
+  }
+}
 
-    g->parent = malloc(width * sizeof(uint64_t *));
-    if (g->parent == NULL) {
-      free(g->golden);
-      free(g->fields_taken);
-      free(g->free_fields_around);
-      free(g->areas_taken);
-      for (uint32_t k = 0; k < width; k++) {
-        free(g->board[k]);
-        free(g->rank[k]);
-      }
-      free(g->board);
-      free(g->rank);
-      free(g);
-      return NULL;
-    }
-    for (uint32_t i = 0; i < width; i++) {
-      g->parent[i] = malloc(height * sizeof(uint64_t));
-      if (g->parent[i] == NULL) {
-        free(g->golden);
-        free(g->fields_taken);
-        free(g->free_fields_around);
-        free(g->areas_taken);
-        for (uint32_t k = 0; k < i; k++) {
-          free(g->parent[k]);
-        }
-        for (uint32_t k = 0; k < width; k++) {
-          free(g->board[k]);
-          free(g->rank[k]);
-        }
-        free(g->board);
-        free(g->rank);
-        free(g->parent);
-        free(g);
-        return NULL;
-      }
-    }
+/** @brief Stawia na polu pionek gracza.
+ * @param[in,out] g  – wskaźnik na strukturę przechowującą stan gry,
+ * @param[in] field  – numer pola liczony: x + y * width,
+ * @param[in] player – numer gracza.
+ */
+static inline void set_field_owner(gamma_t *g, uint64_t field,
+  uint32_t player) {
 
-    g->copy_rank = malloc(width * sizeof(uint64_t *));
-    if (g->copy_rank == NULL) {
-        free(g->golden);
-        free(g->fields_taken);
-        free(g->free_fields_around);
-        free(g->areas_taken);
-        for (uint32_t k = 0; k < width; k++) {
-          free(g->board[k]);
-          free(g->rank[k]);
-          free(g->parent[k]);
-        }
-        free(g->board);
-        free(g->rank);
-        free(g->parent);
-        free(g);
-        return NULL;
-    }
-    for (uint32_t i = 0; i < width; i++) {
-      g->copy_rank[i] = malloc(height * sizeof(uint64_t));
-      if (g->copy_rank[i] == NULL) {
-        free(g->golden);
-        free(g->fields_taken);
-        free(g->free_fields_around);
-        free(g->areas_taken);
-        for (uint32_t k = 0; k < i; k++) {
-          free(g->copy_rank[k]);
-        }
-        for (uint32_t k = 0; k < width; k++) {
-          free(g->board[k]);
-          free(g->rank[k]);
-          free(g->parent[k]);
-        }
-        free(g->board);
-        free(g->rank);
-        free(g->parent);
-        free(g->copy_rank);
-        free(g);
-        return NULL;
-      }
-    }
+  set_owner_in(g, g->layout, field, player);
+}
 
-    g->copy_parent = malloc(width * sizeof(uint64_t *));
-    if (g->copy_parent == NULL) {
-        free(g->golden);
-        free(g->fields_taken);
-        free(g->free_fields_around);
-        free(g->areas_taken);
-        for (uint32_t k = 0; k < width; k++) {
-          free(g->board[k]);
-          free(g->rank[k]);
-          free(g->parent[k]);
-          free(g->copy_rank[k]);
-        }
-        free(g->board);
-        free(g->rank);
-        free(g->parent);
-        free(g->copy_rank);
-        free(g);
-        return NULL;
-    }
-    for (uint32_t i = 0; i < width; i++) {
-      g->copy_parent[i] = malloc(height * sizeof(uint64_t));
-      if (g->copy_parent[i] == NULL) {
-        free(g->golden);
-        free(g->fields_taken);
-        free(g->free_fields_around);
-        free(g->areas_taken);
-        for (uint32_t k = 0; k < i; k++) {
-          free(g->copy_parent[k]);
-        }
-        for (uint32_t k = 0; k < width; k++) {
-          free(g->board[k]);
-          free(g->rank[k]);
-          free(g->parent[k]);
-          free(g->copy_rank[k]);
-        }
-        free(g->board);
-        free(g->rank);
-        free(g->parent);
-        free(g->copy_rank);
-        free(g->copy_parent);
-        free(g);
-        return NULL;
-      }
-    }
+/** @brief Podaje rodzica pola w strukturze find&union.
+ * @param[in] g      – wskaźnik na strukturę przechowującą stan gry,
+ * @param[in] layout – sposób przechowywania planszy @p g,
+ * @param[in] field  – numer pola liczony: x + y * width.
+ * @return Numer pola będącego rodzicem @p field.
+ */
+SPECIALIZED uint64_t parent_in(const gamma_t *g, layout_t layout,
+  uint64_t field) {
+
+  switch (layout) {
+    case LAYOUT_SPARSE:
+      return sparse_slot(g, field)->parent;
+    case LAYOUT_8_32:
+    case LAYOUT_16_32:
+    case LAYOUT_32_32:
+      return ((const uint32_t *)g->parent)[field];
+    default:
+      return ((const uint64_t *)g->parent)[field];
+  }
+}
 
-    g->width = width;
-    g->height = height;
-    g->players = players;
-    g->areas = areas;
-    g->free_fields = (width * height);
-
-    for (uint32_t i = 0; i < players; i++) {
-      g->golden[i] = 0;
-      g->fields_taken[i] = 0;
-      g->areas_taken[i] = 0;
-      g->free_fields_around[i] = 0;
-    }
-
-    for (uint32_t j = 0; j < height; j++) {
-      for (uint32_t i = 0; i < width; i++) {
-        g->board[i][j] = 0;
-        g->rank[i][j] = 0;
-        g->parent[i][j] = i + (j * g->width);
-        g->copy_rank[i][j] = 0;
-        g->copy_parent[i][j] = 0;
-      }
-    }
+/** @brief Podaje rodzica pola w strukturze find&union.
+ * @param[in] g     – wskaźnik na strukturę przechowującą stan gry,
+ * @param[in] field – numer pola liczony: x + y * width.
+ * @return Numer pola będącego rodzicem @p field.
+ */
+static inline uint64_t get_parent(const gamma_t *g, uint64_t field) {
+  return parent_in(g, g->layout, field);
+}
 
-    return g;
+/** @brief Podaje bajt rangi pola w strukturze find&union.
+ * Poza rangą bajt zawiera bity @ref RANK_JOURNALED i @ref RANK_VISITED.
+ * @param[in] g      – wskaźnik na strukturę przechowującą stan gry,
+ * @param[in] layout – sposób przechowywania planszy @p g,
+ * @param[in] field  – numer pola liczony: x + y * width.
+ * @return Wskaźnik na bajt rangi pola.
+ */
+SPECIALIZED uint8_t *rank_in(const gamma_t *g, layout_t layout,
+  uint64_t field) {
+
+  if (layout == LAYOUT_SPARSE) {
+    return &sparse_slot(g, field)->rank;
   }
+  return &g->rank[field];
 }
 
-void gamma_delete(gamma_t *g) {
-  if (g != NULL) {
-    free(g->golden);
-    free(g->fields_taken);
-    free(g->free_fields_around);
-    free(g->areas_taken);
-    for (uint32_t k = 0; k < g->width; k++) {
-      free(g->board[k]);
-      free(g->rank[k]);
-      free(g->parent[k]);
-      free(g->copy_rank[k]);
-      free(g->copy_parent[k]);
+/** @brief Podaje bajt rangi pola w strukturze find&union.
+ * @param[in] g     – wskaźnik na strukturę przechowującą stan gry,
+ * @param[in] field – numer pola liczony: x + y * width.
+ * @return Wskaźnik na bajt rangi pola.
+ */
+static inline uint8_t *rank_byte(const gamma_t *g, uint64_t field) {
+  return rank_in(g, g->layout, field);
+}
+
+/** @brief Zapisuje w dzienniku stan pola sprzed jego pierwszej zmiany.
+ * Nic nie robi, gdy dziennik jest wyłączony lub pole jest już w nim zapisane.
+ * Miejsce na wpis musi być wcześniej zarezerwowane przez @ref journal_begin.
+ * @param[in,out] g  – wskaźnik na strukturę przechowującą stan gry,
+ * @param[in] layout – sposób przechowywania planszy @p g,
+ * @param[in] field  – numer pola liczony: x + y * width.
+ */
+SPECIALIZED void journal_record(gamma_t *g, layout_t layout, uint64_t field) {
+  if (g->journaling) {
+    uint8_t *rank = rank_in(g, layout, field);
+
+    if ((*rank & RANK_JOURNALED) == 0) {
+      journal_entry_t *entry = &g->journal[g->journal_length];
+      entry->field = field;
+      entry->parent = parent_in(g, layout, field);
+      entry->rank = *rank;
+      g->journal_length++;
+      *rank |= RANK_JOURNALED;
     }
-    free(g->board);
-    free(g->rank);
-    free(g->parent);
-    free(g->copy_rank);
-    free(g->copy_parent);
-    free(g);
   }
 }
 
-/** @brief find z algorytmu Find & Union
- * @param[in] name - numer planszy liczony: i + j * width z board[i][j].
- * @param[in] g    – wskaźnik na strukturę przechowującą stan gry.
- * @return numer planszy do której dojdzie algorytm.
+/** @brief Ustawia rodzica pola w strukturze find&union.
+ * @param[in,out] g  – wskaźnik na strukturę przechowującą stan gry,
+ * @param[in] layout – sposób przechowywania planszy @p g,
+ * @param[in] field  – numer pola liczony: x + y * width,
+ * @param[in] parent – numer pola, które zostaje rodzicem @p field.
  */
-static uint64_t Find (gamma_t *g, uint64_t name) {
-  if (g->parent[name % (g->width)][name / (g->width)] == name) {
-    return name;
+SPECIALIZED void set_parent_in(gamma_t *g, layout_t layout, uint64_t field,
+  uint64_t parent) {
+
+  journal_record(g, layout, field);
+
+  switch (layout) {
+    case LAYOUT_SPARSE:
+      sparse_slot(g, field)->parent = parent;
+      break;
+    case LAYOUT_8_32:
+    case LAYOUT_16_32:
+    case LAYOUT_32_32:
+      ((uint32_t *)g->parent)[field] = parent;
+      break;
+    default:
+      ((uint64_t *)g->parent)[field] = parent;
   }
+}
 
-  g->parent[name % (g->width)][name / (g->width)] =
-    Find(g, g->parent[name % (g->width)][name / (g->width)]);
-  return g->parent[name % (g->width)][name / (g->width)];
+/** @brief Ustawia rodzica pola w strukturze find&union.
+ * @param[in,out] g  – wskaźnik na strukturę przechowującą stan gry,
+ * @param[in] field  – numer pola liczony: x + y * width,
+ * @param[in] parent – numer pola, które zostaje rodzicem @p field.
+ */
+static inline void set_parent(gamma_t *g, uint64_t field, uint64_t parent) {
+  set_parent_in(g, g->layout, field, parent);
 }
 
-/** @brief union z algorytmu Find & Union, łączy pola 1 i 2.
- * @param[in,out] g – wskaźnik na strukturę przechowującą stan gry.
- * @param[in] name1 - numer planszy liczony: i + j * width z board[i][j].
- * @param[in] name2 - numer planszy liczony: i + j * width z board[i][j].
+/** @brief Podaje rangę pola w strukturze find&union.
+ * @param[in] g      – wskaźnik na strukturę przechowującą stan gry,
+ * @param[in] layout – sposób przechowywania planszy @p g,
+ * @param[in] field  – numer pola liczony: x + y * width.
+ * @return Ranga pola.
  */
-static void Union(gamma_t *g, uint64_t name1, uint64_t name2) {
-  uint64_t name_1 = Find(g, name1);
-  uint64_t name_2 = Find(g, name2);
+SPECIALIZED uint8_t get_rank_in(const gamma_t *g, layout_t layout,
+  uint64_t field) {
 
-  if (g->rank[name_1  % (g->width)][name_1 / (g->width)] >
-    g->rank[name_2 % (g->width)][name_2 / (g->width)]) {
+  return *rank_in(g, layout, field) & RANK_MASK;
+}
 
-    g->parent[name_2 % (g->width)][name_2 / (g->width)] = name_1;
-  }
+/** @brief Podaje rangę pola w strukturze find&union.
+ * @param[in] g     – wskaźnik na strukturę przechowującą stan gry,
+ * @param[in] field – numer pola liczony: x + y * width.
+ * @return Ranga pola.
+ */
+static inline uint8_t get_rank(const gamma_t *g, uint64_t field) {
+  return get_rank_in(g, g->layout, field);
+}
 
-  else if (g->rank[name_1  % (g->width)][name_1 / (g->width)] <
-    g->rank[name_2 % (g->width)][name_2 / (g->width)]) {
+/** @brief Ustawia rangę pola w strukturze find&union.
+ * @param[in,out] g  – wskaźnik na strukturę przechowującą stan gry,
+ * @param[in] layout – sposób przechowywania planszy @p g,
+ * @param[in] field  – numer pola liczony: x + y * width,
+ * @param[in] rank   – nowa ranga pola.
+ */
+SPECIALIZED void set_rank_in(gamma_t *g, layout_t layout, uint64_t field,
+  uint8_t rank) {
 
-    g->parent[name_1 % (g->width)][name_1 / (g->width)] = name_2;
-  }
+  journal_record(g, layout, field);
 
-  else if (name_1 != name_2) {
-    g->parent[name_2 % (g->width)][name_2 / (g->width)] = name_1;
-    g->rank[name_1  % (g->width)][name_1 / (g->width)] =
-      g->rank[name_1  % (g->width)][name_1 / (g->width)] + 1;
-  }
+  uint8_t *rank_field = rank_in(g, layout, field);
+  *rank_field = (*rank_field & ~RANK_MASK) | rank;
 }
 
-/** @brief Unionuje pole [x][y] z sąsiadami jeśli są tego samego gracza.
- * Łączy pola tego samego gracza, jednocześnie aktualizując ilość obszarów.
- * Zakłada poprawność danych jako, że jest to funckja pomocnicza.
- * @param[in,out] g   – wskaźnik na strukturę przechowującą stan gry,
- * @param[in] player  – numer gracza, liczba dodatnia niewiększa od wartości
- *                      @p players z funkcji @ref gamma_new,
- * @param[in] x       – numer kolumny, liczba nieujemna mniejsza od wartości
- *                      @p width z funkcji @ref gamma_new,
- * @param[in] y       – numer wiersza, liczba nieujemna mniejsza od wartości
- *                      @p height z funkcji @ref gamma_new.
+/** @brief Ustawia rangę pola w strukturze find&union.
+ * @param[in,out] g – wskaźnik na strukturę przechowującą stan gry,
+ * @param[in] field – numer pola liczony: x + y * width,
+ * @param[in] rank  – nowa ranga pola.
  */
-static void Union_helper(gamma_t *g, uint32_t player, uint32_t x, uint32_t y) {
-  if (x != 0) {
-    if (g->board[x - 1][y] == player) {
-      if (Find(g, x + (y * g->width)) != Find(g, x - 1 + (y * g->width))) {
-        g->areas_taken[player - 1]--;
-        Union(g, x + (y * g->width), x - 1 + (y * g->width));
-      }
-    }
-  }
+static inline void set_rank(gamma_t *g, uint64_t field, uint8_t rank) {
+  set_rank_in(g, g->layout, field, rank);
+}
 
-  if (y != 0) {
-    if (g->board[x][y - 1] == player) {
-      if (Find(g, x + (y * g->width)) != Find(g, x + ((y - 1) * g->width))) {
-        g->areas_taken[player - 1]--;
-        Union(g, x + (y * g->width), x + ((y - 1) * g->width));
-      }
+/** @brief Włącza dziennik zmian find&union.
+ * Rezerwuje miejsce na wpisy dla @p fields różnych pól i tyle samo miejsca
+ * na stosie przeszukiwania obszaru.
+ * @param[in,out] g  – wskaźnik na strukturę przechowującą stan gry,
+ * @param[in] fields – górne ograniczenie liczby pól, które zostaną zmienione.
+ * @return Wartość @p false, gdy nie udało się zaalokować pamięci,
+ * a @p true w przeciwnym przypadku.
+ */
+static bool journal_begin(gamma_t *g, uint64_t fields) {
+  if (fields > g->journal_capacity) {
+    if (fields > SIZE_MAX / sizeof(journal_entry_t)) {
+      return false;
     }
-  }
 
-  if (x != (g->width - 1)) {
-    if (g->board[x + 1][y] == player) {
-      if (Find(g, x + (y * g->width)) != Find(g, x + 1 + (y * g->width))) {
-        g->areas_taken[player - 1]--;
-        Union(g, x + (y * g->width), x + 1 + (y * g->width));
-      }
+    journal_entry_t *journal =
+      realloc(g->journal, fields * sizeof(journal_entry_t));
+    if (journal == NULL) {
+      return false;
     }
+    g->journal = journal;
+    g->journal_capacity = fields;
   }
 
-  if (y != (g->height - 1)) {
-    if (g->board[x][y + 1] == player) {
-      if (Find(g, x + (y * g->width)) != Find(g, x + ((y + 1) * g->width))) {
-        g->areas_taken[player - 1]--;
-        Union(g, x + (y * g->width), x + ((y + 1) * g->width));
-      }
+  if (fields > g->stack_capacity) {
+    uint64_t *stack = realloc(g->stack, fields * sizeof(uint64_t));
+    if (stack == NULL) {
+      return false;
     }
+    g->stack = stack;
+    g->stack_capacity = fields;
   }
+
+  g->journal_length = 0;
+  g->journaling = true;
+  return true;
 }
 
-/** @brief zmiana wolnych pól po dodaniu pionka player na pole [i][j]
- * @param[in] g – wskaźnik na strukturę przechowującą stan gry.
- * @param[in] i - pierwsza współrzędna polożenia pionka.
- * @param[in] j - druga współrzędna polożenia pionka.
- * @param[in] player – numer gracza którego pionek stawiamy.
- * @param[in] is_golden – czy wykonujemy to dodanie złotym ruchem.
- * @return Ile trzeba dodać playerowi wolnych pól po postawieniu pionka.
+/** @brief Cofa wszystkie zmiany find&union zapisane w dzienniku.
+ * Wyłącza dziennik.
+ * @param[in,out] g – wskaźnik na strukturę przechowującą stan gry.
  */
-static int delta_free_fields_around(gamma_t *g,
-  uint32_t i, uint32_t j, uint32_t player, bool is_golden) {
+static void journal_rollback(gamma_t *g) {
+  g->journaling = false;
 
-  int result = 0;
-  bool less = 0;
-  bool more_north = 1;
-  bool more_west = 1;
-  bool more_south = 1;
-  bool more_east = 1;
+  for (uint64_t i = g->journal_length; i > 0; i--) {
+    journal_entry_t *entry = &g->journal[i - 1];
+    set_parent(g, entry->field, entry->parent);
+    *rank_byte(g, entry->field) = entry->rank;
+  }
+  g->journal_length = 0;
+}
 
-  // sprawdzanie czy pole [i][j] przestało być wolnym polem
-  if (i != 0) {
-    if (g->board[i - 1][j] == player) {
-      less = 1;
-    }
+/** @brief Zatwierdza zmiany find&union zapisane w dzienniku.
+ * Czyści znaczniki odwiedzenia pól i wyłącza dziennik.
+ * @param[in,out] g – wskaźnik na strukturę przechowującą stan gry.
+ */
+static void journal_commit(gamma_t *g) {
+  g->journaling = false;
+
+  for (uint64_t i = 0; i < g->journal_length; i++) {
+    *rank_byte(g, g->journal[i].field) &= RANK_MASK;
   }
+  g->journal_length = 0;
+}
 
-  if (j != 0) {
-    if (g->board[i][j - 1] == player) {
-      less = 1;
-    }
+/** @brief Zwraca pozycję tuż za ostatnią pozycją przeglądania planszy.
+ * @param[in] g       – wskaźnik na strukturę przechowującą stan gry.
+ * @return Liczba slotów rzadkiej planszy albo liczba pól gęstej planszy.
+ */
+static inline uint64_t cursor_end(const gamma_t *g) {
+  if (g->sparse) {
+    return g->cells_capacity;
   }
+  return (uint64_t)g->width * g->height;
+}
 
-  if (i != (g->width - 1)) {
-    if (g->board[i + 1][j] == player) {
-      less = 1;
+/** @brief Szuka kolejnego zajętego pola planszy przed pozycją end.
+ * @param[in] g          – wskaźnik na strukturę przechowującą stan gry,
+ * @param[in,out] cursor – pozycja, od której zaczynamy szukać; po
+ *                         znalezieniu pola pozycja tuż za nim,
+ * @param[in] end        – pozycja, na której kończymy szukać,
+ * @param[out] field     – numer znalezionego pola liczony: x + y * width.
+ * @return Wartość @p true, jeśli znaleziono pole, a @p false, gdy przed
+ * pozycją @p end zajętych pól już nie ma.
+ */
+static inline bool next_taken_field_before(const gamma_t *g, uint64_t *cursor,
+  uint64_t end, uint64_t *field) {
+
+  if (g->sparse) {
+    while (*cursor < end) {
+      (*cursor)++;
+      if (g->cells[*cursor - 1].player != 0) {
+        *field = g->cells[*cursor - 1].field;
+        return true;
+      }
     }
+    return false;
   }
 
-  if (j != (g->height - 1)) {
-    if (g->board[i][j + 1] == player) {
-      less = 1;
+  while (*cursor < end) {
+    (*cursor)++;
+    if (field_owner(g, *cursor - 1) != 0) {
+      *field = *cursor - 1;
+      return true;
     }
   }
-  
-  if (is_golden == 0) {
-    result = result - less;
-  }
+  return false;
+}
 
-  // sprawdzanie czy wolnych pól przybyło, te cztery naokoło
-  // na potrzeby tej funkcji [0][0] jest na północnym zachodzie
-  // sprawdzanie czy pole na północ od [i][j] jest niesąsiadem playera
-  if (j == 0) {
-    more_north = 0;
+/** @brief Szuka kolejnego zajętego pola planszy.
+ * @param[in] g          – wskaźnik na strukturę przechowującą stan gry,
+ * @param[in,out] cursor – pozycja, od której zaczynamy szukać, na początku
+ *                         0; po znalezieniu pola pozycja tuż za nim,
+ * @param[out] field     – numer znalezionego pola liczony: x + y * width.
+ * @return Wartość @p true, jeśli znaleziono pole, a @p false, gdy zajętych
+ * pól już nie ma.
+ */
+static inline bool next_taken_field(const gamma_t *g, uint64_t *cursor,
+  uint64_t *field) {
+
+  return next_taken_field_before(g, cursor, cursor_end(g), field);
+}
+
+static void* golden_scan_run(void *arg);
+
+/** @brief Inicjuje zamki i zmienne warunkowe puli wątków pomocniczych.
+ * @param[in,out] pool – wyzerowana pula.
+ * @return Wartość @p true, jeśli się udało, a @p false w przeciwnym wypadku.
+ */
+static bool pool_init(scan_pool_t *pool) {
+  if (pthread_mutex_init(&pool->lock, NULL) != 0) {
+    return false;
   }
-  else {
-    if (g->board[i][j - 1] != 0) {
-      more_north = 0;
+  if (pthread_mutex_init(&pool->work_lock, NULL) != 0) {
+    pthread_mutex_destroy(&pool->lock);
+    return false;
+  }
+  if (pthread_cond_init(&pool->work, NULL) != 0) {
+    pthread_mutex_destroy(&pool->work_lock);
+    pthread_mutex_destroy(&pool->lock);
+    return false;
+  }
+  if (pthread_cond_init(&pool->done, NULL) != 0) {
+    pthread_cond_destroy(&pool->work);
+    pthread_mutex_destroy(&pool->work_lock);
+    pthread_mutex_destroy(&pool->lock);
+    return false;
+  }
+  return true;
+}
+
+/** @brief Pętla wątku pomocniczego: przegląda swój fragment każdego
+ * przeglądania, aż pula każe skończyć.
+ * @param[in] arg     – wskaźnik na strukturę scan_worker_t.
+ * @return Wartość NULL.
+ */
+static void* pool_worker(void *arg) {
+  scan_worker_t *worker = arg;
+  scan_pool_t *pool = worker->pool;
+
+  pthread_mutex_lock(&pool->work_lock);
+  while (true) {
+    while (!pool->quit && pool->generation == worker->seen) {
+      pthread_cond_wait(&pool->work, &pool->work_lock);
+    }
+    if (pool->quit) {
+      break;
+    }
+    worker->seen = pool->generation;
+    if (worker->index > pool->jobs) {
+      continue;
     }
-    else {
-      if (j != 1) {
-        if (g->board[i][j - 2] == player) {
-          more_north = 0;
-        }
-      }
 
-      if (i != 0) {
-        if (g->board[i - 1][j - 1] == player) {
-          more_north = 0;
-        }
-      }
+    golden_scan_t *scan = &pool->scans[worker->index];
+    pthread_mutex_unlock(&pool->work_lock);
+    golden_scan_run(scan);
+    pthread_mutex_lock(&pool->work_lock);
 
-      if (i != (g->width - 1)) {
-        if (g->board[i + 1][j - 1] == player) {
-          more_north = 0;
-        }
-      }
+    if (--pool->running == 0) {
+      pthread_cond_signal(&pool->done);
     }
   }
-  // sprawdzanie czy pole na zachód od [i][j] jest niesąsiadem playera
-  if (i == 0) {
-    more_west = 0;
+  pthread_mutex_unlock(&pool->work_lock);
+  return NULL;
+}
+
+/** @brief Kończy i czeka na wątki pomocnicze puli.
+ * Następne przeglądanie utworzy je od nowa. Żadne przeglądanie nie może
+ * wtedy trwać.
+ * @param[in,out] pool – pula.
+ */
+static void pool_stop(scan_pool_t *pool) {
+  pthread_mutex_lock(&pool->work_lock);
+  pool->quit = true;
+  pthread_cond_broadcast(&pool->work);
+  pthread_mutex_unlock(&pool->work_lock);
+
+  for (uint32_t i = 0; i < pool->size; i++) {
+    pthread_join(pool->ids[i], NULL);
   }
-  else {
-    if (g->board[i - 1][j] != 0) {
-      more_west = 0;
-    }
-    else {
-      if (i != 1) {
-        if (g->board[i - 2][j] == player) {
-          more_west = 0;
-        }
-      }
+  free(pool->ids);
+  free(pool->workers);
+  pool->ids = NULL;
+  pool->workers = NULL;
+  pool->size = 0;
+  pool->started = false;
+  pool->quit = false;
+}
 
-      if (j != 0) {
-        if (g->board[i - 1][j - 1] == player) {
-          more_west = 0;
-        }
-      }
+/** @brief Kończy wątki pomocnicze i zwalnia zamki puli.
+ * @param[in,out] pool – pula.
+ */
+static void pool_destroy(scan_pool_t *pool) {
+  pool_stop(pool);
+  pthread_cond_destroy(&pool->done);
+  pthread_cond_destroy(&pool->work);
+  pthread_mutex_destroy(&pool->work_lock);
+  pthread_mutex_destroy(&pool->lock);
+}
 
-      if (j != (g->height - 1)) {
-        if (g->board[i - 1][j + 1] == player) {
-          more_west = 0;
+/** @brief Zajmuje pulę do rozdzielenia fragmentów przeglądania.
+ * Przy pierwszym użyciu tworzy wątki pomocnicze. Gdy pulę zajmuje inny
+ * wątek, nie czeka na nią.
+ * @param[in,out] pool  – pula,
+ * @param[in] size      – liczba wątków pomocniczych tworzonych przy
+ *                        pierwszym użyciu,
+ * @param[in] helpers   – potrzebna liczba wątków pomocniczych.
+ * @return Liczba wątków pomocniczych do dyspozycji; gdy jest dodatnia,
+ * wątek trzyma lock puli i musi ją zwolnić przez pool_run.
+ */
+static uint32_t pool_acquire(scan_pool_t *pool, uint32_t size,
+  uint32_t helpers) {
+
+  if (pthread_mutex_trylock(&pool->lock) != 0) {
+    return 0;
+  }
+  if (!pool->started) {
+    pool->started = true;
+    pool->ids = calloc(size, sizeof(pthread_t));
+    pool->workers = calloc(size, sizeof(scan_worker_t));
+    if (pool->ids != NULL && pool->workers != NULL) {
+      // wątek, którego nie udało się utworzyć, zastępuje wywołujący
+      while (pool->size < size) {
+        scan_worker_t *worker = &pool->workers[pool->size];
+
+        // przeglądania sprzed utworzenia wątku już się skończyły
+        worker->pool = pool;
+        worker->index = pool->size + 1;
+        worker->seen = pool->generation;
+        if (pthread_create(&pool->ids[pool->size], NULL, pool_worker,
+          worker) != 0) {
+
+          break;
         }
+        pool->size++;
       }
     }
   }
-  // sprawdzanie czy pole na południe od [i][j] jest niesąsiadem playera
-  if (j == (g->height - 1)) {
-    more_south = 0;
+  if (pool->size == 0) {
+    pthread_mutex_unlock(&pool->lock);
+    return 0;
+  }
+  return helpers < pool->size ? helpers : pool->size;
+}
+
+/** @brief Przegląda fragmenty w wątku wywołującym i wątkach pomocniczych.
+ * Fragment 0 przegląda wątek wywołujący, fragment i wątek pomocniczy i.
+ * Potem zwalnia pulę zajętą przez pool_acquire.
+ * @param[in,out] pool  – pula,
+ * @param[in,out] scans – fragmenty przeglądania,
+ * @param[in] jobs      – liczba fragmentów dla wątków pomocniczych.
+ */
+static void pool_run(scan_pool_t *pool, golden_scan_t *scans, uint32_t jobs) {
+  pthread_mutex_lock(&pool->work_lock);
+  pool->scans = scans;
+  pool->jobs = jobs;
+  pool->running = jobs;
+  pool->generation++;
+  pthread_cond_broadcast(&pool->work);
+  pthread_mutex_unlock(&pool->work_lock);
+
+  golden_scan_run(&scans[0]);
+
+  pthread_mutex_lock(&pool->work_lock);
+  while (pool->running > 0) {
+    pthread_cond_wait(&pool->done, &pool->work_lock);
+  }
+  pthread_mutex_unlock(&pool->work_lock);
+  pthread_mutex_unlock(&pool->lock);
+}
+
+gamma_t* gamma_new(uint32_t width, uint32_t height,
+                   uint32_t players, uint32_t areas) {
+
+  gamma_t *g = NULL;
+
+  if ((width == 0 || height == 0) || (players == 0 || areas == 0)) {
+    return g;
   }
   else {
-    if (g->board[i][j + 1] != 0) {
-      more_south = 0;
+    uint64_t fields = (uint64_t)width * height;
+
+    g = calloc(1, sizeof(gamma_t));
+    if (g == NULL) {
+      return NULL;
+    }
+    if (pthread_rwlock_init(&g->lock, NULL) != 0) {
+      free(g);
+      return NULL;
+    }
+    if (pthread_mutex_init(&g->cache_lock, NULL) != 0) {
+      pthread_rwlock_destroy(&g->lock);
+      free(g);
+      return NULL;
+    }
+    if (pthread_mutex_init(&g->split_lock, NULL) != 0) {
+      pthread_mutex_destroy(&g->cache_lock);
+      pthread_rwlock_destroy(&g->lock);
+      free(g);
+      return NULL;
+    }
+    if (!pool_init(&g->pool)) {
+      pthread_mutex_destroy(&g->split_lock);
+      pthread_mutex_destroy(&g->cache_lock);
+      pthread_rwlock_destroy(&g->lock);
+      free(g);
+      return NULL;
     }
-    else {
-      if (j != (g->height - 2)) {
-        if (g->board[i][j + 2] == player) {
-          more_south = 0;
-        }
-      }
 
-      if (i != 0) {
-        if (g->board[i - 1][j + 1] == player) {
-          more_south = 0;
-        }
+    uint8_t cell_size = 4;
+    if (players <= UINT8_MAX) {
+      cell_size = 1;
+    }
+    else if (players <= UINT16_MAX) {
+      cell_size = 2;
+    }
+    uint8_t index_size = 8;
+    if (fields - 1 <= UINT32_MAX) {
+      index_size = 4;
+    }
+
+    g->golden = calloc(players, sizeof(bool));
+    g->fields_taken = calloc(players, sizeof(uint64_t));
+    g->free_fields_around = calloc(players, sizeof(uint64_t));
+    g->areas_taken = calloc(players, sizeof(uint64_t));
+    g->split_dirty = calloc(players, sizeof(bool));
+    g->player_generation = calloc(players, sizeof(uint64_t));
+    g->golden_cache = calloc(players, sizeof(golden_cache_t));
+    g->candidates = calloc(players, sizeof(candidate_list_t));
+    gamma_set_threads(g, 0);
+
+    if (g->golden == NULL || g->fields_taken == NULL ||
+      g->free_fields_around == NULL || g->areas_taken == NULL ||
+      g->split_dirty == NULL || g->player_generation == NULL ||
+      g->golden_cache == NULL || g->candidates == NULL) {
+
+      gamma_delete(g);
+      return NULL;
+    }
+
+    // duże plansze trzymamy rzadko, tak samo gdy gęsta się nie mieści
+    g->sparse = true;
+    if (fields <= GAMMA_SPARSE_FIELDS &&
+      fields <= SIZE_MAX / sizeof(uint64_t)) {
+      // każda tablica planszy to jeden spójny blok, pole (x, y) leży pod
+      // indeksem x + y * width
+      g->board = calloc(fields, cell_size);
+      g->rank = calloc(fields, sizeof(uint8_t));
+      g->parent = malloc(fields * index_size);
+
+      if (g->board != NULL && g->rank != NULL && g->parent != NULL) {
+
+        g->sparse = false;
+      }
+      else {
+        free(g->board);
+        free(g->rank);
+        free(g->parent);
+        g->board = NULL;
+        g->rank = NULL;
+        g->parent = NULL;
       }
+    }
 
-      if (i != (g->width - 1)) {
-        if (g->board[i + 1][j + 1] == player) {
-          more_south = 0;
-        }
+    if (g->sparse) {
+      g->cells = calloc(SPARSE_INITIAL_CAPACITY, sizeof(sparse_field_t));
+      if (g->cells == NULL) {
+        gamma_delete(g);
+        return NULL;
       }
+      g->cells_capacity = SPARSE_INITIAL_CAPACITY;
+      // SPARSE_INITIAL_CAPACITY = 2^6
+      g->cells_shift = 64 - 6;
     }
-  }
-  // sprawdzanie czy pole na wschód od [i][j] jest niesąsiadem playera
-  if (i == (g->width - 1)) {
-    more_east = 0;
-  }
-  else {
-    if (g->board[i + 1][j] != 0) {
-      more_east = 0;
+
+    g->cell_size = cell_size;
+    g->index_size = index_size;
+    if (g->sparse) {
+      g->layout = LAYOUT_SPARSE;
     }
     else {
-      if (i != (g->width - 2)) {
-        if (g->board[i + 2][j] == player) {
-          more_east = 0;
-        }
-      }
+      // LAYOUT_8_32, LAYOUT_16_32, LAYOUT_32_32, potem to samo z 64
+      g->layout = LAYOUT_8_32 + (cell_size == 2) + 2 * (cell_size == 4) +
+        3 * (index_size == 8);
+    }
+    g->width = width;
+    g->height = height;
+    g->players = players;
+    g->areas = areas;
+    g->free_fields = fields;
 
-      if (j != 0) {
-        if (g->board[i + 1][j - 1] == player) {
-          more_east = 0;
-        }
+    if (!g->sparse) {
+      for (uint64_t i = 0; i < fields; i++) {
+        set_parent(g, i, i);
       }
+    }
 
-      if (j != (g->height - 1)) {
-        if (g->board[i + 1][j + 1] == player) {
-          more_east = 0;
-        }
+    return g;
+  }
+}
+
+void gamma_delete(gamma_t *g) {
+  if (g != NULL) {
+    free(g->golden);
+    free(g->fields_taken);
+    free(g->free_fields_around);
+    free(g->areas_taken);
+    free(g->cells);
+    free(g->board);
+    free(g->rank);
+    free(g->parent);
+    free(g->journal);
+    free(g->stack);
+    free(g->split_dirty);
+    free(g->split);
+    free(g->order);
+    free(g->frames);
+    free(g->player_generation);
+    free(g->golden_cache);
+    if (g->candidates != NULL) {
+      for (uint32_t i = 0; i < g->players; i++) {
+        free(g->candidates[i].fields);
       }
     }
+    free(g->candidates);
+    pool_destroy(&g->pool);
+    pthread_mutex_destroy(&g->split_lock);
+    pthread_mutex_destroy(&g->cache_lock);
+    pthread_rwlock_destroy(&g->lock);
+    free(g);
   }
-  result = result + more_north + more_west + more_south + more_east;
-  return result;
 }
 
-bool gamma_move(gamma_t *g, uint32_t player, uint32_t x, uint32_t y) {
-  if ((g == NULL || player == 0) || ((x >= g->width) || (y >= g->height))) {
-    return false;
+/** @brief find z algorytmu Find & Union, skraca ścieżkę do korzenia.
+ * Silnik zbierający liczniki dolicza długość ścieżki do korzenia.
+ * @param[in,out] g  – wskaźnik na strukturę przechowującą stan gry,
+ * @param[in] layout – sposób przechowywania planszy @p g,
+ * @param[in] name   – numer pola liczony: x + y * width.
+ * @return numer pola, do którego dojdzie algorytm.
+ */
+SPECIALIZED uint64_t find_in(gamma_t *g, layout_t layout, uint64_t name) {
+  uint64_t root = name;
+  STATS_ONLY(uint64_t depth = 0);
+
+  while (parent_in(g, layout, root) != root) {
+    root = parent_in(g, layout, root);
+    STATS_ONLY(depth++);
+  }
+#ifdef GAMMA_STATS
+  if (depth >= GAMMA_STATS_FIND_DEPTHS) {
+    depth = GAMMA_STATS_FIND_DEPTHS - 1;
+  }
+  STATS_ADD(g, find_depth[depth], 1);
+#endif
+
+  // podpinamy pola ze ścieżki bezpośrednio pod korzeń
+  while (name != root) {
+    uint64_t parent = parent_in(g, layout, name);
+
+    if (parent != root) {
+      set_parent_in(g, layout, name, root);
+    }
+    name = parent;
+  }
+  return root;
+}
+
+/** @brief union z algorytmu Find & Union, łączy korzenie dwóch obszarów.
+ * @param[in,out] g  – wskaźnik na strukturę przechowującą stan gry,
+ * @param[in] layout – sposób przechowywania planszy @p g,
+ * @param[in] name_1 – korzeń pierwszego obszaru,
+ * @param[in] name_2 – korzeń drugiego, innego obszaru.
+ */
+SPECIALIZED void union_roots(gamma_t *g, layout_t layout, uint64_t name_1,
+  uint64_t name_2) {
+
+  uint8_t rank_1 = get_rank_in(g, layout, name_1);
+  uint8_t rank_2 = get_rank_in(g, layout, name_2);
+
+  STATS_ADD(g, unions, 1);
+  if (rank_1 > rank_2) {
+    set_parent_in(g, layout, name_2, name_1);
+  }
+  else if (rank_1 < rank_2) {
+    set_parent_in(g, layout, name_1, name_2);
   }
   else {
-    if ((g->board[x][y] != 0) || (player > g->players)) {
-      return false;
+    set_parent_in(g, layout, name_2, name_1);
+    set_rank_in(g, layout, name_1, rank_1 + 1);
+  }
+}
+
+/** @brief Łączy pole @p field z polem @p neighbor, jeśli należą do gracza.
+ * Przy połączeniu dwóch różnych obszarów zmniejsza ich liczbę u gracza.
+ * @param[in,out] g    – wskaźnik na strukturę przechowującą stan gry,
+ * @param[in] layout   – sposób przechowywania planszy @p g,
+ * @param[in] player   – numer gracza, do którego należy pole @p field,
+ * @param[in] field    – numer pola liczony: x + y * width,
+ * @param[in] neighbor – numer sąsiedniego pola liczony: x + y * width.
+ */
+SPECIALIZED void union_neighbor(gamma_t *g, layout_t layout, uint32_t player,
+  uint64_t field, uint64_t neighbor) {
+
+  if (owner_in(g, layout, neighbor) == player) {
+    uint64_t root = find_in(g, layout, field);
+    uint64_t neighbor_root = find_in(g, layout, neighbor);
+
+    if (root != neighbor_root) {
+      g->areas_taken[player - 1]--;
+      union_roots(g, layout, root, neighbor_root);
     }
-    else {
-      if (g->areas_taken[player - 1] == g->areas) {
-        bool over_areas = 1;
-        
-        if (x != 0) {
-          if (g->board[x - 1][y] == player) {
-            over_areas = 0;
-          }
-        }
+  }
+}
 
-        if (y != 0) {
-          if (g->board[x][y - 1] == player) {
-            over_areas = 0;
-          }
-        }
+/** @brief Unionuje pole [x][y] z sąsiadami jeśli są tego samego gracza.
+ * Łączy pola tego samego gracza, jednocześnie aktualizując ilość obszarów.
+ * Zakłada poprawność danych jako, że jest to funckja pomocnicza.
+ * @param[in,out] g   – wskaźnik na strukturę przechowującą stan gry,
+ * @param[in] layout  – sposób przechowywania planszy @p g,
+ * @param[in] player  – numer gracza, liczba dodatnia niewiększa od wartości
+ *                      @p players z funkcji @ref gamma_new,
+ * @param[in] x       – numer kolumny, liczba nieujemna mniejsza od wartości
+ *                      @p width z funkcji @ref gamma_new,
+ * @param[in] y       – numer wiersza, liczba nieujemna mniejsza od wartości
+ *                      @p height z funkcji @ref gamma_new.
+ */
+SPECIALIZED void union_helper_in(gamma_t *g, layout_t layout, uint32_t player,
+  uint32_t x, uint32_t y) {
 
-        if (x != (g->width - 1)) {
-          if (g->board[x + 1][y] == player) {
-            over_areas = 0;
-          }
-        }
+  uint64_t field = x + (uint64_t)y * g->width;
 
-        if (y != (g->height - 1)) {
-          if (g->board[x][y + 1] == player) {
-            over_areas = 0;
-          }
-        }
+  TRACE_BEGIN(TRACE_UNION, player, x, y);
+  if (x != 0) {
+    union_neighbor(g, layout, player, field, field - 1);
+  }
+
+  if (y != 0) {
+    union_neighbor(g, layout, player, field, field - g->width);
+  }
+
+  if (x != (g->width - 1)) {
+    union_neighbor(g, layout, player, field, field + 1);
+  }
+
+  if (y != (g->height - 1)) {
+    union_neighbor(g, layout, player, field, field + g->width);
+  }
+  TRACE_END(TRACE_UNION, g->areas_taken[player - 1]);
+}
+
+/** @brief Unionuje pole [x][y] z sąsiadami jeśli są tego samego gracza.
+ * @param[in,out] g   – wskaźnik na strukturę przechowującą stan gry,
+ * @param[in] player  – numer gracza,
+ * @param[in] x       – numer kolumny,
+ * @param[in] y       – numer wiersza.
+ */
+static void Union_helper(gamma_t *g, uint32_t player, uint32_t x, uint32_t y) {
+  union_helper_in(g, g->layout, player, x, y);
+}
+
+/** @brief Odwiedza pole w przeszukiwaniu obszaru gracza.
+ * Jeśli pole należy do gracza @p owner i nie było jeszcze odwiedzone,
+ * oznacza je i podpina pod korzeń @p root.
+ * @param[in,out] g – wskaźnik na strukturę przechowującą stan gry,
+ * @param[in] owner – numer gracza, którego obszar przeszukujemy,
+ * @param[in] field – numer pola liczony: x + y * width,
+ * @param[in] root  – numer pola, które jest korzeniem nowego obszaru.
+ * @return Wartość @p true, jeśli pole zostało odwiedzone teraz.
+ */
+static inline bool visit_field(gamma_t *g, uint32_t owner, uint64_t field,
+  uint64_t root) {
+
+  if (field_owner(g, field) != owner ||
+    (*rank_byte(g, field) & RANK_VISITED) != 0) {
+
+    return false;
+  }
+
+  set_parent(g, field, root);
+  set_rank(g, field, field == root);
+  *rank_byte(g, field) |= RANK_VISITED;
+  return true;
+}
+
+/** @brief Buduje od nowa obszar gracza zawierający pole @p start.
+ * Przeszukuje obszar w głąb i podpina wszystkie jego pola bezpośrednio pod
+ * @p start. Pola zostają oznaczone jako odwiedzone aż do zatwierdzenia lub
+ * cofnięcia dziennika, więc obszaru nie da się zbudować drugi raz.
+ * @param[in,out] g – wskaźnik na strukturę przechowującą stan gry,
+ * @param[in] owner – numer gracza, którego obszar budujemy,
+ * @param[in] start – numer pola liczony: x + y * width.
+ * @return 1, jeśli zbudowano nowy obszar, a 0, gdy pole nie należy do
+ * gracza lub zostało już odwiedzone.
+ */
+static uint64_t relabel_area(gamma_t *g, uint32_t owner, uint64_t start) {
+  uint64_t top = 0;
+
+  if (!visit_field(g, owner, start, start)) {
+    return 0;
+  }
+
+  // każde pole trafia na stos raz, więc wystarczy miejsce na pola gracza
+  g->stack[top++] = start;
+  while (top > 0) {
+    uint64_t field = g->stack[--top];
+    uint32_t x = field % g->width;
+    uint32_t y = field / g->width;
+
+    if (x != 0 && visit_field(g, owner, field - 1, start)) {
+      g->stack[top++] = field - 1;
+    }
+    if (y != 0 && visit_field(g, owner, field - g->width, start)) {
+      g->stack[top++] = field - g->width;
+    }
+    if (x != (g->width - 1) && visit_field(g, owner, field + 1, start)) {
+      g->stack[top++] = field + 1;
+    }
+    if (y != (g->height - 1) &&
+      visit_field(g, owner, field + g->width, start)) {
+
+      g->stack[top++] = field + g->width;
+    }
+  }
+
+  return 1;
+}
+
+/** @brief Przenosi pole (x, y) z obszarów @p robbed_player do @p player.
+ * Na planszy pole musi już należeć do @p player, a dziennik musi być
+ * włączony z miejscem na pola obu graczy. Przelicza find&union tylko
+ * w obszarze, z którego zabrano pole: buduje go od nowa od każdego sąsiada
+ * pola, a liczby obszarów obu graczy poprawia przyrostowo.
+ * @param[in,out] g        – wskaźnik na strukturę przechowującą stan gry,
+ * @param[in] player        – numer gracza wykonującego złoty ruch,
+ * @param[in] robbed_player – numer gracza, któremu zabieramy pole,
+ * @param[in] x             – numer kolumny pola,
+ * @param[in] y             – numer wiersza pola.
+ */
+static void steal_field(gamma_t *g, uint32_t player, uint32_t robbed_player,
+  uint32_t x, uint32_t y) {
+
+  uint64_t field = x + (uint64_t)y * g->width;
+  uint64_t pieces = 0;
+
+  set_parent(g, field, field);
+  set_rank(g, field, 0);
+
+  // obszar, z którego zabrano pole, rozpada się na co najwyżej 4 kawałki
+  TRACE_BEGIN(TRACE_RELABEL, robbed_player, x, y);
+  if (x != 0) {
+    pieces = pieces + relabel_area(g, robbed_player, field - 1);
+  }
+  if (y != 0) {
+    pieces = pieces + relabel_area(g, robbed_player, field - g->width);
+  }
+  if (x != (g->width - 1)) {
+    pieces = pieces + relabel_area(g, robbed_player, field + 1);
+  }
+  if (y != (g->height - 1)) {
+    pieces = pieces + relabel_area(g, robbed_player, field + g->width);
+  }
+  TRACE_END(TRACE_RELABEL, pieces);
+  g->areas_taken[robbed_player - 1] =
+    g->areas_taken[robbed_player - 1] - 1 + pieces;
+
+  g->areas_taken[player - 1]++;
+  Union_helper(g, player, x, y);
+}
+
+/** @brief Podaje numer pola w kolejności przeszukiwania w głąb.
+ * @param[in] g     – wskaźnik na strukturę przechowującą stan gry,
+ * @param[in] field – numer pola liczony: x + y * width.
+ * @return Numer pola nadany przy ostatnim przeszukiwaniu lub 0.
+ */
+static inline uint64_t get_order(const gamma_t *g, uint64_t field) {
+  if (g->sparse) {
+    return sparse_slot(g, field)->order;
+  }
+  if (g->index_size == 4) {
+    return ((const uint32_t *)g->order)[field];
+  }
+  return ((const uint64_t *)g->order)[field];
+}
+
+/** @brief Ustawia numer pola w kolejności przeszukiwania w głąb.
+ * @param[in,out] g – wskaźnik na strukturę przechowującą stan gry,
+ * @param[in] field – numer pola liczony: x + y * width,
+ * @param[in] order – nowy numer pola.
+ */
+static inline void set_order(gamma_t *g, uint64_t field, uint64_t order) {
+  if (g->sparse) {
+    sparse_slot(g, field)->order = order;
+  }
+  else if (g->index_size == 4) {
+    ((uint32_t *)g->order)[field] = order;
+  }
+  else {
+    ((uint64_t *)g->order)[field] = order;
+  }
+}
+
+/** @brief Podaje, na ile kawałków rozpadnie się obszar bez danego pola.
+ * Wartość jest aktualna, gdy pola gracza nie są oznaczone w split_dirty.
+ * @param[in] g     – wskaźnik na strukturę przechowującą stan gry,
+ * @param[in] field – numer pola liczony: x + y * width.
+ * @return Liczba kawałków, od 0 dla samotnego pola do 4.
+ */
+static inline uint8_t get_split(const gamma_t *g, uint64_t field) {
+  if (g->sparse) {
+    return sparse_slot(g, field)->split;
+  }
+  return g->split[field];
+}
+
+/** @brief Ustawia, na ile kawałków rozpadnie się obszar bez danego pola.
+ * @param[in,out] g – wskaźnik na strukturę przechowującą stan gry,
+ * @param[in] field – numer pola liczony: x + y * width,
+ * @param[in] split – liczba kawałków.
+ */
+static inline void set_split(gamma_t *g, uint64_t field, uint8_t split) {
+  if (g->sparse) {
+    sparse_slot(g, field)->split = split;
+  }
+  else {
+    g->split[field] = split;
+  }
+}
+
+/** @brief Podaje sąsiada pola w danym kierunku.
+ * @param[in] g         – wskaźnik na strukturę przechowującą stan gry,
+ * @param[in] field     – numer pola liczony: x + y * width,
+ * @param[in] direction – kierunek: 0 zachód, 1 południe, 2 wschód, 3 północ,
+ * @param[out] neighbor – numer sąsiedniego pola.
+ * @return Wartość @p false, gdy w tym kierunku jest brzeg planszy.
+ */
+static inline bool neighbor_field(const gamma_t *g, uint64_t field,
+  uint8_t direction, uint64_t *neighbor) {
+
+  uint32_t x = field % g->width;
+  uint32_t y = field / g->width;
+
+  switch (direction) {
+    case 0:
+      *neighbor = field - 1;
+      return x != 0;
+    case 1:
+      *neighbor = field - g->width;
+      return y != 0;
+    case 2:
+      *neighbor = field + 1;
+      return x != (g->width - 1);
+    default:
+      *neighbor = field + g->width;
+      return y != (g->height - 1);
+  }
+}
+
+/** @brief Kładzie ramkę pola na stos przeszukiwania w głąb.
+ * @param[in,out] g  – wskaźnik na strukturę przechowującą stan gry,
+ * @param[in] top    – liczba ramek na stosie,
+ * @param[in] field  – numer odwiedzanego pola,
+ * @param[in] parent – numer pola, z którego przyszliśmy.
+ * @return Wartość @p false, gdy nie udało się zaalokować pamięci.
+ */
+static bool push_frame(gamma_t *g, uint64_t top, uint64_t field,
+  uint64_t parent) {
+
+  if (top == g->frames_capacity) {
+    uint64_t capacity = 2 * g->frames_capacity + 16;
+    dfs_frame_t *frames = realloc(g->frames, capacity * sizeof(dfs_frame_t));
+    if (frames == NULL) {
+      return false;
+    }
+    g->frames = frames;
+    g->frames_capacity = capacity;
+  }
+
+  g->order_clock++;
+  set_order(g, field, g->order_clock);
+  g->frames[top].field = field;
+  g->frames[top].parent = parent;
+  g->frames[top].order = g->order_clock;
+  g->frames[top].low = g->order_clock;
+  g->frames[top].direction = 0;
+  g->frames[top].children = 0;
+  g->frames[top].cut_children = 0;
+  return true;
+}
+
+/** @brief Wylicza split wszystkich pól obszaru zawierającego pole @p start.
+ * Szuka punktów artykulacji obszaru algorytmem Tarjana: po zabraniu korzenia
+ * przeszukiwania zostaje tyle kawałków, ile ma on dzieci, a po zabraniu
+ * innego pola – jeden kawałek z rodzicem i po jednym na każde dziecko,
+ * z którego poddrzewa nie da się ominąć pola.
+ * @param[in,out] g – wskaźnik na strukturę przechowującą stan gry,
+ * @param[in] owner – numer gracza, do którego należy obszar,
+ * @param[in] start – numer pola liczony: x + y * width,
+ * @param[in] base  – numery nie większe od @p base są z poprzednich
+ *                    przeszukiwań, a ich pola nie były jeszcze odwiedzone.
+ * @return Wartość @p false, gdy nie udało się zaalokować pamięci.
+ */
+static bool split_area(gamma_t *g, uint32_t owner, uint64_t start,
+  uint64_t base) {
+
+  uint64_t top = 0;
+
+  if (!push_frame(g, top, start, start)) {
+    return false;
+  }
+  top++;
+
+  while (top > 0) {
+    dfs_frame_t *frame = &g->frames[top - 1];
+
+    if (frame->direction < 4) {
+      uint8_t direction = frame->direction;
+      uint64_t neighbor;
+
+      frame->direction++;
+      if (neighbor_field(g, frame->field, direction, &neighbor) &&
+        field_owner(g, neighbor) == owner) {
+
+        uint64_t order = get_order(g, neighbor);
+        if (order <= base) {
+          frame->children++;
+          // push_frame może przenieść stos, więc frame jest dalej nieważny
+          if (!push_frame(g, top, neighbor, frame->field)) {
+            return false;
+          }
+          top++;
+        }
+        else if (neighbor != frame->parent && order < frame->low) {
+          frame->low = order;
+        }
+      }
+    }
+    else {
+      top--;
+      if (top == 0) {
+        set_split(g, frame->field, frame->children);
+      }
+      else {
+        dfs_frame_t *parent = &g->frames[top - 1];
+
+        set_split(g, frame->field, frame->cut_children + 1);
+        if (frame->low < parent->low) {
+          parent->low = frame->low;
+        }
+        if (frame->low >= parent->order) {
+          parent->cut_children++;
+        }
+      }
+    }
+  }
+
+  return true;
+}
+
+/** @brief Uaktualnia wartości split pól graczy oznaczonych w split_dirty.
+ * Pomija gracza @p player, jego pól nie bierzemy pod uwagę.
+ * @param[in,out] g   – wskaźnik na strukturę przechowującą stan gry,
+ * @param[in] player  – numer gracza, którego pól nie uaktualniamy,
+ *                      albo 0, gdy uaktualniamy pola wszystkich graczy.
+ * @return Wartość @p false, gdy nie udało się zaalokować pamięci.
+ */
+static bool refresh_splits(gamma_t *g, uint32_t player) {
+  bool dirty = false;
+  for (uint32_t i = 0; i < g->players; i++) {
+    if (g->split_dirty[i] && i != player - 1) {
+      dirty = true;
+    }
+  }
+  if (!dirty) {
+    return true;
+  }
+
+  uint64_t fields = (uint64_t)g->width * g->height;
+  if (!g->sparse && g->split == NULL) {
+    g->split = malloc(fields * sizeof(uint8_t));
+    g->order = calloc(fields, g->index_size);
+    if (g->split == NULL || g->order == NULL) {
+      free(g->split);
+      free(g->order);
+      g->split = NULL;
+      g->order = NULL;
+      return false;
+    }
+  }
+
+  // numery przeszukiwania muszą się mieścić w tablicy order
+  uint64_t taken = fields - g->free_fields;
+  if (!g->sparse && g->index_size == 4 &&
+    g->order_clock > UINT32_MAX - taken) {
+
+    memset(g->order, 0, fields * g->index_size);
+    g->order_clock = 0;
+  }
+
+  uint64_t base = g->order_clock;
+  uint64_t cursor = 0;
+  uint64_t field;
+
+  STATS_ADD(g, split_rebuilds, 1);
+  while (next_taken_field(g, &cursor, &field)) {
+    uint32_t owner = field_owner(g, field);
+
+    STATS_ADD(g, split_rebuild_cells, 1);
+    if (owner != player && g->split_dirty[owner - 1] &&
+      get_order(g, field) <= base) {
+
+      if (!split_area(g, owner, field, base)) {
+        return false;
+      }
+    }
+  }
+
+  for (uint32_t i = 0; i < g->players; i++) {
+    if (i != player - 1) {
+      g->split_dirty[i] = false;
+    }
+  }
+  // pola ponumerowane przez przeszukiwania w głąb
+  STATS_ADD(g, split_rebuild_cells, g->order_clock - base);
+
+  return true;
+}
+
+/** @brief Sprawdza, czy pole jest cudze i sąsiaduje z polem gracza.
+ * @param[in] g       – wskaźnik na strukturę przechowującą stan gry,
+ * @param[in] player  – numer gracza,
+ * @param[in] field   – zajęte pole planszy.
+ * @return Numer właściciela pola, jeśli pole jest kandydatem do złotego
+ * ruchu gracza, a 0 w przeciwnym przypadku.
+ */
+static uint32_t golden_candidate(const gamma_t *g, uint32_t player,
+  uint64_t field) {
+
+  uint32_t robbed_player = field_owner(g, field);
+
+  if (robbed_player != player) {
+    for (uint8_t direction = 0; direction < 4; direction++) {
+      uint64_t neighbor;
+
+      if (neighbor_field(g, field, direction, &neighbor) &&
+        field_owner(g, neighbor) == player) {
+
+        return robbed_player;
+      }
+    }
+  }
+  return 0;
+}
+
+/** @brief Dopisuje pole do listy kandydatów gracza.
+ * Gdy na liście brakuje miejsca, najpierw usuwa z niej pola, które
+ * przestały być kandydatami, a listę powiększa dopiero wtedy, gdy zostało
+ * ich ponad pół. Gdy zabraknie pamięci, listę porzuca, a gracz szuka
+ * kandydatów na całej planszy.
+ * @param[in,out] g   – wskaźnik na strukturę przechowującą stan gry,
+ * @param[in] player  – numer gracza,
+ * @param[in] field   – cudze pole sąsiadujące z polem gracza.
+ */
+static void candidate_push(gamma_t *g, uint32_t player, uint64_t field) {
+  candidate_list_t *list = &g->candidates[player - 1];
+
+  if (list->lost) {
+    return;
+  }
+  if (list->length == list->capacity) {
+    uint64_t kept = 0;
+
+    for (uint64_t i = 0; i < list->length; i++) {
+      if (golden_candidate(g, player, list->fields[i]) != 0) {
+        list->fields[kept++] = list->fields[i];
+      }
+    }
+    list->length = kept;
+
+    if (kept > list->capacity / 2) {
+      uint64_t capacity = 2 * list->capacity;
+      uint64_t *fields = realloc(list->fields, capacity * sizeof(uint64_t));
+
+      if (fields == NULL) {
+        free(list->fields);
+        *list = (candidate_list_t){ .lost = true };
+        return;
+      }
+      list->fields = fields;
+      list->capacity = capacity;
+    }
+    else if (list->capacity == 0) {
+      list->fields = malloc(CANDIDATES_INITIAL_CAPACITY * sizeof(uint64_t));
+      if (list->fields == NULL) {
+        list->lost = true;
+        return;
+      }
+      list->capacity = CANDIDATES_INITIAL_CAPACITY;
+    }
+  }
+  list->fields[list->length++] = field;
+}
+
+/** @brief Unieważnia odpowiedzi zależne od pola (x, y) po ruchu gracza.
+ * Zwiększa pokolenie planszy, gracza @p player i graczy, których pionki
+ * sąsiadują z polem, bo stanął obok nich cudzy pionek. Pole staje się
+ * kandydatem do złotego ruchu tych graczy, a ich sąsiednie pola kandydatami
+ * gracza @p player.
+ * @param[in,out] g   – wskaźnik na strukturę przechowującą stan gry,
+ * @param[in] layout  – sposób przechowywania planszy @p g,
+ * @param[in] player  – numer gracza, który postawił pionek na polu,
+ * @param[in] x       – numer kolumny pola,
+ * @param[in] y       – numer wiersza pola.
+ */
+SPECIALIZED void touch_field_in(gamma_t *g, layout_t layout, uint32_t player,
+  uint32_t x, uint32_t y) {
+
+  uint64_t field = x + (uint64_t)y * g->width;
+
+  g->board_generation++;
+  g->player_generation[player - 1]++;
+
+  for (uint8_t direction = 0; direction < 4; direction++) {
+    uint64_t neighbor;
+
+    if (neighbor_field(g, field, direction, &neighbor)) {
+      uint32_t owner = owner_in(g, layout, neighbor);
+
+      if (owner != 0 && owner != player) {
+        g->player_generation[owner - 1]++;
+        candidate_push(g, owner, field);
+        candidate_push(g, player, neighbor);
+      }
+    }
+  }
+}
+
+/** @brief Unieważnia odpowiedzi zależne od pola (x, y) po ruchu gracza.
+ * @param[in,out] g   – wskaźnik na strukturę przechowującą stan gry,
+ * @param[in] player  – numer gracza, który postawił pionek na polu,
+ * @param[in] x       – numer kolumny pola,
+ * @param[in] y       – numer wiersza pola.
+ */
+static void touch_field(gamma_t *g, uint32_t player, uint32_t x, uint32_t y) {
+  touch_field_in(g, g->layout, player, x, y);
+}
+
+/** @brief zmiana wolnych pól po dodaniu pionka player na pole [i][j]
+ * @param[in] g – wskaźnik na strukturę przechowującą stan gry.
+ * @param[in] layout – sposób przechowywania planszy @p g.
+ * @param[in] i - pierwsza współrzędna polożenia pionka.
+ * @param[in] j - druga współrzędna polożenia pionka.
+ * @param[in] player – numer gracza którego pionek stawiamy.
+ * @param[in] is_golden – czy wykonujemy to dodanie złotym ruchem.
+ * @return Ile trzeba dodać playerowi wolnych pól po postawieniu pionka.
+ */
+SPECIALIZED int delta_in(gamma_t *g, layout_t layout,
+  uint32_t i, uint32_t j, uint32_t player, bool is_golden) {
+
+  uint64_t field = i + (uint64_t)j * g->width;
+  int result = 0;
+  bool less = 0;
+  bool more_north = 1;
+  bool more_west = 1;
+  bool more_south = 1;
+  bool more_east = 1;
+
+  // sprawdzanie czy pole [i][j] przestało być wolnym polem
+  if (i != 0) {
+    if (owner_in(g, layout, field - 1) == player) {
+      less = 1;
+    }
+  }
+
+  if (j != 0) {
+    if (owner_in(g, layout, field - g->width) == player) {
+      less = 1;
+    }
+  }
+
+  if (i != (g->width - 1)) {
+    if (owner_in(g, layout, field + 1) == player) {
+      less = 1;
+    }
+  }
+
+  if (j != (g->height - 1)) {
+    if (owner_in(g, layout, field + g->width) == player) {
+      less = 1;
+    }
+  }
+  
+  if (is_golden == 0) {
+    result = result - less;
+  }
+
+  // sprawdzanie czy wolnych pól przybyło, te cztery naokoło
+  // na potrzeby tej funkcji [0][0] jest na północnym zachodzie
+  // sprawdzanie czy pole na północ od [i][j] jest niesąsiadem playera
+  if (j == 0) {
+    more_north = 0;
+  }
+  else {
+    if (owner_in(g, layout, field - g->width) != 0) {
+      more_north = 0;
+    }
+    else {
+      if (j != 1) {
+        if (owner_in(g, layout, field - 2 * g->width) == player) {
+          more_north = 0;
+        }
+      }
+
+      if (i != 0) {
+        if (owner_in(g, layout, field - 1 - g->width) == player) {
+          more_north = 0;
+        }
+      }
+
+      if (i != (g->width - 1)) {
+        if (owner_in(g, layout, field + 1 - g->width) == player) {
+          more_north = 0;
+        }
+      }
+    }
+  }
+  // sprawdzanie czy pole na zachód od [i][j] jest niesąsiadem playera
+  if (i == 0) {
+    more_west = 0;
+  }
+  else {
+    if (owner_in(g, layout, field - 1) != 0) {
+      more_west = 0;
+    }
+    else {
+      if (i != 1) {
+        if (owner_in(g, layout, field - 2) == player) {
+          more_west = 0;
+        }
+      }
+
+      if (j != 0) {
+        if (owner_in(g, layout, field - 1 - g->width) == player) {
+          more_west = 0;
+        }
+      }
+
+      if (j != (g->height - 1)) {
+        if (owner_in(g, layout, field - 1 + g->width) == player) {
+          more_west = 0;
+        }
+      }
+    }
+  }
+  // sprawdzanie czy pole na południe od [i][j] jest niesąsiadem playera
+  if (j == (g->height - 1)) {
+    more_south = 0;
+  }
+  else {
+    if (owner_in(g, layout, field + g->width) != 0) {
+      more_south = 0;
+    }
+    else {
+      if (j != (g->height - 2)) {
+        if (owner_in(g, layout, field + 2 * g->width) == player) {
+          more_south = 0;
+        }
+      }
+
+      if (i != 0) {
+        if (owner_in(g, layout, field - 1 + g->width) == player) {
+          more_south = 0;
+        }
+      }
+
+      if (i != (g->width - 1)) {
+        if (owner_in(g, layout, field + 1 + g->width) == player) {
+          more_south = 0;
+        }
+      }
+    }
+  }
+  // sprawdzanie czy pole na wschód od [i][j] jest niesąsiadem playera
+  if (i == (g->width - 1)) {
+    more_east = 0;
+  }
+  else {
+    if (owner_in(g, layout, field + 1) != 0) {
+      more_east = 0;
+    }
+    else {
+      if (i != (g->width - 2)) {
+        if (owner_in(g, layout, field + 2) == player) {
+          more_east = 0;
+        }
+      }
+
+      if (j != 0) {
+        if (owner_in(g, layout, field + 1 - g->width) == player) {
+          more_east = 0;
+        }
+      }
+
+      if (j != (g->height - 1)) {
+        if (owner_in(g, layout, field + 1 + g->width) == player) {
+          more_east = 0;
+        }
+      }
+    }
+  }
+  result = result + more_north + more_west + more_south + more_east;
+  return result;
+}
+
+/** @brief zmiana wolnych pól po dodaniu pionka player na pole [i][j]
+ * @param[in] g – wskaźnik na strukturę przechowującą stan gry.
+ * @param[in] i - pierwsza współrzędna polożenia pionka.
+ * @param[in] j - druga współrzędna polożenia pionka.
+ * @param[in] player – numer gracza którego pionek stawiamy.
+ * @param[in] is_golden – czy wykonujemy to dodanie złotym ruchem.
+ * @return Ile trzeba dodać playerowi wolnych pól po postawieniu pionka.
+ */
+static int delta_free_fields_around(gamma_t *g,
+  uint32_t i, uint32_t j, uint32_t player, bool is_golden) {
+
+  return delta_in(g, g->layout, i, j, player, is_golden);
+}
+
+/** @brief Sprawdza, czy ruch ma poprawne parametry.
+ * Nie sprawdza, czy ruch jest legalny.
+ * @param[in] g       – wskaźnik na strukturę przechowującą stan gry,
+ * @param[in] player  – numer gracza,
+ * @param[in] x       – numer kolumny,
+ * @param[in] y       – numer wiersza.
+ * @return Wartość @p true, jeśli gracz i pole istnieją w grze @p g.
+ */
+static inline bool valid_move(const gamma_t *g, uint32_t player, uint32_t x,
+  uint32_t y) {
+
+  return (player != 0 && player <= g->players) &&
+    (x < g->width && y < g->height);
+}
+
+/** @brief Wykonuje ruch o poprawnych parametrach.
+ * Wątek musi trzymać blokadę do pisania, a parametry muszą spełniać
+ * @ref valid_move.
+ * @param[in,out] g   – wskaźnik na strukturę przechowującą stan gry,
+ * @param[in] layout  – sposób przechowywania planszy @p g,
+ * @param[in] player  – numer gracza,
+ * @param[in] x       – numer kolumny,
+ * @param[in] y       – numer wiersza.
+ * @return Wartość @p true, jeśli ruch został wykonany, a @p false,
+ * gdy ruch jest nielegalny.
+ */
+SPECIALIZED bool place_in(gamma_t *g, layout_t layout, uint32_t player,
+  uint32_t x, uint32_t y) {
+
+  uint64_t field = x + (uint64_t)y * g->width;
+
+  if (owner_in(g, layout, field) != 0) {
+    return false;
+  }
+  else {
+    if (g->areas_taken[player - 1] == g->areas) {
+      bool over_areas = 1;
+      
+      if (x != 0) {
+        if (owner_in(g, layout, field - 1) == player) {
+          over_areas = 0;
+        }
+      }
+
+      if (y != 0) {
+        if (owner_in(g, layout, field - g->width) == player) {
+          over_areas = 0;
+        }
+      }
+
+      if (x != (g->width - 1)) {
+        if (owner_in(g, layout, field + 1) == player) {
+          over_areas = 0;
+        }
+      }
+
+      if (y != (g->height - 1)) {
+        if (owner_in(g, layout, field + g->width) == player) {
+          over_areas = 0;
+        }
+      }
+
+      if (over_areas == 1) {
+        return false;
+      }
+    }      
+
+    if (!sparse_reserve(g)) {
+      return false;
+    }
+
+    g->fields_taken[player - 1]++;
+    g->split_dirty[player - 1] = true;
+    set_owner_in(g, layout, field, player);
+    g->areas_taken[player - 1]++;
+    g->free_fields--;
+    g->free_fields_around[player - 1] = g->free_fields_around[player - 1] +
+      delta_in(g, layout, x, y, player, 0);
+
+    uint32_t north_neighbor = 0;
+    uint32_t west_neighbor = 0;
+    uint32_t south_neighbor = 0;
+    uint32_t east_neighbor = 0;
+
+    if (y != 0) {
+      uint32_t owner = owner_in(g, layout, field - g->width);
+
+      if (owner != 0 && owner != player) {
+        north_neighbor = owner;
+      }
+    }
+
+    if (x != 0) {
+      uint32_t owner = owner_in(g, layout, field - 1);
+
+      if (owner != 0 && owner != player) {
+        west_neighbor = owner;
+      }
+    }
+
+    if (y != (g->height - 1)) {
+      uint32_t owner = owner_in(g, layout, field + g->width);
+
+      if (owner != 0 && owner != player) {
+        south_neighbor = owner;
+      }
+    }
+
+    if (x != (g->width - 1)) {
+      uint32_t owner = owner_in(g, layout, field + 1);
+
+      if (owner != 0 && owner != player) {
+        east_neighbor = owner;
+      }
+    }
+
+    // eliminating case of more than more same neighbor
+    if (north_neighbor == west_neighbor) {
+      west_neighbor = 0;
+    }
+    if (north_neighbor == south_neighbor) {
+      south_neighbor = 0;
+    }
+    if (north_neighbor == east_neighbor) {
+      east_neighbor = 0;
+    }
+    if (west_neighbor == south_neighbor) {
+      south_neighbor = 0;
+    }
+    if (west_neighbor == east_neighbor) {
+      east_neighbor = 0;
+    }
+    if (south_neighbor == east_neighbor) {
+      east_neighbor = 0;
+    }
+
+    if (north_neighbor != 0) {
+      g->free_fields_around[north_neighbor - 1]--;
+    }
+    if (west_neighbor != 0) {
+      g->free_fields_around[west_neighbor - 1]--;
+    }
+    if (south_neighbor != 0) {
+      g->free_fields_around[south_neighbor - 1]--;
+    }
+    if (east_neighbor != 0) {
+      g->free_fields_around[east_neighbor - 1]--;
+    }
+
+    union_helper_in(g, layout, player, x, y);
+    touch_field_in(g, layout, player, x, y);
+
+    return true;
+  }
+}
+
+/** @brief Wykonuje ruch, gdy wątek trzyma blokadę do pisania.
+ * @param[in,out] g   – wskaźnik na strukturę przechowującą stan gry,
+ * @param[in] layout  – sposób przechowywania planszy @p g,
+ * @param[in] player  – numer gracza,
+ * @param[in] x       – numer kolumny,
+ * @param[in] y       – numer wiersza.
+ * @return Wartość @p true, jeśli ruch został wykonany, a @p false,
+ * gdy ruch jest nielegalny lub któryś z parametrów jest niepoprawny.
+ */
+SPECIALIZED bool move_in(gamma_t *g, layout_t layout, uint32_t player,
+  uint32_t x, uint32_t y) {
+
+  if (g == NULL || !valid_move(g, player, x, y)) {
+    return false;
+  }
+  return place_in(g, layout, player, x, y);
+}
+
+/** @brief Wykonuje ruch, gdy wątek trzyma blokadę do pisania.
+ * Wybiera kopię @ref move_in dla sposobu przechowywania planszy.
+ * @param[in,out] g   – wskaźnik na strukturę przechowującą stan gry,
+ * @param[in] player  – numer gracza,
+ * @param[in] x       – numer kolumny,
+ * @param[in] y       – numer wiersza.
+ * @return Wartość @p true, jeśli ruch został wykonany, a @p false,
+ * gdy ruch jest nielegalny lub któryś z parametrów jest niepoprawny.
+ */
+static bool move_locked(gamma_t *g, uint32_t player, uint32_t x, uint32_t y) {
+  switch (g->layout) {
+    case LAYOUT_SPARSE:
+      return move_in(g, LAYOUT_SPARSE, player, x, y);
+    case LAYOUT_8_32:
+      return move_in(g, LAYOUT_8_32, player, x, y);
+    case LAYOUT_16_32:
+      return move_in(g, LAYOUT_16_32, player, x, y);
+    case LAYOUT_32_32:
+      return move_in(g, LAYOUT_32_32, player, x, y);
+    case LAYOUT_8_64:
+      return move_in(g, LAYOUT_8_64, player, x, y);
+    case LAYOUT_16_64:
+      return move_in(g, LAYOUT_16_64, player, x, y);
+    default:
+      return move_in(g, LAYOUT_32_64, player, x, y);
+  }
+}
+
+bool gamma_move(gamma_t *g, uint32_t player, uint32_t x, uint32_t y) {
+  if (g == NULL) {
+    return false;
+  }
+  else {
+    STATS_START();
+    TRACE_BEGIN(TRACE_MOVE, player, x, y);
+    pthread_rwlock_wrlock(&g->lock);
+    bool result = move_locked(g, player, x, y);
+    pthread_rwlock_unlock(&g->lock);
+    TRACE_END(TRACE_MOVE, result);
+    STATS_CALL(g, GAMMA_CALL_MOVE);
+
+    return result;
+  }
+}
+
+/** @brief Wykonuje złoty ruch o poprawnych parametrach.
+ * Wątek musi trzymać blokadę do pisania, a parametry muszą spełniać
+ * @ref valid_move.
+ * @param[in,out] g   – wskaźnik na strukturę przechowującą stan gry,
+ * @param[in] player  – numer gracza,
+ * @param[in] x       – numer kolumny,
+ * @param[in] y       – numer wiersza.
+ * @return Wartość @p true, jeśli ruch został wykonany, a @p false,
+ * gdy gracz wykorzystał już swój złoty ruch lub ruch jest nielegalny.
+ */
+static bool golden_place(gamma_t *g, uint32_t player, uint32_t x,
+  uint32_t y) {
+
+  uint64_t field = x + (uint64_t)y * g->width;
+
+  if (field_owner(g, field) == 0) {
+    return false;
+  }
+  else {
+    if ((g->golden[player - 1] == 1) || (field_owner(g, field) == player)) {
+      return false;
+    }
+    else {
+      if (g->areas_taken[player - 1] == g->areas) {
+        bool specific_case = 1;
+
+        if (x != 0) {
+          if (field_owner(g, field - 1) == player) {
+            specific_case = 0;
+          }
+        }
+
+        if (y != 0) {
+          if (field_owner(g, field - g->width) == player) {
+            specific_case = 0;
+          }
+        }
+
+        if (x != (g->width - 1)) {
+          if (field_owner(g, field + 1) == player) {
+            specific_case = 0;
+          }
+        }
+
+        if (y != (g->height - 1)) {
+          if (field_owner(g, field + g->width) == player) {
+            specific_case = 0;
+          }
+        }
+
+        if (specific_case == 1) {
+          return false;
+        }
+      }
+
+      uint32_t robbed_player = field_owner(g, field);
+      // zmieniamy tylko pola obu graczy, każde trafia do dziennika raz
+      if (!journal_begin(g, g->fields_taken[player - 1] +
+        g->fields_taken[robbed_player - 1])) {
+
+        return false;
+      }
+
+      uint64_t copy_areas_taken_player = g->areas_taken[player - 1];
+      uint64_t copy_areas_taken_robbed_player =
+        g->areas_taken[robbed_player - 1];
+      set_field_owner(g, field, player);
+      steal_field(g, player, robbed_player, x, y);
+
+      if ((g->areas_taken[player - 1] > g->areas) ||
+        (g->areas_taken[robbed_player - 1] > g->areas)) {
+
+        journal_rollback(g);
+
+        g->areas_taken[player - 1] = copy_areas_taken_player;
+        g->areas_taken[robbed_player - 1] = copy_areas_taken_robbed_player;
+        set_field_owner(g, field, robbed_player);
+        return false;
+      }
+      else {
+        journal_commit(g);
+        g->golden[player - 1] = 1;
+        g->split_dirty[player - 1] = true;
+        g->split_dirty[robbed_player - 1] = true;
+        g->player_generation[robbed_player - 1]++;
+        touch_field(g, player, x, y);
+        g->fields_taken[player - 1]++;
+        g->fields_taken[robbed_player - 1]--;
+        g->free_fields_around[robbed_player - 1] =
+          g->free_fields_around[robbed_player - 1] -
+          delta_free_fields_around(g, x, y, robbed_player, 1);
+        g->free_fields_around[player - 1] =
+          g->free_fields_around[player - 1] +
+          delta_free_fields_around(g, x, y, player, 1);
+        return true;
+      }
+    }
+  }
+}
+
+/** @brief Wykonuje złoty ruch, gdy wątek trzyma blokadę do pisania.
+ * @param[in,out] g   – wskaźnik na strukturę przechowującą stan gry,
+ * @param[in] player  – numer gracza,
+ * @param[in] x       – numer kolumny,
+ * @param[in] y       – numer wiersza.
+ * @return Wartość @p true, jeśli ruch został wykonany, a @p false,
+ * gdy gracz wykorzystał już swój złoty ruch, ruch jest nielegalny
+ * lub któryś z parametrów jest niepoprawny.
+ */
+static bool golden_move_locked(gamma_t *g, uint32_t player, uint32_t x,
+  uint32_t y) {
+
+  if (g == NULL || !valid_move(g, player, x, y)) {
+    return false;
+  }
+  return golden_place(g, player, x, y);
+}
+
+bool gamma_golden_move(gamma_t *g, uint32_t player, uint32_t x, uint32_t y) {
+  if (g == NULL) {
+    return false;
+  }
+  else {
+    STATS_START();
+    TRACE_BEGIN(TRACE_GOLDEN_MOVE, player, x, y);
+    pthread_rwlock_wrlock(&g->lock);
+    bool result = golden_move_locked(g, player, x, y);
+    pthread_rwlock_unlock(&g->lock);
+    TRACE_END(TRACE_GOLDEN_MOVE, result);
+    STATS_CALL(g, GAMMA_CALL_GOLDEN_MOVE);
+
+    return result;
+  }
+}
+
+/** @brief Wykonuje paczkę ruchów, gdy wątek trzyma blokadę do pisania.
+ * Wywoływana ze stałym @p layout, więc sposób przechowywania planszy
+ * wybieramy raz na paczkę, a nie przy każdym ruchu.
+ * @param[in,out] g     – wskaźnik na strukturę przechowującą stan gry,
+ * @param[in] layout    – sposób przechowywania planszy @p g,
+ * @param[in] moves     – tablica ruchów,
+ * @param[in] count     – liczba ruchów w tablicy @p moves,
+ * @param[out] results  – mapa bitowa wyników lub NULL.
+ * @return Liczba wykonanych ruchów.
+ */
+SPECIALIZED uint64_t apply_moves_in(gamma_t *g, layout_t layout,
+  const gamma_move_record_t *moves, uint64_t count, uint8_t *results) {
+
+  uint64_t done = 0;
+  uint8_t bits = 0;
+
+  for (uint64_t i = 0; i < count; i++) {
+    const gamma_move_record_t *move = &moves[i];
+    bool result = false;
+
+    if (valid_move(g, move->player, move->x, move->y)) {
+      if (move->kind == GAMMA_MOVE_NORMAL) {
+        result = place_in(g, layout, move->player, move->x, move->y);
+      }
+      else if (move->kind == GAMMA_MOVE_GOLDEN) {
+        result = golden_place(g, move->player, move->x, move->y);
+      }
+    }
+
+    done += result;
+    bits |= (uint8_t)(result << (i % 8));
+    if ((i % 8 == 7) || (i + 1 == count)) {
+      if (results != NULL) {
+        results[i / 8] = bits;
+      }
+      bits = 0;
+    }
+  }
+  return done;
+}
+
+uint64_t gamma_apply_moves(gamma_t *g, const gamma_move_record_t *moves,
+                           uint64_t count, uint8_t *results) {
+  if ((g == NULL) || (moves == NULL)) {
+    return 0;
+  }
+  else {
+    uint64_t done;
+
+    STATS_START();
+    TRACE_BEGIN(TRACE_APPLY_MOVES, count, 0, 0);
+    pthread_rwlock_wrlock(&g->lock);
+    switch (g->layout) {
+      case LAYOUT_SPARSE:
+        done = apply_moves_in(g, LAYOUT_SPARSE, moves, count, results);
+        break;
+      case LAYOUT_8_32:
+        done = apply_moves_in(g, LAYOUT_8_32, moves, count, results);
+        break;
+      case LAYOUT_16_32:
+        done = apply_moves_in(g, LAYOUT_16_32, moves, count, results);
+        break;
+      case LAYOUT_32_32:
+        done = apply_moves_in(g, LAYOUT_32_32, moves, count, results);
+        break;
+      case LAYOUT_8_64:
+        done = apply_moves_in(g, LAYOUT_8_64, moves, count, results);
+        break;
+      case LAYOUT_16_64:
+        done = apply_moves_in(g, LAYOUT_16_64, moves, count, results);
+        break;
+      default:
+        done = apply_moves_in(g, LAYOUT_32_64, moves, count, results);
+        break;
+    }
+    pthread_rwlock_unlock(&g->lock);
+    TRACE_END(TRACE_APPLY_MOVES, done);
+    STATS_CALL(g, GAMMA_CALL_APPLY_MOVES);
+
+    return done;
+  }
+}
+
+/** @brief Zwraca liczbę pól zajętych przez gracza.
+ * Nie zakłada blokady gry.
+ * @param[in] g       – wskaźnik na strukturę przechowującą stan gry,
+ * @param[in] player  – numer gracza.
+ * @return Liczba pól zajętych przez gracza lub zero,
+ * jeśli któryś z parametrów jest niepoprawny.
+ */
+static uint64_t read_busy_fields(const gamma_t *g, uint32_t player) {
+  if (g != NULL) {
+    if (player > 0 && player <= g->players) {  
+      return g->fields_taken[player - 1];
+    }
+    else {
+      return 0;
+    }
+  }
+  else {
+    return 0;
+  }
+}
+
+/** @brief Zwraca liczbę pól, jakie jeszcze gracz może zająć.
+ * Nie zakłada blokady gry.
+ * @param[in] g       – wskaźnik na strukturę przechowującą stan gry,
+ * @param[in] player  – numer gracza.
+ * @return Liczba pól, jakie jeszcze może zająć gracz, lub zero,
+ * jeśli któryś z parametrów jest niepoprawny.
+ */
+static uint64_t read_free_fields(const gamma_t *g, uint32_t player) {
+  if (g != NULL) {
+    if (player > 0 && player <= g->players)
+      if (g->areas_taken[player - 1] < g->areas) {
+        return g->free_fields;
+      }
+      else {
+        return g->free_fields_around[player - 1];
+      }
+    else {
+      return 0;
+    }
+  }
+  else {
+    return 0;
+  }
+}
+
+uint64_t gamma_busy_fields(gamma_t *g, uint32_t player) {
+  if (g == NULL) {
+    return 0;
+  }
+  else {
+    // bez blokady, to tylko odczyt licznika; zob. opis w gamma.h
+    STATS_START();
+    uint64_t result = read_busy_fields(g, player);
+    STATS_CALL(g, GAMMA_CALL_BUSY_FIELDS);
+
+    return result;
+  }
+}
+
+uint64_t gamma_free_fields(gamma_t *g, uint32_t player) {
+  if (g == NULL) {
+    return 0;
+  }
+  else {
+    // bez blokady, to tylko odczyt liczników; zob. opis w gamma.h
+    STATS_START();
+    uint64_t result = read_free_fields(g, player);
+    STATS_CALL(g, GAMMA_CALL_FREE_FIELDS);
+
+    return result;
+  }
+}
+
+/** @brief Sprawdza, czy zapamiętana odpowiedź gracza jest aktualna.
+ * Odpowiedź true jest aktualna, dopóki nie zmieni się gracz ani ten,
+ * któremu można zabrać pole. Odpowiedź false z braku cudzych pionków obok
+ * pól gracza z kompletem obszarów jest aktualna, dopóki nie zmieni się
+ * gracz. Pozostałe odpowiedzi są aktualne do następnego ruchu.
+ * Wątek musi trzymać blokadę gry i cache_lock.
+ * @param[in] g       – wskaźnik na strukturę przechowującą stan gry,
+ * @param[in] player  – numer gracza.
+ * @return Wartość @p true, jeśli odpowiedź jest aktualna.
+ */
+static bool golden_cache_valid(const gamma_t *g, uint32_t player) {
+  const golden_cache_t *cache = &g->golden_cache[player - 1];
+
+  if (!cache->valid) {
+    return false;
+  }
+  if (cache->board_generation == g->board_generation) {
+    return true;
+  }
+  if (cache->player_generation != g->player_generation[player - 1]) {
+    return false;
+  }
+  if (cache->possible) {
+    return cache->robbed_generation ==
+      g->player_generation[cache->robbed_player - 1];
+  }
+  return cache->no_candidates;
+}
+
+/** @brief Liczy sąsiadów pola należących do jego właściciela.
+ * Tylu co najwyżej kawałków może powstać po zabraniu pola.
+ * @param[in] g       – wskaźnik na strukturę przechowującą stan gry,
+ * @param[in] owner   – właściciel pola,
+ * @param[in] field   – zajęte pole planszy.
+ * @return Liczba sąsiadów pola należących do @p owner.
+ */
+static uint8_t owner_degree(const gamma_t *g, uint32_t owner, uint64_t field) {
+  uint8_t degree = 0;
+
+  for (uint8_t direction = 0; direction < 4; direction++) {
+    uint64_t neighbor;
+
+    if (neighbor_field(g, field, direction, &neighbor) &&
+      field_owner(g, neighbor) == owner) {
+
+      degree++;
+    }
+  }
+  return degree;
+}
+
+/** @brief Rezerwuje pamięć roboczą na przeszukiwanie planszy.
+ * Wątek musi trzymać blokadę.
+ * @param[in] g           – wskaźnik na strukturę przechowującą stan gry,
+ * @param[in,out] scratch – pamięć robocza wątku.
+ * @return Wartość @p true, jeśli udało się zaalokować pamięć, a @p false
+ * w przeciwnym przypadku.
+ */
+static bool scratch_begin(const gamma_t *g, gamma_scratch_t *scratch) {
+  uint64_t positions = cursor_end(g);
+
+  if (scratch->mark_capacity < positions) {
+    uint32_t *mark = NULL;
+
+    if (positions <= SIZE_MAX / sizeof(uint32_t)) {
+      mark = calloc(positions, sizeof(uint32_t));
+    }
+    if (mark == NULL) {
+      return false;
+    }
+    free(scratch->mark);
+    scratch->mark = mark;
+    scratch->mark_capacity = positions;
+    scratch->stamp = 0;
+  }
+
+  scratch->stamp++;
+  if (scratch->stamp == 0) {
+    memset(scratch->mark, 0, scratch->mark_capacity * sizeof(uint32_t));
+    scratch->stamp = 1;
+  }
+  return true;
+}
+
+/** @brief Zaznacza pole w pamięci roboczej.
+ * @param[in] g           – wskaźnik na strukturę przechowującą stan gry,
+ * @param[in,out] scratch – pamięć robocza wątku,
+ * @param[in] field       – zajęte pole planszy.
+ * @return Wartość @p true, jeśli pole było już zaznaczone w bieżącym
+ * przeszukiwaniu, a @p false w przeciwnym przypadku.
+ */
+static inline bool scratch_mark(const gamma_t *g, gamma_scratch_t *scratch,
+  uint64_t field) {
+
+  uint64_t position = field;
+
+  if (g->sparse) {
+    position = sparse_slot(g, field) - g->cells;
+  }
+  if (scratch->mark[position] == scratch->stamp) {
+    return true;
+  }
+  scratch->mark[position] = scratch->stamp;
+  return false;
+}
+
+/** @brief Sprawdza, czy obszar rozpadnie się na co najwyżej limit kawałków.
+ * Przeszukuje obszar właściciela pola bez tego pola, zaczynając od jego
+ * sąsiadów, i kończy, gdy dotrze do wszystkich. Niczego nie zmienia
+ * w stanie gry. Wątek musi trzymać blokadę.
+ * @param[in] g           – wskaźnik na strukturę przechowującą stan gry,
+ * @param[in,out] scratch – pamięć robocza wątku,
+ * @param[in] owner       – właściciel pola,
+ * @param[in] field       – zabierane pole,
+ * @param[in] limit       – dopuszczalna liczba kawałków.
+ * @return Wartość @p true, jeśli kawałków jest co najwyżej @p limit,
+ * a @p false, gdy jest ich więcej lub zabrakło pamięci.
+ */
+static bool pieces_within(const gamma_t *g, gamma_scratch_t *scratch,
+  uint32_t owner, uint64_t field, uint64_t limit) {
+
+  uint64_t neighbors[4];
+  uint8_t degree = 0;
+  uint8_t reached = 0;
+  uint64_t pieces = 0;
+
+  for (uint8_t direction = 0; direction < 4; direction++) {
+    if (neighbor_field(g, field, direction, &neighbors[degree]) &&
+      field_owner(g, neighbors[degree]) == owner) {
+
+      degree++;
+    }
+  }
+  if (!scratch_begin(g, scratch)) {
+    scratch->failed = true;
+    return false;
+  }
+  scratch_mark(g, scratch, field);
+
+  for (uint8_t i = 0; i < degree && reached < degree; i++) {
+    if (scratch_mark(g, scratch, neighbors[i])) {
+      continue;
+    }
+    pieces++;
+    reached++;
+    if (pieces > limit) {
+      return false;
+    }
+
+    uint64_t top = 0;
+    scratch->stack[top++] = neighbors[i];
+
+    while (top > 0 && reached < degree) {
+      uint64_t current = scratch->stack[--top];
+
+      for (uint8_t direction = 0; direction < 4; direction++) {
+        uint64_t next;
+
+        if (neighbor_field(g, current, direction, &next) &&
+          field_owner(g, next) == owner && !scratch_mark(g, scratch, next)) {
+
+          for (uint8_t j = 0; j < degree; j++) {
+            if (neighbors[j] == next) {
+              reached++;
+            }
+          }
+          if (top == scratch->stack_capacity) {
+            uint64_t capacity = 2 * scratch->stack_capacity;
+            uint64_t *stack = NULL;
+
+            if (capacity <= SIZE_MAX / sizeof(uint64_t)) {
+              stack = realloc(scratch->stack, capacity * sizeof(uint64_t));
+            }
+            if (stack == NULL) {
+              scratch->failed = true;
+              return false;
+            }
+            scratch->stack = stack;
+            scratch->stack_capacity = capacity;
+          }
+          scratch->stack[top++] = next;
+        }
+      }
+    }
+  }
+  return true;
+}
+
+gamma_scratch_t* gamma_scratch_new(void) {
+  gamma_scratch_t *scratch = calloc(1, sizeof(gamma_scratch_t));
+
+  if (scratch != NULL) {
+    scratch->stack_capacity = SPARSE_INITIAL_CAPACITY;
+    scratch->stack = malloc(scratch->stack_capacity * sizeof(uint64_t));
+    if (scratch->stack == NULL) {
+      free(scratch);
+      return NULL;
+    }
+  }
+  return scratch;
+}
+
+void gamma_scratch_delete(gamma_scratch_t *scratch) {
+  if (scratch != NULL) {
+    free(scratch->mark);
+    free(scratch->stack);
+    free(scratch);
+  }
+}
+
+/**
+ * Klucz pamięci roboczej wątku, z której korzysta gamma_golden_possible.
+ */
+static pthread_key_t scratch_key;
+
+/**
+ * Zapewnia jednokrotne utworzenie @ref scratch_key.
+ */
+static pthread_once_t scratch_once = PTHREAD_ONCE_INIT;
+
+/**
+ * Czy udało się utworzyć @ref scratch_key.
+ */
+static bool scratch_key_ready = false;
+
+/** @brief Zwalnia pamięć roboczą kończącego się wątku.
+ * @param[in,out] scratch – pamięć robocza wątku.
+ */
+static void scratch_destroy(void *scratch) {
+  gamma_scratch_delete(scratch);
+}
+
+/** @brief Tworzy klucz pamięci roboczej wątków.
+ */
+static void scratch_key_create(void) {
+  scratch_key_ready = pthread_key_create(&scratch_key, scratch_destroy) == 0;
+}
+
+/** @brief Daje pamięć roboczą bieżącego wątku.
+ * Alokuje ją przy pierwszym użyciu w wątku, a zwalnia, gdy wątek się kończy.
+ * @return Wskaźnik na pamięć roboczą lub NULL, gdy zabrakło pamięci.
+ */
+static gamma_scratch_t* thread_scratch(void) {
+  pthread_once(&scratch_once, scratch_key_create);
+  if (!scratch_key_ready) {
+    return NULL;
+  }
+
+  gamma_scratch_t *scratch = pthread_getspecific(scratch_key);
+  if (scratch == NULL) {
+    scratch = gamma_scratch_new();
+    if (scratch != NULL && pthread_setspecific(scratch_key, scratch) != 0) {
+      gamma_scratch_delete(scratch);
+      scratch = NULL;
+    }
+  }
+  return scratch;
+}
+
+/** @brief Zlicza zapytanie rozstrzygnięte na danym poziomie.
+ * @param[in,out] g   – wskaźnik na strukturę przechowującą stan gry,
+ * @param[in] tier    – poziom, który rozstrzygnął zapytanie.
+ */
+static inline void count_tier(gamma_t *g, uint32_t tier) {
+  atomic_fetch_add_explicit(&g->golden_tier_hits[tier], 1,
+    memory_order_relaxed);
+}
+
+/** @brief Podaje zapamiętaną odpowiedź gracza, jeśli jest aktualna.
+ * Wątek musi trzymać blokadę gry, wystarczy do czytania.
+ * @param[in] g         – wskaźnik na strukturę przechowującą stan gry,
+ * @param[in] player    – numer gracza,
+ * @param[out] possible – zapamiętana odpowiedź.
+ * @return Wartość @p true, jeśli odpowiedź jest aktualna.
+ */
+static bool golden_cache_get(const gamma_t *g, uint32_t player,
+  bool *possible) {
+
+  pthread_mutex_t *cache_lock = (pthread_mutex_t*)&g->cache_lock;
+
+  pthread_mutex_lock(cache_lock);
+  bool valid = golden_cache_valid(g, player);
+  *possible = g->golden_cache[player - 1].possible;
+  pthread_mutex_unlock(cache_lock);
+
+  return valid;
+}
+
+/** @brief Zapamiętuje odpowiedź gracza i zlicza poziom, który ją dał.
+ * Wątek musi trzymać blokadę gry, wystarczy do czytania.
+ * @param[in,out] g        – wskaźnik na strukturę przechowującą stan gry,
+ * @param[in] player       – numer gracza,
+ * @param[in] answer       – odpowiedź false z pokoleniami z chwili liczenia,
+ * @param[in] robbed_player – numer gracza, któremu można zabrać pole,
+ *                           albo 0, gdy takiego pola nie ma,
+ * @param[in] tier         – poziom, który rozstrzygnął zapytanie.
+ * @return Wartość @p true, jeśli gracz może wykonać złoty ruch.
+ */
+static bool golden_store(gamma_t *g, uint32_t player, golden_cache_t answer,
+  uint32_t robbed_player, uint32_t tier) {
+
+  if (robbed_player != 0) {
+    answer.possible = true;
+    answer.no_candidates = false;
+    answer.robbed_player = robbed_player;
+    answer.robbed_generation = g->player_generation[robbed_player - 1];
+  }
+  count_tier(g, tier);
+
+  pthread_mutex_lock(&g->cache_lock);
+  g->golden_cache[player - 1] = answer;
+  pthread_mutex_unlock(&g->cache_lock);
+
+  return answer.possible;
+}
+
+/** @brief Podaje, gdzie szukać kandydatów do złotego ruchu gracza.
+ * Wątek musi trzymać blokadę gry, wystarczy do czytania.
+ * @param[in] g       – wskaźnik na strukturę przechowującą stan gry,
+ * @param[in] player  – numer gracza,
+ * @param[out] list   – lista kandydatów gracza albo NULL, gdy ją porzucono
+ *                      i trzeba przejrzeć całą planszę.
+ * @return Pozycja tuż za ostatnią do przejrzenia.
+ */
+static uint64_t candidate_source(const gamma_t *g, uint32_t player,
+  const uint64_t **list) {
+
+  const candidate_list_t *candidates = &g->candidates[player - 1];
+
+  if (candidates->lost) {
+    *list = NULL;
+    return cursor_end(g);
+  }
+  *list = candidates->fields;
+  return candidates->length;
+}
+
+/** @brief Daje kolejne pole do sprawdzenia z listy kandydatów lub planszy.
+ * @param[in] g          – wskaźnik na strukturę przechowującą stan gry,
+ * @param[in] list       – lista kandydatów albo NULL dla całej planszy,
+ * @param[in,out] cursor – pozycja, od której zaczynamy; potem tuż za polem,
+ * @param[in] end        – pozycja, na której kończymy,
+ * @param[out] field     – numer pola liczony: x + y * width.
+ * @return Wartość @p true, jeśli jest kolejne pole, a @p false w przeciwnym
+ * przypadku.
+ */
+static inline bool next_candidate(const gamma_t *g, const uint64_t *list,
+  uint64_t *cursor, uint64_t end, uint64_t *field) {
+
+  if (list == NULL) {
+    return next_taken_field_before(g, cursor, end, field);
+  }
+  if (*cursor >= end) {
+    return false;
+  }
+  *field = list[(*cursor)++];
+  return true;
+}
+
+/** @brief Przegląda fragment kandydatów w poszukiwaniu złotego ruchu.
+ * Czyta stan gry, niczego w nim nie zmienia, więc wiele wątków może
+ * przeglądać rozłączne fragmenty jednocześnie.
+ * @param[in,out] arg – wskaźnik na strukturę golden_scan_t.
+ * @return Wartość NULL.
+ */
+static void* golden_scan_run(void *arg) {
+  golden_scan_t *scan = arg;
+  const gamma_t *g = scan->g;
+  uint64_t cursor = scan->begin;
+  uint64_t field;
+
+  while (next_candidate(g, scan->list, &cursor, scan->end, &field)) {
+    if (atomic_load_explicit(scan->stop, memory_order_relaxed)) {
+      break;
+    }
+    STATS_ONLY(scan->cells++);
+
+    uint32_t robbed_player = golden_candidate(g, scan->player, field);
+
+    if (robbed_player != 0) {
+      uint64_t pieces;
+
+      scan->candidates = true;
+      if (scan->tier == 2) {
+        // zabranie pola rozspójnia co najwyżej tyle kawałków, ilu sąsiadów
+        // ma pole
+        pieces = owner_degree(g, robbed_player, field);
+      }
+      else {
+        // obszar okradanego gracza rozpada się na split(field) kawałków
+        pieces = get_split(g, field);
+      }
+
+      if (g->areas_taken[robbed_player - 1] - 1 + pieces <= g->areas) {
+        scan->robbed_player = robbed_player;
+        atomic_store_explicit(scan->stop, true, memory_order_relaxed);
+        break;
+      }
+      scan->ambiguous = true;
+    }
+  }
+  return NULL;
+}
+
+/** @brief Przegląda kandydatów gracza w poszukiwaniu złotego ruchu.
+ * Odwiedza pola z listy kandydatów gracza, a całą planszę tylko wtedy,
+ * gdy listę porzucono z braku pamięci. Długie listy dzieli na fragmenty
+ * przeglądane przez osobne wątki, które kończą pracę, gdy którykolwiek
+ * z nich znajdzie pole. Fragmenty rozdziela między wątki pomocnicze puli
+ * gry; gdy pulę zajmuje inny wątek, przegląda wszystko sam.
+ * @param[in] g       – wskaźnik na strukturę przechowującą stan gry,
+ * @param[in] player  – numer gracza,
+ * @param[in] tier    – poziom sprawdzania: 2 lub 3,
+ * @param[out] result – wynik przeglądania wszystkich kandydatów.
+ */
+static void golden_scan_all(const gamma_t *g, uint32_t player, uint8_t tier,
+  golden_scan_t *result) {
+
+  atomic_bool stop = false;
+  const uint64_t *list;
+  uint64_t end = candidate_source(g, player, &list);
+  uint32_t threads = g->threads;
+  golden_scan_t *scans = NULL;
+  uint32_t helpers = 0;
+
+  *result = (golden_scan_t){ .g = g, .player = player, .tier = tier,
+    .list = list, .begin = 0, .end = end, .stop = &stop };
+  TRACE_BEGIN(TRACE_GOLDEN_SCAN, player, tier, 0);
+
+  if (end / GAMMA_PARALLEL_FIELDS < threads) {
+    threads = end / GAMMA_PARALLEL_FIELDS;
+  }
+  if (threads > 1) {
+    scans = calloc(threads, sizeof(golden_scan_t));
+  }
+  if (scans != NULL) {
+    // pula należy do gry, a przeglądanie niczego w grze nie zmienia
+    helpers = pool_acquire((scan_pool_t*)&g->pool, g->threads - 1,
+      threads - 1);
+  }
+  if (helpers == 0) {
+    // za mało kandydatów, brak pamięci albo pulę zajmuje inny wątek,
+    // przeglądamy w jednym wątku
+    free(scans);
+    golden_scan_run(result);
+    STATS_ADD(g, golden_scans, 1);
+    STATS_ADD(g, golden_scan_cells, result->cells);
+    TRACE_END(TRACE_GOLDEN_SCAN, result->robbed_player);
+    return;
+  }
+
+  threads = helpers + 1;
+  for (uint32_t i = 0; i < threads; i++) {
+    scans[i] = *result;
+    scans[i].begin = end / threads * i;
+    if (i + 1 < threads) {
+      scans[i].end = end / threads * (i + 1);
+    }
+  }
+  pool_run((scan_pool_t*)&g->pool, scans, helpers);
+
+  for (uint32_t i = 0; i < threads; i++) {
+    if (result->robbed_player == 0) {
+      result->robbed_player = scans[i].robbed_player;
+    }
+    result->candidates |= scans[i].candidates;
+    result->ambiguous |= scans[i].ambiguous;
+    STATS_ONLY(result->cells += scans[i].cells);
+  }
+  free(scans);
+  STATS_ADD(g, golden_scans, 1);
+  STATS_ADD(g, golden_scan_cells, result->cells);
+  TRACE_END(TRACE_GOLDEN_SCAN, result->robbed_player);
+}
 
-        if (over_areas == 1) {
-          return false;
-        }
-      }      
+/** @brief Przegląda kandydatów gracza, licząc kawałki w pamięci roboczej.
+ * Kawałki obszaru okradanego gracza liczy dokładnie dla każdego kandydata,
+ * którego nie rozstrzyga liczba jego sąsiadów. Niczego nie zmienia w stanie
+ * gry. Wątek musi trzymać blokadę gry, wystarczy do czytania.
+ * @param[in] g           – wskaźnik na strukturę przechowującą stan gry,
+ * @param[in] player      – numer gracza,
+ * @param[in,out] scratch – pamięć robocza wątku.
+ * @return Numer gracza, któremu można zabrać pole, albo 0, gdy takiego pola
+ * nie ma lub zabrakło pamięci; wtedy ustawione jest @p scratch->failed.
+ */
+static uint32_t golden_scan_exact(const gamma_t *g, uint32_t player,
+  gamma_scratch_t *scratch) {
 
-      g->fields_taken[player - 1]++;
-      g->board[x][y] = player;
-      g->areas_taken[player - 1]++;
-      g->free_fields--;
-      g->free_fields_around[player - 1] = g->free_fields_around[player - 1] +
-        delta_free_fields_around(g, x, y, player, 0);
+  const uint64_t *list;
+  uint64_t end = candidate_source(g, player, &list);
+  uint64_t cursor = 0;
+  uint64_t field;
 
-      uint32_t north_neighbor = 0;
-      uint32_t west_neighbor = 0;
-      uint32_t south_neighbor = 0;
-      uint32_t east_neighbor = 0;
+  scratch->failed = false;
+  STATS_ADD(g, golden_scans, 1);
+  while (next_candidate(g, list, &cursor, end, &field)) {
+    uint32_t robbed_player = golden_candidate(g, player, field);
 
-      if (y != 0) {
-        if (g->board[x][y - 1] != 0 && g->board[x][y - 1] != player) {
-          north_neighbor = g->board[x][y - 1];
-        }
-      }
+    STATS_ADD(g, golden_scan_cells, 1);
+    if (robbed_player != 0) {
+      // okradany gracz może mieć co najwyżej tyle kawałków
+      uint64_t limit = g->areas - g->areas_taken[robbed_player - 1] + 1;
 
-      if (x != 0) {
-        if (g->board[x - 1][y] != 0 && g->board[x - 1][y] != player) {
-          west_neighbor = g->board[x - 1][y];
-        }
-      }
+      if (owner_degree(g, robbed_player, field) <= limit ||
+        pieces_within(g, scratch, robbed_player, field, limit)) {
 
-      if (y != (g->height - 1)) {
-        if (g->board[x][y + 1] != 0 && g->board[x][y + 1] != player) {
-          south_neighbor = g->board[x][y + 1];
-        }
+        return robbed_player;
       }
+    }
+  }
+  return 0;
+}
 
-      if (x != (g->width - 1)) {
-        if (g->board[x + 1][y] != 0 && g->board[x + 1][y] != player) {
-          east_neighbor = g->board[x + 1][y];
-        }
-      }
+/** @brief Sprawdza złoty ruch gracza poziomami od 0 do 2.
+ * Odpowiedź poziomu 2 zapamiętuje. Wątek musi trzymać blokadę gry,
+ * wystarczy do czytania.
+ * @param[in,out] g       – wskaźnik na strukturę przechowującą stan gry,
+ * @param[in] player      – numer gracza,
+ * @param[out] answer     – odpowiedź false z pokoleniami z chwili liczenia,
+ *                          do zapamiętania przez poziom 3.
+ * @return 1, jeśli gracz może wykonać złoty ruch, 0, jeśli nie może, a -1,
+ * gdy rozstrzygnąć to może dopiero poziom 3.
+ */
+static int golden_possible_quick(gamma_t *g, uint32_t player,
+  golden_cache_t *answer) {
 
-      // eliminating case of more than more same neighbor
-      if (north_neighbor == west_neighbor) {
-        west_neighbor = 0;
-      }
-      if (north_neighbor == south_neighbor) {
-        south_neighbor = 0;
-      }
-      if (north_neighbor == east_neighbor) {
-        east_neighbor = 0;
-      }
-      if (west_neighbor == south_neighbor) {
-        south_neighbor = 0;
-      }
-      if (west_neighbor == east_neighbor) {
-        east_neighbor = 0;
-      }
-      if (south_neighbor == east_neighbor) {
-        east_neighbor = 0;
-      }
+  uint64_t fields = (uint64_t)g->width * g->height;
+  uint64_t foreign = fields - g->free_fields - g->fields_taken[player - 1];
 
-      if (north_neighbor != 0) {
-        g->free_fields_around[north_neighbor - 1]--;
-      }
-      if (west_neighbor != 0) {
-        g->free_fields_around[west_neighbor - 1]--;
-      }
-      if (south_neighbor != 0) {
-        g->free_fields_around[south_neighbor - 1]--;
-      }
-      if (east_neighbor != 0) {
-        g->free_fields_around[east_neighbor - 1]--;
-      }
+  // poziom 0: same liczniki
+  if (g->golden[player - 1] == 1 || foreign == 0) {
+    count_tier(g, 0);
+    return 0;
+  }
+  // Każdy obszar ma pole, którego zabranie go nie rozspójnia (liść drzewa
+  // rozpinającego), a gracz bez kompletu obszarów może zająć dowolne pole.
+  if (g->areas_taken[player - 1] < g->areas) {
+    count_tier(g, 0);
+    return 1;
+  }
 
-      Union_helper(g, player, x, y);
+  // poziom 1: zapamiętana odpowiedź
+  bool possible;
+  if (golden_cache_get(g, player, &possible)) {
+    count_tier(g, 1);
+    return possible;
+  }
 
-      return true;
-    }
+  *answer = (golden_cache_t){ .valid = true, .possible = false,
+    .no_candidates = true, .board_generation = g->board_generation,
+    .player_generation = g->player_generation[player - 1] };
+  golden_scan_t scan;
+
+  // poziom 2: przegląd listy kandydatów gracza, czyli cudzych pól obok
+  // jego pól; liczbę kawałków szacujemy liczbą sąsiadów pola
+  golden_scan_all(g, player, 2, &scan);
+  answer->no_candidates = !scan.candidates;
+  if (scan.robbed_player != 0 || !scan.ambiguous) {
+    return golden_store(g, player, *answer, scan.robbed_player, 2);
   }
+  return -1;
 }
 
-bool gamma_golden_move(gamma_t *g, uint32_t player, uint32_t x, uint32_t y) {
-  if ((g == NULL || player == 0) || ((x >= g->width) || (y >= g->height))) {
+/** @brief Sprawdza złoty ruch gracza poziomem 3 i zapamiętuje odpowiedź.
+ * Wątek musi trzymać blokadę gry, wystarczy do czytania. Gdy trzyma też
+ * split_lock i indeks punktów artykulacji jest aktualny dla pól innych
+ * graczy, liczy kawałki z indeksu, a w przeciwnym przypadku we własnej
+ * pamięci roboczej.
+ * @param[in,out] g   – wskaźnik na strukturę przechowującą stan gry,
+ * @param[in] player  – numer gracza,
+ * @param[in] answer  – odpowiedź false z golden_possible_quick,
+ * @param[in] indexed – czy indeks punktów artykulacji jest aktualny.
+ * @return Wartość @p true, jeśli gracz może wykonać złoty ruch,
+ * a @p false w przeciwnym przypadku.
+ */
+static bool golden_possible_exact(gamma_t *g, uint32_t player,
+  golden_cache_t answer, bool indexed) {
+
+  if (indexed) {
+    golden_scan_t scan;
+
+    golden_scan_all(g, player, 3, &scan);
+    return golden_store(g, player, answer, scan.robbed_player, 3);
+  }
+
+  gamma_scratch_t *scratch = thread_scratch();
+  if (scratch == NULL) {
     return false;
   }
-  else {
-    if ((g->board[x][y] == 0) || (player > g->players)) {
-      return false;
-    }
-    else {
-      if ((g->golden[player - 1] == 1) || (g->board[x][y] == player)) {
-        return false;
-      }
-      else {
-        if (g->areas_taken[player - 1] == g->areas) {
-          bool specific_case = 1;
+  uint32_t robbed_player = golden_scan_exact(g, player, scratch);
+  if (robbed_player == 0 && scratch->failed) {
+    // zabrakło pamięci, odpowiedzi nie zapamiętujemy
+    return false;
+  }
+  return golden_store(g, player, answer, robbed_player, 3);
+}
 
-          if (x != 0) {
-            if (g->board[x - 1][y] == player) {
-              specific_case = 0;
-            }
-          }
+/** @brief Uaktualnia indeks punktów artykulacji, jeśli nikt inny tego
+ * nie robi. Po powodzeniu wątek trzyma split_lock.
+ * @param[in,out] g   – wskaźnik na strukturę przechowującą stan gry,
+ * @param[in] player  – numer gracza, którego pól nie uaktualniamy,
+ *                      albo 0, gdy uaktualniamy pola wszystkich graczy.
+ * @return Wartość @p true, jeśli indeks jest aktualny, a @p false, gdy
+ * przebudowuje go inny wątek lub zabrakło pamięci.
+ */
+static bool split_index_acquire(gamma_t *g, uint32_t player) {
+  if (pthread_mutex_trylock(&g->split_lock) != 0) {
+    return false;
+  }
+  TRACE_BEGIN(TRACE_SPLIT_REBUILD, player, 0, 0);
+  bool refreshed = refresh_splits(g, player);
+  TRACE_END(TRACE_SPLIT_REBUILD, refreshed);
+  if (!refreshed) {
+    pthread_mutex_unlock(&g->split_lock);
+  }
+  return refreshed;
+}
 
-          if (y != 0) {
-            if (g->board[x][y - 1] == player) {
-              specific_case = 0;
-            }
-          }
+/** @brief Sprawdza, czy gracz może wykonać złoty ruch, i zapamiętuje
+ * odpowiedź. Wątek musi trzymać blokadę gry, wystarczy do czytania:
+ * pamięć podręczną chroni cache_lock, a indeks punktów artykulacji
+ * split_lock.
+ * @param[in,out] g   – wskaźnik na strukturę przechowującą stan gry,
+ * @param[in] player  – numer gracza.
+ * @return Wartość @p true, jeśli gracz może wykonać złoty ruch,
+ * a @p false w przeciwnym przypadku.
+ */
+static bool golden_possible_locked(gamma_t *g, uint32_t player) {
+  if ((g == NULL || player == 0) || (player > g->players)) {
+    return false;
+  }
+  else {
+    golden_cache_t answer;
+    int quick = golden_possible_quick(g, player, &answer);
 
-          if (x != (g->width - 1)) {
-            if (g->board[x + 1][y] == player) {
-              specific_case = 0;
-            }
-          }
+    if (quick >= 0) {
+      return quick;
+    }
 
-          if (y != (g->height - 1)) {
-            if (g->board[x][y + 1] == player) {
-              specific_case = 0;
-            }
-          }
-  
-          if (specific_case == 1) {
-            return false;
-          }
-        }
+    // poziom 3: dokładna liczba kawałków z indeksu punktów artykulacji;
+    // indeks przebudowuje naraz jeden wątek, a pozostałe zamiast czekać
+    // liczą kawałki kandydatów we własnej pamięci roboczej
+    if (split_index_acquire(g, player)) {
+      bool result = golden_possible_exact(g, player, answer, true);
+      pthread_mutex_unlock(&g->split_lock);
+      return result;
+    }
+    return golden_possible_exact(g, player, answer, false);
+  }
+}
 
-        uint32_t robbed_player = g->board[x][y];
-        uint64_t copy_areas_taken_player = g->areas_taken[player - 1];
-        uint64_t copy_areas_taken_robbed_player =
-          g->areas_taken[robbed_player - 1];
-        g->board[x][y] = player;
-        g->areas_taken[player - 1] = g->fields_taken[player - 1] + 1;
-        g->areas_taken[robbed_player - 1] =
-          g->fields_taken[robbed_player - 1] - 1;
-
-        for (uint32_t i = 0; i < g->width; i++) {
-          for (uint32_t j = 0; j < g->height; j++) {
-            g->copy_rank[i][j] = g->rank[i][j];
-            g->copy_parent[i][j] = g->parent[i][j];
-
-            if(g->board[i][j] == player) {
-              g->parent[i][j] = i + (j * g->width);
-              g->rank[i][j] = 0;
-            }
+/** @brief Sprawdza złote ruchy kolejnych graczy.
+ * Najpierw rozstrzyga poziomami od 0 do 2 wszystkich graczy, a indeks
+ * punktów artykulacji dla pozostałych przebudowuje raz, zamiast osobno
+ * dla każdego z nich. Wątek musi trzymać blokadę gry, wystarczy do
+ * czytania.
+ * @param[in,out] g   – wskaźnik na strukturę przechowującą stan gry,
+ * @param[in] first   – numer pierwszego gracza,
+ * @param[in] count   – liczba graczy, nie wychodzi poza ostatniego,
+ * @param[out] stats  – statystyki, w których wypełniamy golden_possible.
+ */
+static void golden_possible_range(gamma_t *g, uint32_t first, uint32_t count,
+  gamma_player_stats_t *stats) {
 
-            if(g->board[i][j] == robbed_player) {
-              g->parent[i][j] = i + (j * g->width);
-              g->rank[i][j] = 0;
-            }
-          }
-        }
+  // answers[i].valid mówi, czy gracz first + i czeka na poziom 3
+  golden_cache_t *answers = malloc(count * sizeof(golden_cache_t));
+  bool pending = false;
 
-        for (uint32_t i = 0; i < g->width; i++) {
-          for(uint32_t j = 0; j < g->height; j++) {
-            if(g->board[i][j] == player) {
-              Union_helper(g, player, i, j);
-            }
+  if (answers == NULL) {
+    for (uint32_t i = 0; i < count; i++) {
+      stats[i].golden_possible = golden_possible_locked(g, first + i);
+    }
+    return;
+  }
 
-            if(g->board[i][j] == robbed_player) {
-              Union_helper(g, robbed_player, i, j);
-            }
-          }
-        }
+  for (uint32_t i = 0; i < count; i++) {
+    int quick = golden_possible_quick(g, first + i, &answers[i]);
 
-        if ((g->areas_taken[player - 1] > g->areas) ||
-          (g->areas_taken[robbed_player - 1] > g->areas)) {
+    stats[i].golden_possible = (quick > 0);
+    answers[i].valid = (quick < 0);
+    pending |= (quick < 0);
+  }
 
-          for (uint32_t i = 0; i < g->width; i++) {
-            for (uint32_t j = 0; j < g->height; j++) {
-              g->rank[i][j] = g->copy_rank[i][j];
-              g->parent[i][j] = g->copy_parent[i][j];
-            }
-          }
+  if (pending) {
+    bool indexed = split_index_acquire(g, 0);
 
-          g->areas_taken[player - 1] = copy_areas_taken_player;
-          g->areas_taken[robbed_player - 1] = copy_areas_taken_robbed_player;
-          g->board[x][y] = robbed_player;
-          return false;
-        }
-        else {
-          g->golden[player - 1] = 1;
-          g->fields_taken[player - 1]++;
-          g->fields_taken[robbed_player - 1]--;
-          g->free_fields_around[robbed_player - 1] =
-            g->free_fields_around[robbed_player - 1] -
-            delta_free_fields_around(g, x, y, robbed_player, 1);
-          g->free_fields_around[player - 1] =
-            g->free_fields_around[player - 1] +
-            delta_free_fields_around(g, x, y, player, 1);
-          return true;
-        }
+    for (uint32_t i = 0; i < count; i++) {
+      if (answers[i].valid) {
+        stats[i].golden_possible = golden_possible_exact(g, first + i,
+          answers[i], indexed);
       }
     }
+    if (indexed) {
+      pthread_mutex_unlock(&g->split_lock);
+    }
   }
+  free(answers);
 }
 
-uint64_t gamma_busy_fields(gamma_t *g, uint32_t player) {
-  if (g != NULL) {
-    if (player > 0 && player <= g->players) {  
-      return g->fields_taken[player - 1];
-    }
-    else {
-      return 0;
-    }
+uint32_t number_of_digits(uint32_t number) {
+  if (number < 10) {
+    return 1;
   }
   else {
-    return 0;
+    return (1 + number_of_digits(number/10));
   }
 }
 
-uint64_t gamma_free_fields(gamma_t *g, uint32_t player) {
-  if (g != NULL) {
-    if (player > 0 && player <= g->players)
-      if (g->areas_taken[player - 1] < g->areas) {
-        return g->free_fields;
-      }
-      else {
-        return g->free_fields_around[player - 1];
-      }
-    else {
-      return 0;
-    }
+bool gamma_golden_possible(gamma_t *g, uint32_t player) {
+  if (g == NULL) {
+    return false;
   }
   else {
-    return 0;
+    STATS_START();
+    TRACE_BEGIN(TRACE_GOLDEN_POSSIBLE, player, 0, 0);
+    pthread_rwlock_rdlock(&g->lock);
+    bool result = golden_possible_locked(g, player);
+    pthread_rwlock_unlock(&g->lock);
+    TRACE_END(TRACE_GOLDEN_POSSIBLE, result);
+    STATS_CALL(g, GAMMA_CALL_GOLDEN_POSSIBLE);
+
+    return result;
   }
 }
 
-bool gamma_golden_possible(gamma_t *g, uint32_t player) {
-  if ((g == NULL || player == 0) || (player > g->players)) {
-    return false;
+uint32_t gamma_player_stats(gamma_t *g, uint32_t first, uint32_t count,
+                            bool golden, gamma_player_stats_t *stats) {
+  if ((g == NULL || stats == NULL) || (first == 0 || first > g->players)) {
+    return 0;
   }
   else {
-    // sprawdzanie całej planszy
-    for (uint32_t x = 0; x < g->width; x++) {
-      for (uint32_t y = 0; y < g->height; y++) {
-        if (g->board[x][y] != 0) {
-          if ((g->golden[player - 1] != 1) && (g->board[x][y] != player)) {
-            bool go_next = false;
-
-            if (g->areas_taken[player - 1] == g->areas) {
-              bool specific_case = 1;
-
-              if (x != 0) {
-                if (g->board[x - 1][y] == player) {
-                  specific_case = 0;
-                }
-              }
+    if (count > g->players - first + 1) {
+      count = g->players - first + 1;
+    }
 
-              if (y != 0) {
-                if (g->board[x][y - 1] == player) {
-                  specific_case = 0;
-                }
-              }
+    STATS_START();
+    pthread_rwlock_rdlock(&g->lock);
+    for (uint32_t i = 0; i < count; i++) {
+      uint32_t player = first + i;
 
-              if (x != (g->width - 1)) {
-                if (g->board[x + 1][y] == player) {
-                  specific_case = 0;
-                }
-              }
+      stats[i].busy_fields = g->fields_taken[player - 1];
+      stats[i].free_fields = read_free_fields(g, player);
+      stats[i].areas = g->areas_taken[player - 1];
+      stats[i].golden_possible = false;
+    }
+    if (golden) {
+      golden_possible_range(g, first, count, stats);
+    }
+    pthread_rwlock_unlock(&g->lock);
+    STATS_CALL(g, GAMMA_CALL_PLAYER_STATS);
 
-              if (y != (g->height - 1)) {
-                if (g->board[x][y + 1] == player) {
-                  specific_case = 0;
-                }
-              }
-  
-              if (specific_case == 1) {
-                go_next = true;
-              }
-            }
+    return count;
+  }
+}
 
-            if (go_next == false) {
-              uint32_t robbed_player = g->board[x][y];
-              uint64_t copy_areas_taken_player = g->areas_taken[player - 1];
-              uint64_t copy_areas_taken_robbed_player =
-                g->areas_taken[robbed_player - 1];
-              g->board[x][y] = player;
-              g->areas_taken[player - 1] = g->fields_taken[player - 1] + 1;
-              g->areas_taken[robbed_player - 1] =
-                g->fields_taken[robbed_player - 1] - 1;
-
-              for (uint32_t i = 0; i < g->width; i++) {
-                for (uint32_t j = 0; j < g->height; j++) {
-                  g->copy_rank[i][j] = g->rank[i][j];
-                  g->copy_parent[i][j] = g->parent[i][j];
-
-                  if(g->board[i][j] == player) {
-                    g->parent[i][j] = i + (j * g->width);
-                    g->rank[i][j] = 0;
-                  }
-
-                  if(g->board[i][j] == robbed_player) {
-                    g->parent[i][j] = i + (j * g->width);
-                    g->rank[i][j] = 0;
-                  }
-                }
-              }
+/** @brief Odpowiada na zapytanie o złoty ruch bez zmieniania stanu gry.
+ * Wątek musi trzymać blokadę.
+ * @param[in] g           – wskaźnik na strukturę przechowującą stan gry,
+ * @param[in] player      – numer gracza,
+ * @param[in,out] scratch – pamięć robocza wątku.
+ * @return Wartość @p true, jeśli gracz może wykonać złoty ruch,
+ * a @p false w przeciwnym przypadku.
+ */
+static bool query_golden_possible_locked(const gamma_t *g, uint32_t player,
+  gamma_scratch_t *scratch) {
 
-              for (uint32_t i = 0; i < g->width; i++) {
-                for(uint32_t j = 0; j < g->height; j++) {
-                  if(g->board[i][j] == player) {
-                    Union_helper(g, player, i, j);
-                  }
+  uint64_t fields = (uint64_t)g->width * g->height;
+  uint64_t foreign = fields - g->free_fields - g->fields_taken[player - 1];
 
-                  if(g->board[i][j] == robbed_player) {
-                    Union_helper(g, robbed_player, i, j);
-                  }
-                }
-              }
+  if (g->golden[player - 1] == 1 || foreign == 0) {
+    return false;
+  }
+  if (g->areas_taken[player - 1] < g->areas) {
+    return true;
+  }
 
-              if ((g->areas_taken[player - 1] > g->areas) ||
-                (g->areas_taken[robbed_player - 1] > g->areas)) {
+  bool possible;
+  if (golden_cache_get(g, player, &possible)) {
+    return possible;
+  }
+  return golden_scan_exact(g, player, scratch) != 0;
+}
 
-                for (uint32_t i = 0; i < g->width; i++) {
-                  for (uint32_t j = 0; j < g->height; j++) {
-                    g->rank[i][j] = g->copy_rank[i][j];
-                    g->parent[i][j] = g->copy_parent[i][j];
-                  }
-                }
+uint64_t gamma_query_busy_fields(const gamma_t *g, uint32_t player) {
+  if (g == NULL) {
+    return 0;
+  }
+  else {
+    pthread_rwlock_t *lock = (pthread_rwlock_t*)&g->lock;
 
-                g->areas_taken[player - 1] = copy_areas_taken_player;
-                g->areas_taken[robbed_player - 1] =
-                  copy_areas_taken_robbed_player;
-                g->board[x][y] = robbed_player;
-              }
-              else {
-                for (uint32_t i = 0; i < g->width; i++) {
-                  for (uint32_t j = 0; j < g->height; j++) {
-                    g->rank[i][j] = g->copy_rank[i][j];
-                    g->parent[i][j] = g->copy_parent[i][j];
-                  }
-                }
+    STATS_START();
+    pthread_rwlock_rdlock(lock);
+    uint64_t result = read_busy_fields(g, player);
+    pthread_rwlock_unlock(lock);
+    STATS_CALL(g, GAMMA_CALL_BUSY_FIELDS);
 
-                g->areas_taken[player - 1] = copy_areas_taken_player;
-                g->areas_taken[robbed_player - 1] =
-                  copy_areas_taken_robbed_player;
-                g->board[x][y] = robbed_player;
-                return true;
-              }
-            }
-          }
-        }
-      }
-    }
-    return false;
+    return result;
   }
 }
 
-uint32_t number_of_digits(uint32_t number) {
-  if (number < 10) {
-    return 1;
+uint64_t gamma_query_free_fields(const gamma_t *g, uint32_t player) {
+  if (g == NULL) {
+    return 0;
   }
   else {
-    return (1 + number_of_digits(number/10));
+    pthread_rwlock_t *lock = (pthread_rwlock_t*)&g->lock;
+
+    STATS_START();
+    pthread_rwlock_rdlock(lock);
+    uint64_t result = read_free_fields(g, player);
+    pthread_rwlock_unlock(lock);
+    STATS_CALL(g, GAMMA_CALL_FREE_FIELDS);
+
+    return result;
   }
 }
 
-char* gamma_board(gamma_t *g) {
+bool gamma_query_golden_possible(const gamma_t *g, uint32_t player,
+  gamma_scratch_t *scratch) {
+
+  if ((g == NULL || player == 0) || (player > g->players)) {
+    return false;
+  }
+  else {
+    gamma_scratch_t *own = NULL;
+
+    if (scratch == NULL) {
+      own = gamma_scratch_new();
+      scratch = own;
+      if (scratch == NULL) {
+        return false;
+      }
+    }
+
+    pthread_rwlock_t *lock = (pthread_rwlock_t*)&g->lock;
+
+    STATS_START();
+    pthread_rwlock_rdlock(lock);
+    bool result = query_golden_possible_locked(g, player, scratch);
+    pthread_rwlock_unlock(lock);
+    STATS_CALL(g, GAMMA_CALL_QUERY_GOLDEN_POSSIBLE);
+
+    gamma_scratch_delete(own);
+    return result;
+  }
+}
+
+/** @brief Daje napis opisujący stan planszy. Wątek musi trzymać blokadę.
+ * @param[in] g       – wskaźnik na strukturę przechowującą stan gry.
+ * @return Wskaźnik na zaalokowany bufor zawierający napis opisujący stan
+ * planszy lub NULL, jeśli nie udało się zaalokować pamięci.
+ */
+static char* board_locked(const gamma_t *g) {
   if (g != NULL) {
     uint64_t width_tmp = g->width;
     uint64_t size;
@@ -981,13 +3441,16 @@ char* gamma_board(gamma_t *g) {
       if (g->players < 10) {
         // w pętli j "powiększone" o 1 by się ona skończyła
         for (uint32_t j = g->height; j >= 1; j--) {
+          uint64_t row = (uint64_t)(j - 1) * g->width;
           for (uint32_t i = 0; i < g->width; i++) {
-            if (g->board[i][j - 1] == 0) {
+            uint32_t owner = field_owner(g, row + i);
+
+            if (owner == 0) {
               bufor[number_of_chars] = '.';
               number_of_chars++;
             }
             else {
-              bufor[number_of_chars] = g->board[i][j - 1] + '0';
+              bufor[number_of_chars] = owner + '0';
               number_of_chars++;
             }
           }
@@ -1000,8 +3463,11 @@ char* gamma_board(gamma_t *g) {
 
         // w pętli j "powiększone" o 1 by się ona skończyła
         for (uint32_t j = g->height; j >= 1; j--) {
+          uint64_t row = (uint64_t)(j - 1) * g->width;
           for (uint32_t i = 0; i < g->width; i++) {
-            if (g->board[i][j - 1] == 0) {
+            uint32_t owner = field_owner(g, row + i);
+
+            if (owner == 0) {
               for (uint32_t k = 0; k < (length - 1); k++) {
                 bufor[number_of_chars] = ' ';
                 number_of_chars++;
@@ -1013,36 +3479,36 @@ char* gamma_board(gamma_t *g) {
               number_of_chars++;
             }
             else {
-              if (g->board[i][j - 1] < 10) {
+              if (owner < 10) {
                 for (uint32_t k = 0; k < (length - 1); k++) {
                   bufor[number_of_chars] = ' ';
                   number_of_chars++;
                 }
 
-                bufor[number_of_chars] = g->board[i][j - 1] + '0';
+                bufor[number_of_chars] = owner + '0';
                 number_of_chars++;
                 bufor[number_of_chars] = ' ';
                 number_of_chars++;
               }
               else {
                 uint32_t number_of_whitespaces =
-                  length - number_of_digits(g->board[i][j - 1]) + 1;
+                  length - number_of_digits(owner) + 1;
                 for (uint32_t k = 0; k < (number_of_whitespaces - 1); k++) {
                   bufor[number_of_chars] = ' ';
                   number_of_chars++;
                 }
 
-                uint32_t number = g->board[i][j - 1];
+                uint32_t number = owner;
                 // w pętli k "powiększone" o 1 by się ona skończyła
                 for (uint64_t k = number_of_chars +
-                  number_of_digits(g->board[i][j - 1]);
+                  number_of_digits(owner);
                   k > number_of_chars; k--) {
 
                   bufor[k - 1] = (number % 10) + '0';
                   number = (number - (number % 10))/10;
                 }
                 number_of_chars =
-                  number_of_chars + number_of_digits(g->board[i][j - 1]);
+                  number_of_chars + number_of_digits(owner);
 
                 bufor[number_of_chars] = ' ';
                 number_of_chars++;
@@ -1080,6 +3546,158 @@ uint64_t return_fields_taken(gamma_t *g, uint32_t player) {
   return g->fields_taken[player - 1];
 }
 
+uint32_t return_field_owner(gamma_t *g, uint32_t x, uint32_t y) {
+  if (x >= g->width || y >= g->height) {
+    return 0;
+  }
+  return field_owner(g, x + (uint64_t)y * g->width);
+}
+
 uint64_t return_free_fields_around(gamma_t *g, uint32_t player) {
   return g->free_fields_around[player - 1];
 }
+
+uint64_t return_golden_tier_hits(gamma_t *g, uint32_t tier) {
+  if (g == NULL || tier >= GAMMA_GOLDEN_TIERS) {
+    return 0;
+  }
+  return atomic_load_explicit(&g->golden_tier_hits[tier],
+    memory_order_relaxed);
+}
+
+void gamma_set_threads(gamma_t *g, uint32_t threads) {
+  if (g != NULL) {
+    if (threads == 0) {
+      long cores = sysconf(_SC_NPROCESSORS_ONLN);
+
+      threads = 1;
+      if (cores > 1) {
+        threads = cores;
+      }
+    }
+    pthread_rwlock_wrlock(&g->lock);
+    if (g->threads != threads) {
+      // wątki pomocnicze powstaną od nowa przy następnym przeglądaniu
+      pool_stop(&g->pool);
+    }
+    g->threads = threads;
+    pthread_rwlock_unlock(&g->lock);
+  }
+}
+
+char* gamma_board(gamma_t *g) {
+  return gamma_query_board(g);
+}
+
+char* gamma_query_board(const gamma_t *g) {
+  if (g == NULL) {
+    return NULL;
+  }
+  else {
+    pthread_rwlock_t *lock = (pthread_rwlock_t*)&g->lock;
+
+    STATS_START();
+    TRACE_BEGIN(TRACE_BOARD, 0, 0, 0);
+    pthread_rwlock_rdlock(lock);
+    char *result = board_locked(g);
+    pthread_rwlock_unlock(lock);
+    TRACE_END(TRACE_BOARD, result != NULL ? strlen(result) : 0);
+    STATS_CALL(g, GAMMA_CALL_BOARD);
+
+    return result;
+  }
+}
+
+bool gamma_stats(const gamma_t *g, gamma_stats_t *stats) {
+  if (stats == NULL) {
+    return false;
+  }
+  memset(stats, 0, sizeof(gamma_stats_t));
+#ifdef GAMMA_STATS
+  if (g != NULL) {
+    const stats_counters_t *counters = &g->stats;
+
+    for (uint32_t i = 0; i < GAMMA_CALLS; i++) {
+      stats->calls[i] = atomic_load_explicit(&counters->calls[i],
+        memory_order_relaxed);
+      stats->ns[i] = atomic_load_explicit(&counters->ns[i],
+        memory_order_relaxed);
+    }
+    for (uint32_t i = 0; i < GAMMA_STATS_FIND_DEPTHS; i++) {
+      stats->find_depth[i] = atomic_load_explicit(&counters->find_depth[i],
+        memory_order_relaxed);
+    }
+    stats->unions = atomic_load_explicit(&counters->unions,
+      memory_order_relaxed);
+    stats->split_rebuilds = atomic_load_explicit(&counters->split_rebuilds,
+      memory_order_relaxed);
+    stats->split_rebuild_cells = atomic_load_explicit(
+      &counters->split_rebuild_cells, memory_order_relaxed);
+    stats->golden_scans = atomic_load_explicit(&counters->golden_scans,
+      memory_order_relaxed);
+    stats->golden_scan_cells = atomic_load_explicit(
+      &counters->golden_scan_cells, memory_order_relaxed);
+    return true;
+  }
+#else
+  (void)g;
+#endif
+  return false;
+}
+
+void gamma_stats_reset(gamma_t *g) {
+#ifdef GAMMA_STATS
+  if (g != NULL) {
+    stats_counters_t *counters = &g->stats;
+
+    for (uint32_t i = 0; i < GAMMA_CALLS; i++) {
+      atomic_store_explicit(&counters->calls[i], 0, memory_order_relaxed);
+      atomic_store_explicit(&counters->ns[i], 0, memory_order_relaxed);
+    }
+    for (uint32_t i = 0; i < GAMMA_STATS_FIND_DEPTHS; i++) {
+      atomic_store_explicit(&counters->find_depth[i], 0, memory_order_relaxed);
+    }
+    atomic_store_explicit(&counters->unions, 0, memory_order_relaxed);
+    atomic_store_explicit(&counters->split_rebuilds, 0, memory_order_relaxed);
+    atomic_store_explicit(&counters->split_rebuild_cells, 0,
+      memory_order_relaxed);
+    atomic_store_explicit(&counters->golden_scans, 0, memory_order_relaxed);
+    atomic_store_explicit(&counters->golden_scan_cells, 0,
+      memory_order_relaxed);
+  }
+#else
+  (void)g;
+#endif
+}
+
+bool gamma_trace_dump(const char *path) {
+#ifdef GAMMA_TRACE
+  FILE *file = fopen(path, "w");
+  if (file == NULL) {
+    return false;
+  }
+
+  bool first = true;
+  bool result = true;
+  fprintf(file, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+  for (trace_ring_t *ring = atomic_load(&trace_rings); ring != NULL;
+    ring = ring->next) {
+
+    if (!trace_write_ring(ring, file, &first)) {
+      result = false;
+    }
+  }
+  fprintf(file, "\n]}\n");
+
+  if (ferror(file)) {
+    result = false;
+  }
+  if (fclose(file) != 0) {
+    result = false;
+  }
+  return result;
+#else
+  (void)path;
+  return false;
+#endif
+}
@@ -12,6 +12,49 @@
 #include <stdbool.h>
 #include <stdint.h>
 
+/**
+ * Liczba poziomów sprawdzania w @ref gamma_golden_possible.
+ */
+#define GAMMA_GOLDEN_TIERS 4
+
+/**
+ * Liczba przedziałów histogramu głębokości find w @ref gamma_stats_t,
+ * ostatni zbiera wszystkie głębsze wywołania.
+ */
+#define GAMMA_STATS_FIND_DEPTHS 16
+
+/**
+ * Funkcje interfejsu, których wywołania liczy @ref gamma_stats.
+ */
+typedef enum gamma_stats_call {
+  GAMMA_CALL_MOVE,            ///< @ref gamma_move
+  GAMMA_CALL_GOLDEN_MOVE,     ///< @ref gamma_golden_move
+  GAMMA_CALL_APPLY_MOVES,     ///< @ref gamma_apply_moves
+  GAMMA_CALL_BUSY_FIELDS,     ///< @ref gamma_busy_fields i wersja query
+  GAMMA_CALL_FREE_FIELDS,     ///< @ref gamma_free_fields i wersja query
+  GAMMA_CALL_GOLDEN_POSSIBLE, ///< @ref gamma_golden_possible
+  GAMMA_CALL_QUERY_GOLDEN_POSSIBLE, ///< @ref gamma_query_golden_possible
+  GAMMA_CALL_PLAYER_STATS,    ///< @ref gamma_player_stats
+  GAMMA_CALL_BOARD,           ///< @ref gamma_board i wersja query
+  GAMMA_CALLS                 ///< liczba liczonych funkcji
+} gamma_stats_call_t;
+
+/**
+ * Liczniki wewnętrzne silnika wypełniane przez @ref gamma_stats.
+ */
+typedef struct gamma_stats {
+  uint64_t calls[GAMMA_CALLS]; ///< liczba wywołań każdej funkcji
+  uint64_t ns[GAMMA_CALLS];    ///< łączny czas wywołań w nanosekundach
+  uint64_t find_depth[GAMMA_STATS_FIND_DEPTHS]; /**< liczba wywołań find
+  * według długości ścieżki do korzenia */
+  uint64_t unions;             ///< liczba połączeń dwóch różnych obszarów
+  uint64_t split_rebuilds;     ///< liczba przebudów indeksu złotych ruchów
+  uint64_t split_rebuild_cells; ///< pola odwiedzone przy tych przebudowach
+  uint64_t golden_scans;       /**< liczba przeglądań planszy w poszukiwaniu
+  * złotego ruchu */
+  uint64_t golden_scan_cells;  ///< pola odwiedzone przy tych przeglądaniach
+} gamma_stats_t;
+
 /**
  * Struktura przechowująca stan gry.
  */
@@ -68,8 +111,48 @@ bool gamma_move(gamma_t *g, uint32_t player, uint32_t x, uint32_t y);
  */
 bool gamma_golden_move(gamma_t *g, uint32_t player, uint32_t x, uint32_t y);
 
+/**
+ * Rodzaj ruchu w paczce przekazywanej do @ref gamma_apply_moves.
+ */
+typedef enum gamma_move_kind {
+  GAMMA_MOVE_NORMAL = 0, ///< zwykły ruch, jak w @ref gamma_move
+  GAMMA_MOVE_GOLDEN = 1  ///< złoty ruch, jak w @ref gamma_golden_move
+} gamma_move_kind_t;
+
+/**
+ * Pojedynczy ruch w paczce przekazywanej do @ref gamma_apply_moves.
+ */
+typedef struct gamma_move_record {
+  uint8_t kind;    ///< rodzaj ruchu, jedna z wartości @ref gamma_move_kind_t
+  uint32_t player; ///< numer gracza wykonującego ruch
+  uint32_t x;      ///< numer kolumny pola
+  uint32_t y;      ///< numer wiersza pola
+} gamma_move_record_t;
+
+/** @brief Wykonuje paczkę ruchów.
+ * Wykonuje po kolei ruchy z tablicy @p moves, tak jakby dla każdego z nich
+ * wywołać @ref gamma_move lub @ref gamma_golden_move, ale blokadę gry
+ * zakłada tylko raz na całą paczkę. Ruchy są wykonywane w podanej
+ * kolejności, bo legalność każdego z nich zależy od liczby obszarów
+ * graczy po poprzednich.
+ * @param[in,out] g     – wskaźnik na strukturę przechowującą stan gry,
+ * @param[in] moves     – tablica ruchów,
+ * @param[in] count     – liczba ruchów w tablicy @p moves,
+ * @param[out] results  – mapa bitowa wyników o długości co najmniej
+ *                        (@p count + 7) / 8 bajtów lub NULL; bit @p i % 8
+ *                        bajtu @p i / 8 jest ustawiony, gdy @p i-ty ruch
+ *                        został wykonany.
+ * @return Liczba wykonanych ruchów lub zero, gdy @p g lub @p moves
+ * to NULL.
+ */
+uint64_t gamma_apply_moves(gamma_t *g, const gamma_move_record_t *moves,
+                           uint64_t count, uint8_t *results);
+
 /** @brief Podaje liczbę pól zajętych przez gracza.
  * Podaje liczbę pól zajętych przez gracza @p player.
+ * Nie zakłada blokady gry, więc kosztuje tyle co odczyt licznika, ale nie
+ * wolno jej wywoływać w trakcie ruchu wykonywanego przez inny wątek;
+ * do tego służy @ref gamma_query_busy_fields.
  * @param[in] g       – wskaźnik na strukturę przechowującą stan gry,
  * @param[in] player  – numer gracza, liczba dodatnia niewiększa od wartości
  *                      @p players z funkcji @ref gamma_new.
@@ -81,6 +164,9 @@ uint64_t gamma_busy_fields(gamma_t *g, uint32_t player);
 /** @brief Podaje liczbę pól, jakie jeszcze gracz może zająć.
  * Podaje liczbę wolnych pól, na których w danym stanie gry gracz @p player może
  * postawić swój pionek w następnym ruchu.
+ * Nie zakłada blokady gry, więc kosztuje tyle co odczyt dwóch liczników, ale
+ * nie wolno jej wywoływać w trakcie ruchu wykonywanego przez inny wątek;
+ * do tego służy @ref gamma_query_free_fields.
  * @param[in] g       – wskaźnik na strukturę przechowującą stan gry,
  * @param[in] player  – numer gracza, liczba dodatnia niewiększa od wartości
  *                      @p players z funkcji @ref gamma_new.
@@ -90,6 +176,9 @@ uint64_t gamma_busy_fields(gamma_t *g, uint32_t player);
 uint64_t gamma_free_fields(gamma_t *g, uint32_t player);
 
 /** @brief Sprawdza, czy gracz może wykonać złoty ruch.
+ * Zapamiętuje odpowiedź do następnego ruchu, który może ją zmienić.
+ * Może być wywoływana przez wiele wątków naraz, także w trakcie ruchów
+ * wykonywanych przez inny wątek.
  * @param[in] g       – wskaźnik na strukturę przechowującą stan gry,
  * @param[in] player  – numer gracza, liczba dodatnia niewiększa od wartości
  *                      @p players z funkcji @ref gamma_new.
@@ -114,6 +203,36 @@ char* gamma_board(gamma_t *g);
  */
 uint32_t number_of_digits(uint32_t number);
 
+/**
+ * Statystyki jednego gracza wypełniane przez @ref gamma_player_stats.
+ */
+typedef struct gamma_player_stats {
+  uint64_t busy_fields; ///< liczba pól zajętych przez gracza
+  uint64_t free_fields; ///< liczba pól, jakie gracz może jeszcze zająć
+  uint32_t areas;       ///< liczba obszarów zajętych przez gracza
+  bool golden_possible; ///< czy gracz może wykonać złoty ruch
+} gamma_player_stats_t;
+
+/** @brief Podaje statystyki kolejnych graczy.
+ * Wypełnia @p stats tym, co zwróciłyby @ref gamma_busy_fields,
+ * @ref gamma_free_fields i @ref gamma_golden_possible, oraz liczbą obszarów
+ * dla graczy od @p first do @p first + @p count - 1, ale nie dalej niż
+ * do ostatniego gracza. Blokadę gry do odczytu zakłada tylko raz, więc
+ * może działać równolegle z innymi zapytaniami. Złote ruchy wszystkich
+ * graczy sprawdza naraz, a gdy @p golden jest false, w ogóle ich nie
+ * sprawdza i kosztuje tyle co odczyt liczników.
+ * @param[in,out] g   – wskaźnik na strukturę przechowującą stan gry,
+ * @param[in] first   – numer pierwszego gracza, liczba dodatnia niewiększa
+ *                      od wartości @p players z funkcji @ref gamma_new,
+ * @param[in] count   – liczba graczy,
+ * @param[in] golden  – czy wypełnić golden_possible; gdy nie, jest false,
+ * @param[out] stats  – tablica na co najmniej @p count statystyk.
+ * @return Liczba wypełnionych statystyk lub zero, jeśli któryś
+ * z parametrów jest niepoprawny.
+ */
+uint32_t gamma_player_stats(gamma_t *g, uint32_t first, uint32_t count,
+                            bool golden, gamma_player_stats_t *stats);
+
 /** @brief Zwraca ilość graczy w grze.
  * @param[in] g       – wskaźnik na strukturę przechowującą stan gry.
  * @return Ilość graczy w grze.
@@ -139,6 +258,15 @@ uint32_t return_height(gamma_t *g);
  */
 uint64_t return_fields_taken(gamma_t *g, uint32_t player);
 
+/** @brief Zwraca numer gracza zajmującego pole.
+ * @param[in] g       – wskaźnik na strukturę przechowującą stan gry.
+ * @param[in] x       – numer kolumny pola.
+ * @param[in] y       – numer wiersza pola.
+ * @return Numer gracza na polu (@p x, @p y) lub zero, gdy pole jest wolne
+ * lub leży poza planszą.
+ */
+uint32_t return_field_owner(gamma_t *g, uint32_t x, uint32_t y);
+
 /** @brief Zwraca ilość wolnych pól dla danego gracza.
  * @param[in] g       – wskaźnik na strukturę przechowującą stan gry.
  * @param[in] player  – numer gracza.
@@ -146,4 +274,122 @@ uint64_t return_fields_taken(gamma_t *g, uint32_t player);
  */
 uint64_t return_free_fields_around(gamma_t *g, uint32_t player);
 
+/**
+ * Pamięć robocza zapytań tylko do odczytu, osobna dla każdego wątku.
+ */
+typedef struct gamma_scratch gamma_scratch_t;
+
+/** @brief Tworzy pamięć roboczą zapytań tylko do odczytu.
+ * Jednej pamięci roboczej może w danej chwili używać tylko jeden wątek,
+ * może ona służyć do zapytań o wiele gier.
+ * @return Wskaźnik na utworzoną pamięć roboczą lub NULL, gdy nie udało się
+ * zaalokować pamięci.
+ */
+gamma_scratch_t* gamma_scratch_new(void);
+
+/** @brief Usuwa pamięć roboczą zapytań tylko do odczytu.
+ * Nic nie robi, jeśli wskaźnik ma wartość NULL.
+ * @param[in] scratch – wskaźnik na usuwaną pamięć roboczą.
+ */
+void gamma_scratch_delete(gamma_scratch_t *scratch);
+
+/** @brief Podaje liczbę pól zajętych przez gracza, nie zmieniając gry.
+ * Może być wywoływana przez wiele wątków naraz, także w trakcie ruchów
+ * wykonywanych przez inny wątek.
+ * @param[in] g       – wskaźnik na strukturę przechowującą stan gry,
+ * @param[in] player  – numer gracza, liczba dodatnia niewiększa od wartości
+ *                      @p players z funkcji @ref gamma_new.
+ * @return Liczba pól zajętych przez gracza lub zero,
+ * jeśli któryś z parametrów jest niepoprawny.
+ */
+uint64_t gamma_query_busy_fields(const gamma_t *g, uint32_t player);
+
+/** @brief Podaje liczbę pól, jakie jeszcze gracz może zająć, nie zmieniając
+ * gry. Może być wywoływana przez wiele wątków naraz, także w trakcie ruchów
+ * wykonywanych przez inny wątek.
+ * @param[in] g       – wskaźnik na strukturę przechowującą stan gry,
+ * @param[in] player  – numer gracza, liczba dodatnia niewiększa od wartości
+ *                      @p players z funkcji @ref gamma_new.
+ * @return Liczba pól, jakie jeszcze może zająć gracz, lub zero,
+ * jeśli któryś z parametrów jest niepoprawny.
+ */
+uint64_t gamma_query_free_fields(const gamma_t *g, uint32_t player);
+
+/** @brief Sprawdza, czy gracz może wykonać złoty ruch, nie zmieniając gry.
+ * W przeciwieństwie do @ref gamma_golden_possible nie zapamiętuje
+ * odpowiedzi, a obszary przeszukuje w pamięci roboczej wywołującego.
+ * Może być wywoływana przez wiele wątków naraz, także w trakcie ruchów
+ * wykonywanych przez inny wątek.
+ * @param[in] g           – wskaźnik na strukturę przechowującą stan gry,
+ * @param[in] player      – numer gracza, liczba dodatnia niewiększa od
+ *                          wartości @p players z funkcji @ref gamma_new,
+ * @param[in,out] scratch – pamięć robocza wątku lub NULL, wtedy funkcja
+ *                          alokuje własną na czas wywołania.
+ * @return Wartość @p true, jeśli gracz może wykonać złoty ruch,
+ * a @p false w przeciwnym przypadku lub gdy zabrakło pamięci.
+ */
+bool gamma_query_golden_possible(const gamma_t *g, uint32_t player,
+                                 gamma_scratch_t *scratch);
+
+/** @brief Daje napis opisujący stan planszy, nie zmieniając gry.
+ * Może być wywoływana przez wiele wątków naraz, także w trakcie ruchów
+ * wykonywanych przez inny wątek.
+ * @param[in] g       – wskaźnik na strukturę przechowującą stan gry.
+ * @return Wskaźnik na zaalokowany bufor zawierający napis opisujący stan
+ * planszy lub NULL, jeśli nie udało się zaalokować pamięci.
+ */
+char* gamma_query_board(const gamma_t *g);
+
+/** @brief Podaje liczniki wewnętrzne silnika.
+ * Liczniki są wkompilowane w silnik tylko wtedy, gdy zdefiniowano
+ * GAMMA_STATS (opcja CMake GAMMA_STATS), w przeciwnym przypadku nic
+ * nie kosztują, a funkcja wypełnia @p stats zerami.
+ * @param[in] g       – wskaźnik na strukturę przechowującą stan gry,
+ * @param[out] stats  – wypełniane liczniki.
+ * @return Wartość @p true, jeśli silnik zbiera liczniki, a @p false, gdy
+ * zbudowano go bez nich lub któryś z parametrów jest niepoprawny.
+ */
+bool gamma_stats(const gamma_t *g, gamma_stats_t *stats);
+
+/** @brief Zeruje liczniki wewnętrzne silnika.
+ * W silniku zbudowanym bez GAMMA_STATS nic nie robi. Wywołania równoległe
+ * z innymi funkcjami mogą dać liczniki z części tych wywołań.
+ * @param[in,out] g   – wskaźnik na strukturę przechowującą stan gry.
+ */
+void gamma_stats_reset(gamma_t *g);
+
+/** @brief Zapisuje ślad operacji silnika w formacie Chrome trace (JSON).
+ * Ślad jest wkompilowany w silnik tylko wtedy, gdy zdefiniowano
+ * GAMMA_TRACE (opcja CMake GAMMA_TRACE). Każdy wątek zapisuje wtedy
+ * początki i końce ruchów, złotych ruchów, zapytań o złoty ruch, wypisywania
+ * planszy oraz wewnętrznych przebiegów find&union i przebudów indeksu
+ * do własnego bufora cyklicznego, bez blokad. Funkcję można wywołać
+ * w dowolnej chwili; plik da się otworzyć w chrome://tracing lub Perfetto.
+ * @param[in] path    – ścieżka pliku śladu.
+ * @return Wartość @p true, jeśli ślad został zapisany, a @p false, gdy
+ * zbudowano silnik bez śladu lub nie udało się zapisać pliku.
+ */
+bool gamma_trace_dump(const char *path);
+
+/** @brief Ustawia liczbę wątków przeglądających planszę.
+ * Z tylu wątków korzysta @ref gamma_golden_possible na dużych planszach.
+ * Domyślnie gra używa wszystkich dostępnych rdzeni. Wątki pomocnicze
+ * powstają przy pierwszym przeglądaniu, które ich potrzebuje, i czekają na
+ * kolejne aż do zmiany liczby wątków albo @ref gamma_delete.
+ * @param[in,out] g   – wskaźnik na strukturę przechowującą stan gry,
+ * @param[in] threads – liczba wątków, 0 oznacza liczbę dostępnych rdzeni.
+ */
+void gamma_set_threads(gamma_t *g, uint32_t threads);
+
+/** @brief Zwraca, ile zapytań o złoty ruch rozstrzygnął dany poziom.
+ * Poziom 0 to same liczniki, 1 zapamiętana odpowiedź, 2 przegląd listy
+ * cudzych pól sąsiadujących z polami gracza z oszacowaniem liczby kawałków
+ * przez liczbę sąsiadów pola, a 3 taki sam przegląd z dokładnym indeksem
+ * punktów artykulacji. Dla niepoprawnych parametrów zwraca 0.
+ * @param[in] g       – wskaźnik na strukturę przechowującą stan gry,
+ * @param[in] tier    – numer poziomu, mniejszy od @ref GAMMA_GOLDEN_TIERS.
+ * @return Liczba zapytań rozstrzygniętych na danym poziomie.
+ */
+uint64_t return_golden_tier_hits(gamma_t *g, uint32_t tier);
+
 #endif /* GAMMA_H */
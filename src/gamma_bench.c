@@ -0,0 +1,559 @@
+/** @file
+ * Pomiary wydajności silnika gry gamma
+ *
+ * Każde obciążenie jest generowane z ziarna, więc przy tym samym ziarnie
+ * powtarza dokładnie te same wywołania. Obciążenie działa w osobnym
+ * procesie, żeby szczytowe zużycie pamięci dotyczyło tylko jego.
+ *
+ * @author Rafał Szulc <r.s.szulc@gmail.com>
+ * @date 16.10.2026
+ */
+
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include "gamma.h"
+
+/**
+ * Maksymalna liczba rodzajów operacji mierzonych w jednym obciążeniu.
+ */
+#define BENCH_OPERATIONS 8
+
+/**
+ * Liczba zapytań między kolejnymi ruchami w burzy zapytań.
+ */
+#define QUERY_BURST 16
+
+/**
+ * Liczba plansz końcówki gry, na których mierzymy pierwsze zapytania
+ * o złoty ruch, przy mnożniku 1.
+ */
+#define GOLDEN_BOARDS 4
+
+/**
+ * Liczba powtórzeń zapytania o złoty ruch każdego gracza na niezmienionej
+ * planszy.
+ */
+#define GOLDEN_REPEATS 16
+
+/** @struct measure
+ * Łączny czas operacji jednego rodzaju.
+ */
+typedef struct measure {
+  char operation[24]; ///< Nazwa operacji.
+  uint64_t ops; ///< Liczba wykonanych operacji.
+  uint64_t ns; ///< Łączny czas operacji w nanosekundach.
+} measure_t;
+
+/** @struct bench
+ * Stan obciążenia wykonywanego w procesie potomnym.
+ */
+typedef struct bench {
+  gamma_t *game; ///< Mierzona gra.
+  uint32_t width; ///< Szerokość planszy.
+  uint32_t height; ///< Wysokość planszy.
+  uint32_t players; ///< Liczba graczy.
+  uint32_t areas; ///< Maksymalna liczba obszarów gracza.
+  uint64_t random; ///< Stan generatora liczb losowych.
+  uint64_t scale; ///< Mnożnik liczby operacji.
+  measure_t measures[BENCH_OPERATIONS]; ///< Zmierzone operacje.
+  uint8_t count; ///< Liczba zmierzonych rodzajów operacji.
+} bench_t;
+
+/** @struct workload
+ * Obciążenie o ustalonym rozmiarze planszy.
+ */
+typedef struct workload {
+  const char *name; ///< Nazwa obciążenia.
+  uint32_t width; ///< Szerokość planszy.
+  uint32_t height; ///< Wysokość planszy.
+  uint32_t players; ///< Liczba graczy.
+  uint32_t areas; ///< Maksymalna liczba obszarów gracza.
+  void (*run)(bench_t *bench); ///< Funkcja wykonująca obciążenie.
+} workload_t;
+
+/** @brief Zwraca czas monotoniczny.
+ * @return Czas w nanosekundach.
+ */
+static uint64_t now_ns(void) {
+  struct timespec time;
+
+  clock_gettime(CLOCK_MONOTONIC, &time);
+  return (uint64_t)time.tv_sec * 1000000000 + time.tv_nsec;
+}
+
+/** @brief Losuje liczbę mniejszą od @p bound generatorem xorshift64*.
+ * @param[in,out] bench – stan obciążenia,
+ * @param[in] bound     – liczba dodatnia.
+ * @return Wylosowana liczba.
+ */
+static uint32_t random_below(bench_t *bench, uint32_t bound) {
+  bench->random ^= bench->random >> 12;
+  bench->random ^= bench->random << 25;
+  bench->random ^= bench->random >> 27;
+
+  return ((bench->random * 0x2545F4914F6CDD1DULL) >> 32) % bound;
+}
+
+/** @brief Dolicza czas operacji danego rodzaju.
+ * @param[in,out] bench  – stan obciążenia,
+ * @param[in] operation  – nazwa operacji,
+ * @param[in] ops        – liczba wykonanych operacji,
+ * @param[in] ns         – czas operacji w nanosekundach.
+ */
+static void record(bench_t *bench, const char *operation, uint64_t ops,
+  uint64_t ns) {
+
+  uint8_t i = 0;
+
+  while (i < bench->count &&
+    strcmp(bench->measures[i].operation, operation) != 0) {
+
+    i++;
+  }
+  if (i == bench->count) {
+    if (bench->count == BENCH_OPERATIONS) {
+      return;
+    }
+    snprintf(bench->measures[i].operation,
+      sizeof (bench->measures[i].operation), "%s", operation);
+    bench->measures[i].ops = 0;
+    bench->measures[i].ns = 0;
+    bench->count++;
+  }
+  bench->measures[i].ops += ops;
+  bench->measures[i].ns += ns;
+}
+
+/** @brief Wykonuje losowe ruchy, których czasu nie mierzymy.
+ * @param[in,out] bench – stan obciążenia,
+ * @param[in] attempts  – liczba prób ruchu.
+ */
+static void fill_board(bench_t *bench, uint64_t attempts) {
+  for (uint64_t i = 0; i < attempts; i++) {
+    gamma_move(bench->game, 1 + random_below(bench, bench->players),
+      random_below(bench, bench->width), random_below(bench, bench->height));
+  }
+}
+
+/** @brief Mierzy losowe ruchy na coraz pełniejszej planszy.
+ * @param[in,out] bench – stan obciążenia.
+ */
+static void run_fill(bench_t *bench) {
+  uint64_t attempts = 2 * bench->scale * bench->width * bench->height;
+  uint64_t begin = now_ns();
+
+  fill_board(bench, attempts);
+  record(bench, "move", attempts, now_ns() - begin);
+}
+
+/** @brief Mierzy te same losowe ruchy wykonywane paczkami.
+ * @param[in,out] bench – stan obciążenia.
+ */
+static void run_batch_fill(bench_t *bench) {
+  uint64_t attempts = 2 * bench->scale * bench->width * bench->height;
+  gamma_move_record_t moves[1024];
+  uint8_t results[sizeof (moves) / sizeof (moves[0]) / 8];
+  uint64_t ns = 0;
+
+  for (uint64_t done = 0; done < attempts; ) {
+    uint64_t count = sizeof (moves) / sizeof (moves[0]);
+
+    if (count > attempts - done) {
+      count = attempts - done;
+    }
+    for (uint64_t i = 0; i < count; i++) {
+      moves[i].kind = GAMMA_MOVE_NORMAL;
+      moves[i].player = 1 + random_below(bench, bench->players);
+      moves[i].x = random_below(bench, bench->width);
+      moves[i].y = random_below(bench, bench->height);
+    }
+
+    uint64_t begin = now_ns();
+    gamma_apply_moves(bench->game, moves, count, results);
+    ns += now_ns() - begin;
+    done += count;
+  }
+  record(bench, "apply_moves", attempts, ns);
+}
+
+/** @brief Mierzy końcówkę gry: zapytania i złote ruchy na pełnej planszy.
+ * Pierwsze zapytanie gracza na nowej planszy liczy odpowiedź od zera
+ * (golden_possible_cold), a kolejne na niezmienionej planszy dostają
+ * zapamiętaną odpowiedź (golden_possible_warm). Na pełnej planszy nie da się
+ * unieważnić odpowiedzi zwykłym ruchem, a złoty ruch gracz ma tylko jeden,
+ * więc zimne zapytania mierzymy na kilku planszach wypełnianych od nowa.
+ * @param[in,out] bench – stan obciążenia.
+ */
+static void run_golden(bench_t *bench) {
+  uint64_t cold_ns = 0;
+  uint64_t warm_ns = 0;
+  uint64_t boards = GOLDEN_BOARDS * bench->scale;
+
+  for (uint64_t board = 0; board < boards; board++) {
+    if (board > 0) {
+      gamma_delete(bench->game);
+      bench->game = gamma_new(bench->width, bench->height, bench->players,
+        bench->areas);
+      if (bench->game == NULL) {
+        return;
+      }
+    }
+    fill_board(bench, 4ULL * bench->width * bench->height);
+
+    uint64_t begin = now_ns();
+    for (uint32_t player = 1; player <= bench->players; player++) {
+      gamma_golden_possible(bench->game, player);
+    }
+    cold_ns += now_ns() - begin;
+
+    begin = now_ns();
+    for (uint32_t i = 0; i < GOLDEN_REPEATS; i++) {
+      for (uint32_t player = 1; player <= bench->players; player++) {
+        gamma_golden_possible(bench->game, player);
+      }
+    }
+    warm_ns += now_ns() - begin;
+  }
+  record(bench, "golden_possible_cold", boards * bench->players, cold_ns);
+  record(bench, "golden_possible_warm",
+    boards * GOLDEN_REPEATS * bench->players, warm_ns);
+
+  uint64_t attempts = 0;
+  uint64_t begin = now_ns();
+  for (uint32_t player = 1; player <= bench->players; player++) {
+    for (uint32_t i = 0; i < 256; i++) {
+      attempts++;
+      if (gamma_golden_move(bench->game, player,
+        random_below(bench, bench->width),
+        random_below(bench, bench->height))) {
+
+        break;
+      }
+    }
+  }
+  record(bench, "golden_move", attempts, now_ns() - begin);
+}
+
+/** @brief Mierzy burzę zapytań q przerywaną pojedynczymi ruchami.
+ * Czas ruchów nie jest doliczany, ale każdy ruch unieważnia zapamiętane
+ * odpowiedzi.
+ * @param[in,out] bench – stan obciążenia.
+ */
+static void run_query(bench_t *bench) {
+  fill_board(bench, (uint64_t)bench->width * bench->height / 2);
+
+  uint64_t rounds = bench->scale * 1024;
+  uint64_t ns = 0;
+  for (uint64_t i = 0; i < rounds; i++) {
+    uint64_t begin = now_ns();
+    for (uint32_t j = 0; j < QUERY_BURST; j++) {
+      gamma_golden_possible(bench->game,
+        1 + random_below(bench, bench->players));
+    }
+    ns += now_ns() - begin;
+    fill_board(bench, 1);
+  }
+  record(bench, "golden_possible", rounds * QUERY_BURST, ns);
+
+  uint64_t begin = now_ns();
+  for (uint64_t i = 0; i < rounds * QUERY_BURST; i++) {
+    gamma_query_golden_possible(bench->game,
+      1 + random_below(bench, bench->players), NULL);
+  }
+  record(bench, "query_golden_possible", rounds * QUERY_BURST,
+    now_ns() - begin);
+}
+
+/** @brief Mierzy wypisywanie planszy polecenia p.
+ * @param[in,out] bench – stan obciążenia.
+ */
+static void run_render(bench_t *bench) {
+  fill_board(bench, (uint64_t)bench->width * bench->height);
+
+  uint64_t renders = bench->scale *
+    (1 + (1 << 22) / ((uint64_t)bench->width * bench->height));
+  uint64_t begin = now_ns();
+  for (uint64_t i = 0; i < renders; i++) {
+    free(gamma_board(bench->game));
+  }
+  record(bench, "board", renders, now_ns() - begin);
+}
+
+/** @brief Mierzy ruchy i tablicę wyników w grze z wieloma graczami.
+ * @param[in,out] bench – stan obciążenia.
+ */
+static void run_many(bench_t *bench) {
+  uint64_t attempts = bench->scale * (1 << 20);
+  uint64_t begin = now_ns();
+  fill_board(bench, attempts);
+  record(bench, "move", attempts, now_ns() - begin);
+
+  gamma_player_stats_t *stats =
+    malloc(bench->players * sizeof (gamma_player_stats_t));
+  if (stats == NULL) {
+    return;
+  }
+  uint64_t calls = bench->scale * 16;
+  begin = now_ns();
+  for (uint64_t i = 0; i < calls; i++) {
+    gamma_player_stats(bench->game, 1, bench->players, true, stats);
+  }
+  record(bench, "player_stats", calls * bench->players, now_ns() - begin);
+  free(stats);
+}
+
+/** @brief Mierzy rzadko zajętą, ogromną planszę.
+ * @param[in,out] bench – stan obciążenia.
+ */
+static void run_huge(bench_t *bench) {
+  uint64_t attempts = bench->scale * (1 << 18);
+  uint64_t begin = now_ns();
+  fill_board(bench, attempts);
+  record(bench, "move", attempts, now_ns() - begin);
+
+  uint64_t queries = bench->scale * (1 << 20);
+  begin = now_ns();
+  for (uint64_t i = 0; i < queries; i++) {
+    gamma_free_fields(bench->game, 1 + i % bench->players);
+  }
+  record(bench, "free_fields", queries, now_ns() - begin);
+
+  queries = bench->scale * 64;
+  begin = now_ns();
+  for (uint64_t i = 0; i < queries; i++) {
+    gamma_golden_possible(bench->game, 1 + i % bench->players);
+    fill_board(bench, 1);
+  }
+  record(bench, "golden_possible", queries, now_ns() - begin);
+}
+
+/**
+ * Obciążenia w kolejności wykonywania.
+ */
+static const workload_t workloads[] = {
+  { "fill", 32, 32, 4, 8, run_fill },
+  { "fill", 256, 256, 4, 64, run_fill },
+  { "fill", 1024, 1024, 8, 256, run_fill },
+  { "batch_fill", 256, 256, 4, 64, run_batch_fill },
+  { "batch_fill", 1024, 1024, 8, 256, run_batch_fill },
+  { "golden", 32, 32, 16, 4, run_golden },
+  { "golden", 256, 256, 64, 16, run_golden },
+  { "query", 32, 32, 8, 4, run_query },
+  { "query", 256, 256, 8, 16, run_query },
+  { "render", 32, 32, 4, 8, run_render },
+  { "render", 256, 256, 16, 64, run_render },
+  { "render", 1024, 1024, 64, 256, run_render },
+  { "many_players", 1000, 1000, 10000, 4, run_many },
+  { "huge_board", 1000000, 1000000, 4, 1000000, run_huge }
+};
+
+/** @brief Wykonuje obciążenie w procesie potomnym.
+ * Zmierzone operacje trafiają do rury @p fd.
+ * @param[in] workload – obciążenie,
+ * @param[in] seed     – ziarno generatora liczb losowych,
+ * @param[in] scale    – mnożnik liczby operacji,
+ * @param[in] fd       – deskryptor do pisania wyników.
+ */
+static void run_child(const workload_t *workload, uint64_t seed,
+  uint64_t scale, int fd) {
+
+  bench_t bench = {
+    .width = workload->width,
+    .height = workload->height,
+    .players = workload->players,
+    .areas = workload->areas,
+    .random = seed | 1,
+    .scale = scale
+  };
+
+  bench.game = gamma_new(workload->width, workload->height,
+    workload->players, workload->areas);
+  if (bench.game == NULL) {
+    _exit(1);
+  }
+  workload->run(&bench);
+  gamma_delete(bench.game);
+
+  if (write(fd, bench.measures, bench.count * sizeof (measure_t)) < 0) {
+    _exit(1);
+  }
+  _exit(0);
+}
+
+/** @brief Wypisuje wynik jednej operacji.
+ * Szczytowe zużycie pamięci dotyczy całego obciążenia, więc w tabeli
+ * wypisujemy je tylko przy jego pierwszej operacji, a w JSON raz przy
+ * obciążeniu, a nie przy operacji.
+ * @param[in] workload – obciążenie,
+ * @param[in] measure  – zmierzona operacja,
+ * @param[in] rss      – szczytowe zużycie pamięci obciążenia w KiB,
+ * @param[in] json     – czy wypisać obiekt JSON,
+ * @param[in] first    – czy to pierwsza operacja obciążenia.
+ */
+static void print_measure(const workload_t *workload, const measure_t *measure,
+  long rss, bool json, bool first) {
+
+  double ns_per_op = measure->ops == 0 ? 0 :
+    (double)measure->ns / measure->ops;
+  double ops_per_s = measure->ns == 0 ? 0 :
+    measure->ops * 1e9 / measure->ns;
+
+  if (json) {
+    printf("%s\n        {\"operation\": \"%s\", \"ops\": %" PRIu64
+      ", \"ns_per_op\": %.1f, \"ops_per_s\": %.0f}", first ? "" : ",",
+      measure->operation, measure->ops, ns_per_op, ops_per_s);
+  }
+  else if (first) {
+    printf("%-13s %9" PRIu32 "x%-9" PRIu32 " %-22s %12" PRIu64
+      " %12.1f %14.0f %10ld\n", workload->name, workload->width,
+      workload->height, measure->operation, measure->ops, ns_per_op,
+      ops_per_s, rss);
+  }
+  else {
+    printf("%-13s %9" PRIu32 "x%-9" PRIu32 " %-22s %12" PRIu64
+      " %12.1f %14.0f\n", workload->name, workload->width,
+      workload->height, measure->operation, measure->ops, ns_per_op,
+      ops_per_s);
+  }
+}
+
+/** @brief Wykonuje obciążenie w osobnym procesie i wypisuje jego wyniki.
+ * @param[in] workload – obciążenie,
+ * @param[in] seed     – ziarno generatora liczb losowych,
+ * @param[in] scale    – mnożnik liczby operacji,
+ * @param[in] json     – czy wypisać wyniki w formacie JSON,
+ * @param[in,out] first – czy nie wypisano jeszcze żadnego obciążenia w JSON.
+ * @return Wartość @p true, jeśli obciążenie się powiodło.
+ */
+static bool run_workload(const workload_t *workload, uint64_t seed,
+  uint64_t scale, bool json, bool *first) {
+
+  measure_t measures[BENCH_OPERATIONS];
+  int fds[2];
+
+  if (pipe(fds) != 0) {
+    return false;
+  }
+  fflush(stdout);
+
+  pid_t pid = fork();
+  if (pid < 0) {
+    close(fds[0]);
+    close(fds[1]);
+    return false;
+  }
+  if (pid == 0) {
+    close(fds[0]);
+    run_child(workload, seed, scale, fds[1]);
+  }
+  close(fds[1]);
+
+  size_t size = 0;
+  ssize_t bytes;
+  while (size < sizeof (measures) && (bytes = read(fds[0],
+    (char*)measures + size, sizeof (measures) - size)) > 0) {
+
+    size += bytes;
+  }
+  close(fds[0]);
+
+  int status;
+  struct rusage usage;
+  if (wait4(pid, &status, 0, &usage) != pid ||
+    !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+
+    return false;
+  }
+
+  if (json) {
+    printf("%s\n    {\"workload\": \"%s\", \"width\": %" PRIu32
+      ", \"height\": %" PRIu32 ", \"players\": %" PRIu32
+      ", \"peak_rss_kib\": %ld,\n      \"operations\": [",
+      *first ? "" : ",", workload->name, workload->width, workload->height,
+      workload->players, usage.ru_maxrss);
+  }
+  *first = false;
+  for (size_t i = 0; i < size / sizeof (measure_t); i++) {
+    print_measure(workload, &measures[i], usage.ru_maxrss, json, i == 0);
+  }
+  if (json) {
+    printf("\n      ]}");
+  }
+  return true;
+}
+
+/** @brief Mierzy wydajność silnika gry gamma.
+ * Opcje:
+ * -s ziarno  ziarno generatora obciążeń, domyślnie 1,
+ * -n mnożnik mnożnik liczby operacji, domyślnie 1,
+ * -w nazwa   wykonuje tylko obciążenia o tej nazwie,
+ * -j         wypisuje wyniki w formacie JSON.
+ * @param[in] argc    – liczba argumentów programu,
+ * @param[in] argv    – argumenty programu.
+ * @return Zero, gdy wszystkie obciążenia się powiodły, a 1 w przeciwnym
+ * przypadku.
+ */
+int main(int argc, char *argv[]) {
+  uint64_t seed = 1;
+  uint64_t scale = 1;
+  const char *only = NULL;
+  bool json = false;
+  int option;
+
+  while ((option = getopt(argc, argv, "s:n:w:j")) != -1) {
+    if (option == 's') {
+      seed = strtoull(optarg, NULL, 10);
+    }
+    else if (option == 'n') {
+      scale = strtoull(optarg, NULL, 10);
+    }
+    else if (option == 'w') {
+      only = optarg;
+    }
+    else if (option == 'j') {
+      json = true;
+    }
+    else {
+      fprintf(stderr, "USAGE: %s [-s SEED] [-n SCALE] [-w WORKLOAD] [-j]\n",
+        argv[0]);
+      return 1;
+    }
+  }
+  if (scale == 0) {
+    scale = 1;
+  }
+
+  if (json) {
+    printf("{\n  \"seed\": %" PRIu64 ",\n  \"scale\": %" PRIu64
+      ",\n  \"results\": [", seed, scale);
+  }
+  else {
+    printf("%-13s %19s %-22s %12s %12s %14s %10s\n", "workload", "board",
+      "operation", "ops", "ns/op", "ops/s", "rss_kib");
+  }
+
+  bool first = true;
+  int result = 0;
+  for (size_t i = 0; i < sizeof (workloads) / sizeof (workloads[0]); i++) {
+    if (only == NULL || strcmp(only, workloads[i].name) == 0) {
+      if (!run_workload(&workloads[i], seed, scale, json, &first)) {
+        fprintf(stderr, "ERROR %s %" PRIu32 "x%" PRIu32 "\n",
+          workloads[i].name, workloads[i].width, workloads[i].height);
+        result = 1;
+      }
+    }
+  }
+
+  if (json) {
+    printf("\n  ]\n}\n");
+  }
+  return result;
+}
@@ -5,314 +5,2245 @@
  * @date 11.05.2020
  */
 
+#define _GNU_SOURCE
 #include <stdlib.h>
 #include <stdio.h>
 #include <stdint.h>
+#include <inttypes.h>
 #include <string.h>
 #include <errno.h>
 #include <termios.h>
+#include <time.h>
 #include <unistd.h>
+#include <getopt.h>
 #include <ctype.h>
+#include <poll.h>
+#include <signal.h>
 #include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
 #include "gamma.h"
 
+/**
+ * Rozmiar bloku wczytywanego jednym wywołaniem read().
+ */
+#define INPUT_BLOCK_SIZE (1 << 17)
+
+/**
+ * Wynik input_line, gdy zabrakło pamięci na linijkę.
+ */
+#define INPUT_NO_MEMORY (-2)
+
+/** @struct input
+ * Wejście gry: plik zmapowany do pamięci albo bufor wejścia wczytywanego
+ * blokami.
+ */
+typedef struct input {
+  int fd; ///< Deskryptor, z którego wczytujemy bloki.
+  const char *mapped; ///< Zmapowany plik wejścia albo NULL.
+  uint64_t mapped_size; ///< Liczba znaków zmapowanego pliku.
+  uint64_t position; ///< Pierwszy nieprzeczytany znak zmapowanego pliku.
+  char block[INPUT_BLOCK_SIZE]; ///< Ostatni wczytany blok.
+  size_t begin; ///< Pierwszy nieprzeczytany znak bloku.
+  size_t end; ///< Pozycja tuż za ostatnim wczytanym znakiem bloku.
+  char *line; /**< Bufor na linijki, które nie mieszczą się w jednym bloku,
+  * używany ponownie dla kolejnych linijek. */
+  uint64_t line_capacity; ///< Liczba znaków, na które jest miejsce w line.
+} input_t;
+
+/**
+ * Wejście programu, z którego czytają wszystkie tryby gry.
+ */
+static input_t input = { .fd = STDIN_FILENO };
+
+/** @brief Otwiera plik jako wejście gry.
+ * Zwykły plik jest mapowany do pamięci i linijki są czytane prosto
+ * z mapowania; potoki i pliki, których nie da się zmapować, są czytane
+ * blokami.
+ * @param[in,out] in  – wejście,
+ * @param[in] path    – ścieżka do pliku.
+ * @return Wartość @p true, jeśli udało się otworzyć plik, a @p false
+ * w przeciwnym przypadku.
+ */
+static bool input_open(input_t *in, const char *path) {
+  int fd = open(path, O_RDONLY);
+  struct stat info;
+
+  if (fd < 0) {
+    return false;
+  }
+  in->fd = fd;
+
+  if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0 &&
+    (uint64_t)info.st_size <= SIZE_MAX) {
+
+    void *mapped = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+    if (mapped != MAP_FAILED) {
+      madvise(mapped, info.st_size, MADV_SEQUENTIAL);
+      in->mapped = mapped;
+      in->mapped_size = info.st_size;
+    }
+  }
+  return true;
+}
+
+/** @brief Zwalnia zasoby wejścia.
+ * @param[in,out] in  – wejście.
+ */
+static void input_close(input_t *in) {
+  if (in->mapped != NULL) {
+    munmap((void*)in->mapped, in->mapped_size);
+    in->mapped = NULL;
+  }
+  if (in->fd != STDIN_FILENO) {
+    close(in->fd);
+    in->fd = STDIN_FILENO;
+  }
+  free(in->line);
+  in->line = NULL;
+  in->line_capacity = 0;
+}
+
+/** @brief Wczytuje kolejny blok wejścia.
+ * @param[in,out] in  – bufor wejścia.
+ * @return Wartość @p true, jeśli wczytano choć jeden znak, a @p false
+ * na końcu wejścia lub po błędzie odczytu.
+ */
+static bool input_fill(input_t *in) {
+  ssize_t size;
+
+  do {
+    size = read(in->fd, in->block, INPUT_BLOCK_SIZE);
+  } while (size < 0 && errno == EINTR);
+
+  in->begin = 0;
+  in->end = 0;
+  if (size <= 0) {
+    return false;
+  }
+  in->end = size;
+  return true;
+}
+
+/** @brief Wczytuje jeden znak wejścia.
+ * @param[in,out] in  – bufor wejścia.
+ * @return Wczytany znak albo EOF na końcu wejścia.
+ */
+static int input_getc(input_t *in) {
+  if (in->mapped != NULL) {
+    if (in->position == in->mapped_size) {
+      return EOF;
+    }
+    return (unsigned char)in->mapped[in->position++];
+  }
+  if (in->begin == in->end && !input_fill(in)) {
+    return EOF;
+  }
+  return (unsigned char)in->block[in->begin++];
+}
+
+/** @brief Czeka, aż input_getc będzie mógł zwrócić znak bez czekania.
+ * Na czas czekania ustawia maskę sygnałów @p mask, więc zablokowany poza
+ * nim sygnał może je przerwać.
+ * @param[in,out] in  – bufor wejścia,
+ * @param[in] mask    – maska sygnałów na czas czekania.
+ * @return Wartość @p false, jeśli czekanie przerwał sygnał, a @p true
+ * w przeciwnym przypadku, także na końcu wejścia lub po błędzie.
+ */
+static bool input_wait(input_t *in, const sigset_t *mask) {
+  if (in->mapped != NULL || in->begin != in->end) {
+    return true;
+  }
+  struct pollfd descriptor = { .fd = in->fd, .events = POLLIN };
+
+  return ppoll(&descriptor, 1, NULL, mask) >= 0 || errno != EINTR;
+}
+
+/** @brief Dopisuje znaki na koniec linijki w buforze na linijki.
+ * @param[in,out] in  – bufor wejścia,
+ * @param[in] length  – liczba znaków już zapisanych w buforze na linijki,
+ * @param[in] chars   – dopisywane znaki,
+ * @param[in] size    – liczba dopisywanych znaków.
+ * @return Wartość @p true, jeśli udało się zaalokować pamięć, a @p false
+ * w przeciwnym przypadku.
+ */
+static bool input_append(input_t *in, uint64_t length, const char *chars,
+  size_t size) {
+
+  // zostawiamy miejsce na '\0'
+  if (length + size + 1 > in->line_capacity) {
+    uint64_t capacity = in->line_capacity;
+    if (capacity == 0) {
+      capacity = INPUT_BLOCK_SIZE;
+    }
+    while (length + size + 1 > capacity) {
+      capacity = 2 * capacity;
+    }
+
+    char *line = realloc(in->line, capacity * sizeof (char));
+    if (!line) {
+      return false;
+    }
+    in->line = line;
+    in->line_capacity = capacity;
+  }
+
+  memcpy(in->line + length, chars, size);
+  in->line[length + size] = '\0';
+  return true;
+}
+
+/** @brief Wczytuje kolejną linijkę wejścia bez znaku końca linii.
+ * Linijka zmapowanego pliku lub mieszcząca się w bloku nie jest kopiowana,
+ * pozostałe trafiają do bufora na linijki, więc wczytywanie linijek niczego
+ * nie alokuje poza powiększaniem tego bufora. Linijka jest ważna do
+ * następnego wczytania.
+ * @param[in,out] in      – bufor wejścia,
+ * @param[out] line       – wczytana linijka, nie musi kończyć się '\0',
+ * @param[out] length     – liczba znaków linijki.
+ * @return '\n', jeśli linijka kończy się znakiem końca linii, EOF, jeśli
+ * kończy ją koniec wejścia, a INPUT_NO_MEMORY, gdy zabrakło pamięci.
+ */
+static int input_line(input_t *in, const char **line, uint64_t *length) {
+  uint64_t copied = 0;
+
+  if (in->mapped != NULL) {
+    const char *start = in->mapped + in->position;
+    uint64_t available = in->mapped_size - in->position;
+    const char *newline = memchr(start, '\n', available);
+
+    *line = start;
+    if (newline == NULL) {
+      *length = available;
+      in->position = in->mapped_size;
+      return EOF;
+    }
+    *length = newline - start;
+    in->position += *length + 1;
+    return '\n';
+  }
+
+  while (true) {
+    if (in->begin == in->end && !input_fill(in)) {
+      if (!input_append(in, copied, "", 0)) {
+        return INPUT_NO_MEMORY;
+      }
+      *line = in->line;
+      *length = copied;
+      return EOF;
+    }
+
+    char *start = in->block + in->begin;
+    size_t available = in->end - in->begin;
+    char *newline = memchr(start, '\n', available);
+
+    if (newline != NULL) {
+      size_t size = newline - start;
+      in->begin += size + 1;
+
+      if (copied == 0) {
+        *newline = '\0';
+        *line = start;
+      }
+      else {
+        if (!input_append(in, copied, start, size)) {
+          return INPUT_NO_MEMORY;
+        }
+        *line = in->line;
+      }
+      *length = copied + size;
+      return '\n';
+    }
+
+    if (!input_append(in, copied, start, available)) {
+      return INPUT_NO_MEMORY;
+    }
+    copied += available;
+    in->begin = in->end;
+  }
+}
+
+/**
+ * Początek nagłówka binarnego skryptu. Po nim następują szerokość,
+ * wysokość, liczba graczy i liczba obszarów, każda jako 4 bajty
+ * little-endian, jak w poleceniu B.
+ */
+#define BINARY_MAGIC "GMB1"
+
+/**
+ * Liczba bajtów nagłówka binarnego skryptu.
+ */
+#define BINARY_HEADER_SIZE 20
+
+/**
+ * Liczba bajtów rekordu binarnego skryptu: litera polecenia, 3 bajty
+ * wypełnienia i trzy argumenty po 4 bajty little-endian. Polecenia
+ * z mniejszą liczbą argumentów ignorują pozostałe.
+ */
+#define BINARY_RECORD_SIZE 16
+
+/**
+ * Wynik rekordu z nieznaną literą polecenia albo nieudanego wypisania
+ * planszy.
+ */
+#define BINARY_ERROR 0xFF
+
+/** @brief Odczytuje liczbę zapisaną na 4 bajtach little-endian.
+ * @param[in] bytes   – bajty liczby.
+ * @return Odczytana liczba.
+ */
+static uint32_t load_u32(const unsigned char *bytes) {
+  return (uint32_t)bytes[0] | (uint32_t)bytes[1] << 8 |
+    (uint32_t)bytes[2] << 16 | (uint32_t)bytes[3] << 24;
+}
+
+/** @brief Zapisuje liczbę na bajtach little-endian.
+ * @param[out] bytes  – miejsce na bajty liczby,
+ * @param[in] number  – zapisywana liczba,
+ * @param[in] size    – liczba bajtów.
+ */
+static void store_le(unsigned char *bytes, uint64_t number, uint8_t size) {
+  for (uint8_t i = 0; i < size; i++) {
+    bytes[i] = number >> (8 * i);
+  }
+}
+
+/** @brief Wczytuje kolejne bajty wejścia.
+ * @param[in,out] in  – wejście,
+ * @param[out] bytes  – miejsce na wczytane bajty,
+ * @param[in] size    – liczba bajtów do wczytania.
+ * @return Liczba wczytanych bajtów, mniejsza od @p size tylko na końcu
+ * wejścia.
+ */
+static size_t input_bytes(input_t *in, unsigned char *bytes, size_t size) {
+  size_t copied = 0;
+
+  while (copied < size) {
+    size_t chunk = size - copied;
+
+    if (in->mapped != NULL) {
+      if (in->position == in->mapped_size) {
+        break;
+      }
+      if (chunk > in->mapped_size - in->position) {
+        chunk = in->mapped_size - in->position;
+      }
+      memcpy(bytes + copied, in->mapped + in->position, chunk);
+      in->position += chunk;
+    }
+    else {
+      if (in->begin == in->end && !input_fill(in)) {
+        break;
+      }
+      if (chunk > in->end - in->begin) {
+        chunk = in->end - in->begin;
+      }
+      memcpy(bytes + copied, in->block + in->begin, chunk);
+      in->begin += chunk;
+    }
+    copied += chunk;
+  }
+  return copied;
+}
+
+#ifndef GAMMA_OUTPUT_THRESHOLD
+/**
+ * Liczba znaków wyjścia gromadzonych przed zapisaniem ich jednym write().
+ */
+#define GAMMA_OUTPUT_THRESHOLD (1 << 16)
+#endif
+
+/** @struct output
+ * Bufor wyjścia trybu wsadowego wspólny dla standardowego wyjścia
+ * i standardowego wyjścia błędów.
+ */
+typedef struct output {
+  char block[GAMMA_OUTPUT_THRESHOLD]; ///< Zgromadzone znaki.
+  size_t length; ///< Liczba zgromadzonych znaków.
+  int fd; ///< Deskryptor, do którego trafią zgromadzone znaki.
+  bool deferred; /**< Czy zamiast zapisywać znaki, odkładamy je w memory
+  * do późniejszego wypisania. */
+  char *memory; /**< Odłożone fragmenty: bajt deskryptora, 8 bajtów
+  * długości i znaki fragmentu. */
+  size_t memory_length; ///< Liczba zajętych bajtów memory.
+  size_t memory_capacity; ///< Liczba bajtów, na które jest miejsce w memory.
+} output_t;
+
+/**
+ * Wyjście programu, do którego piszą tryb wsadowy i wybór trybu gry.
+ */
+static output_t output = { .fd = STDOUT_FILENO };
+
+/** @brief Zapisuje wszystkie znaki do deskryptora.
+ * @param[in] fd      – deskryptor pliku,
+ * @param[in] chars   – zapisywane znaki,
+ * @param[in] size    – liczba zapisywanych znaków.
+ */
+static void write_all(int fd, const char *chars, size_t size) {
+  while (size > 0) {
+    ssize_t written = write(fd, chars, size);
+
+    if (written < 0) {
+      if (errno != EINTR) {
+        return;
+      }
+    }
+    else {
+      chars += written;
+      size -= written;
+    }
+  }
+}
+
+/** @brief Zapisuje znaki do deskryptora albo odkłada je na później.
+ * @param[in,out] out – bufor wyjścia,
+ * @param[in] fd      – deskryptor, do którego mają trafić znaki,
+ * @param[in] chars   – zapisywane znaki,
+ * @param[in] size    – liczba zapisywanych znaków.
+ */
+static void output_write(output_t *out, int fd, const char *chars,
+  size_t size) {
+
+  if (!out->deferred) {
+    write_all(fd, chars, size);
+  }
+  else if (size > 0) {
+    size_t needed = out->memory_length + 1 + sizeof (uint64_t) + size;
+
+    if (needed > out->memory_capacity) {
+      size_t capacity = 2 * out->memory_capacity;
+      if (capacity < needed) {
+        capacity = needed;
+      }
+
+      char *memory = realloc(out->memory, capacity);
+      if (!memory) {
+        exit(1);
+      }
+      out->memory = memory;
+      out->memory_capacity = capacity;
+    }
+
+    uint64_t length = size;
+    out->memory[out->memory_length] = fd;
+    memcpy(out->memory + out->memory_length + 1, &length, sizeof (uint64_t));
+    memcpy(out->memory + out->memory_length + 1 + sizeof (uint64_t), chars,
+      size);
+    out->memory_length = needed;
+  }
+}
+
+/** @brief Zapisuje zgromadzone znaki.
+ * @param[in,out] out – bufor wyjścia.
+ */
+static void output_flush(output_t *out) {
+  output_write(out, out->fd, out->block, out->length);
+  out->length = 0;
+}
+
+/** @brief Zapisuje zgromadzone znaki wyjścia programu.
+ * Wywoływana przy zakończeniu programu.
+ */
+static void output_flush_at_exit(void) {
+  output_flush(&output);
+}
+
+/** @brief Dopisuje znaki do wyjścia.
+ * Przed zmianą deskryptora zapisuje znaki zgromadzone dla poprzedniego,
+ * więc komunikaty na wyjściu i wyjściu błędów pojawiają się w kolejności
+ * wywołań.
+ * @param[in,out] out – bufor wyjścia,
+ * @param[in] fd      – deskryptor, do którego mają trafić znaki,
+ * @param[in] chars   – dopisywane znaki,
+ * @param[in] size    – liczba dopisywanych znaków.
+ */
+static void output_chars(output_t *out, int fd, const char *chars,
+  size_t size) {
+
+  if (fd != out->fd || out->length + size > GAMMA_OUTPUT_THRESHOLD) {
+    output_flush(out);
+    out->fd = fd;
+  }
+
+  if (size > GAMMA_OUTPUT_THRESHOLD) {
+    output_write(out, fd, chars, size);
+  }
+  else {
+    memcpy(out->block + out->length, chars, size);
+    out->length += size;
+  }
+}
+
+/** @brief Dopisuje do wyjścia liczbę i znak końca linii.
+ * @param[in,out] out – bufor wyjścia,
+ * @param[in] fd      – deskryptor, do którego ma trafić liczba,
+ * @param[in] number  – dopisywana liczba.
+ */
+static void output_number(output_t *out, int fd, uint64_t number) {
+  char digits[21];
+  uint8_t begin = sizeof (digits) - 1;
+
+  digits[begin] = '\n';
+  do {
+    begin--;
+    digits[begin] = '0' + number % 10;
+    number = number / 10;
+  } while (number != 0);
+
+  output_chars(out, fd, digits + begin, sizeof (digits) - begin);
+}
+
+/** @brief Dopisuje do wyjścia wynik ruchu lub zapytania: 1 albo 0.
+ * @param[in,out] out – bufor wyjścia,
+ * @param[in] result  – wynik.
+ */
+static void output_result(output_t *out, bool result) {
+  if (result) {
+    output_chars(out, STDOUT_FILENO, "1\n", 2);
+  }
+  else {
+    output_chars(out, STDOUT_FILENO, "0\n", 2);
+  }
+}
+
+/** @brief Dopisuje do wyjścia błędów komunikat o błędnej linijce.
+ * @param[in,out] out      – bufor wyjścia,
+ * @param[in] line_number  – numer linijki.
+ */
+static void output_error(output_t *out, unsigned long long int line_number) {
+  output_chars(out, STDERR_FILENO, "ERROR ", 6);
+  output_number(out, STDERR_FILENO, line_number);
+}
+
+/**
+ * Litery poleceń trybu wsadowego wykonywanych po poleceniu B.
+ */
+#define BATCH_COMMANDS "mgbfqpsc"
+
+/** @struct command
+ * Polecenie wczytane z jednej linijki wejścia.
+ */
+typedef struct command {
+  char letter; ///< Litera polecenia.
+  uint32_t numbers[4]; ///< Argumenty polecenia.
+  uint8_t count; ///< Liczba argumentów polecenia.
+} command_t;
+
+/** @brief Sprawdza, czy znak oddziela słowa polecenia.
+ * @param[in] c       – sprawdzany znak.
+ * @return Wartość @p true dla spacji, '\t', '\v', '\f' i '\r',
+ * a @p false w przeciwnym przypadku.
+ */
+static inline bool is_separator(char c) {
+  return c == ' ' || c == '\t' || c == '\v' || c == '\f' || c == '\r';
+}
+
+/** @brief Zwraca liczbę argumentów polecenia.
+ * @param[in] letter  – litera polecenia.
+ * @return Liczba argumentów, jakiej wymaga polecenie.
+ */
+static uint8_t command_arguments(char letter) {
+  switch (letter) {
+    case 'p':
+    case 's':
+    case 'c':
+      return 0;
+    case 'b':
+    case 'f':
+    case 'q':
+      return 1;
+    case 'm':
+    case 'g':
+      return 3;
+    default:
+      return 4;
+  }
+}
+
+/** @brief Rozbiera linijkę na polecenie w jednym przejściu.
+ * Polecenie to jedna litera, a po niej, oddzielone białymi znakami,
+ * argumenty będące liczbami bez znaku mieszczącymi się w uint32_t.
+ * @param[in] line      – linijka bez znaku końca linii,
+ * @param[in] length    – liczba znaków linijki, która może zawierać '\0',
+ * @param[in] letters   – litery dopuszczalnych poleceń,
+ * @param[out] command  – wczytane polecenie.
+ * @return Wartość @p true, jeśli linijka jest poprawnym poleceniem,
+ * a @p false w przeciwnym przypadku.
+ */
+static bool parse_command(const char *line, uint64_t length,
+  const char *letters, command_t *command) {
+
+  if (line[0] == '\0' || strchr(letters, line[0]) == NULL) {
+    return false;
+  }
+  command->letter = line[0];
+  command->count = 0;
+
+  uint64_t i = 1;
+  while (true) {
+    // słowa muszą być oddzielone białymi znakami
+    if (i < length && !is_separator(line[i])) {
+      return false;
+    }
+    while (i < length && is_separator(line[i])) {
+      i++;
+    }
+    if (i == length) {
+      break;
+    }
+    if (command->count == 4 || line[i] < '0' || line[i] > '9') {
+      return false;
+    }
+
+    uint64_t number = 0;
+    while (i < length && line[i] >= '0' && line[i] <= '9') {
+      number = 10 * number + (line[i] - '0');
+      if (number > UINT32_MAX) {
+        return false;
+      }
+      i++;
+    }
+    command->numbers[command->count] = number;
+    command->count++;
+  }
+
+  return command->count == command_arguments(command->letter);
+}
+
+/** @struct result
+ * Wynik polecenia trybu wsadowego przed wypisaniem.
+ */
+typedef struct result {
+  char letter; ///< Litera polecenia, 0 dla błędnej linijki.
+  uint64_t value; ///< Wynik polecenia b, f, m, g lub q.
+  char *board; ///< Napis planszy dla p lub liczników dla c albo NULL.
+  gamma_player_stats_t *stats; ///< Statystyki graczy dla polecenia s albo NULL.
+} result_t;
+
+/**
+ * Nazwy funkcji interfejsu w kolejności @ref gamma_stats_call_t.
+ */
+static const char *stats_call_names[GAMMA_CALLS] = {
+  "gamma_move", "gamma_golden_move", "gamma_apply_moves",
+  "gamma_busy_fields", "gamma_free_fields", "gamma_golden_possible",
+  "gamma_query_golden_possible", "gamma_player_stats", "gamma_board"
+};
+
+/** @brief Daje napis z licznikami wewnętrznymi silnika.
+ * Każdy licznik to linijka "nazwa wartość", a dla funkcji interfejsu
+ * "call nazwa wywołania nanosekundy".
+ * @param[in] game     – wskaźnik na strukturę przechowującą stan gry.
+ * @return Wskaźnik na zaalokowany napis lub NULL, gdy silnik zbudowano bez
+ * liczników albo nie udało się zaalokować pamięci.
+ */
+static char* stats_dump(gamma_t *game) {
+  gamma_stats_t stats;
+
+  if (!gamma_stats(game, &stats)) {
+    return NULL;
+  }
+
+  size_t capacity = 128 * (GAMMA_CALLS + GAMMA_STATS_FIND_DEPTHS + 8);
+  char *dump = malloc(capacity);
+  if (dump == NULL) {
+    return NULL;
+  }
+
+  size_t length = 0;
+  for (uint32_t i = 0; i < GAMMA_CALLS; i++) {
+    length += sprintf(dump + length, "call %s %" PRIu64 " %" PRIu64 "\n",
+      stats_call_names[i], stats.calls[i], stats.ns[i]);
+  }
+  for (uint32_t i = 0; i < GAMMA_STATS_FIND_DEPTHS; i++) {
+    length += sprintf(dump + length, "find_depth %" PRIu32 " %" PRIu64 "\n",
+      i, stats.find_depth[i]);
+  }
+  sprintf(dump + length, "unions %" PRIu64 "\n"
+    "split_rebuilds %" PRIu64 "\n" "split_rebuild_cells %" PRIu64 "\n"
+    "golden_scans %" PRIu64 "\n" "golden_scan_cells %" PRIu64 "\n",
+    stats.unions, stats.split_rebuilds, stats.split_rebuild_cells,
+    stats.golden_scans, stats.golden_scan_cells);
+  return dump;
+}
+
+/** @brief Wykonuje polecenie trybu wsadowego.
+ * @param[in,out] game – wskaźnik na strukturę przechowującą stan gry,
+ * @param[in] command  – polecenie, litera 0 oznacza błędną linijkę,
+ * @param[out] result  – wynik polecenia.
+ */
+static void run_command(gamma_t *game, const command_t *command,
+  result_t *result) {
+
+  result->letter = command->letter;
+  result->board = NULL;
+  result->stats = NULL;
+
+  switch (command->letter) {
+    case 'p':
+      result->board = gamma_board(game);
+      if (result->board == NULL) {
+        result->letter = 0;
+      }
+      break;
+    case 'c':
+      // silnik bez liczników zgłasza polecenie jako błędne
+      result->board = stats_dump(game);
+      if (result->board == NULL) {
+        result->letter = 0;
+      }
+      break;
+    case 's':
+      result->value = return_players(game);
+      result->stats = malloc(result->value * sizeof (gamma_player_stats_t));
+      if (result->stats == NULL) {
+        result->letter = 0;
+      }
+      else {
+        gamma_player_stats(game, 1, result->value, true, result->stats);
+      }
+      break;
+    case 'b':
+      result->value = gamma_busy_fields(game, command->numbers[0]);
+      break;
+    case 'f':
+      result->value = gamma_free_fields(game, command->numbers[0]);
+      break;
+    case 'q':
+      result->value = gamma_golden_possible(game, command->numbers[0]);
+      break;
+    case 'm':
+      result->value = gamma_move(game, command->numbers[0],
+        command->numbers[1], command->numbers[2]);
+      break;
+    case 'g':
+      result->value = gamma_golden_move(game, command->numbers[0],
+        command->numbers[1], command->numbers[2]);
+      break;
+    default:
+      result->letter = 0;
+      break;
+  }
+}
+
+/** @brief Wypisuje wynik polecenia trybu wsadowego i zwalnia go.
+ * W formacie tekstowym wyniki to linijki z liczbami, a w binarnym:
+ * 1 bajt 0 albo 1 dla m, g i q, 8 bajtów little-endian dla b i f,
+ * dla p i c 8 bajtów długości napisu i napis, dla s 8 bajtów liczby
+ * graczy i dla każdego gracza 8 bajtów zajętych pól, 8 bajtów wolnych pól,
+ * 4 bajty obszarów i bajt 0 albo 1 złotego ruchu, a dla błędnego
+ * polecenia bajt BINARY_ERROR. Wynik s w formacie tekstowym to linijka
+ * "numer zajęte wolne obszary złoty" dla każdego gracza.
+ * @param[in,out] out      – bufor wyjścia,
+ * @param[in,out] result   – wynik polecenia,
+ * @param[in] binary       – czy wynik wypisać w formacie binarnym,
+ * @param[in] line_number  – numer linijki lub rekordu polecenia.
+ */
+static void emit_result(output_t *out, result_t *result, bool binary,
+  unsigned long long int line_number) {
+
+  unsigned char bytes[8];
+
+  switch (result->letter) {
+    case 0:
+      if (binary) {
+        bytes[0] = BINARY_ERROR;
+        output_chars(out, STDOUT_FILENO, (char*)bytes, 1);
+      }
+      else {
+        output_error(out, line_number);
+      }
+      break;
+    case 'p':
+    case 'c': {
+      size_t length = strlen(result->board);
+
+      if (binary) {
+        store_le(bytes, length, 8);
+        output_chars(out, STDOUT_FILENO, (char*)bytes, 8);
+        output_chars(out, STDOUT_FILENO, result->board, length);
+      }
+      else {
+        // plansza trafia na wyjście za wcześniejszymi wynikami
+        output_flush(out);
+        output_write(out, STDOUT_FILENO, result->board, length);
+      }
+      free(result->board);
+      result->board = NULL;
+      break;
+    }
+    case 's': {
+      char line[80];
+
+      if (binary) {
+        store_le(bytes, result->value, 8);
+        output_chars(out, STDOUT_FILENO, (char*)bytes, 8);
+      }
+      for (uint32_t i = 0; i < result->value; i++) {
+        const gamma_player_stats_t *stats = &result->stats[i];
+
+        if (binary) {
+          store_le((unsigned char*)line, stats->busy_fields, 8);
+          store_le((unsigned char*)line + 8, stats->free_fields, 8);
+          store_le((unsigned char*)line + 16, stats->areas, 4);
+          line[20] = stats->golden_possible;
+          output_chars(out, STDOUT_FILENO, line, 21);
+        }
+        else {
+          int size = sprintf(line, "%" PRIu32 " %" PRIu64 " %" PRIu64
+            " %" PRIu32 " %d\n", i + 1, stats->busy_fields,
+            stats->free_fields, stats->areas, stats->golden_possible);
+          output_chars(out, STDOUT_FILENO, line, size);
+        }
+      }
+      free(result->stats);
+      result->stats = NULL;
+      break;
+    }
+    case 'b':
+    case 'f':
+      if (binary) {
+        store_le(bytes, result->value, 8);
+        output_chars(out, STDOUT_FILENO, (char*)bytes, 8);
+      }
+      else {
+        output_number(out, STDOUT_FILENO, result->value);
+      }
+      break;
+    default:
+      if (binary) {
+        bytes[0] = result->value;
+        output_chars(out, STDOUT_FILENO, (char*)bytes, 1);
+      }
+      else {
+        output_result(out, result->value);
+      }
+      break;
+  }
+}
+
+/**
+ * Logarytm liczby przedziałów histogramu czasów na jedną potęgę dwójki.
+ */
+#define PROFILE_SUB_BITS 3
+
+/**
+ * Liczba przedziałów histogramu czasów jednego polecenia.
+ */
+#define PROFILE_BUCKETS (64 << PROFILE_SUB_BITS)
+
+/**
+ * Liczba najwolniejszych wywołań zapamiętywanych dla każdego polecenia.
+ */
+#define PROFILE_WORST 5
+
+/**
+ * Liczba rodzajów poleceń trybu wsadowego.
+ */
+#define PROFILE_COMMANDS (sizeof (BATCH_COMMANDS) - 1)
+
+/** @struct profile_worst
+ * Jedno z najwolniejszych wywołań polecenia.
+ */
+typedef struct profile_worst {
+  uint64_t ns; ///< Czas wykonania w nanosekundach.
+  unsigned long long int line_number; ///< Numer linijki polecenia.
+} profile_worst_t;
+
+/** @struct command_profile
+ * Czasy wykonania poleceń jednego rodzaju.
+ */
+typedef struct command_profile {
+  uint64_t count; ///< Liczba wykonanych poleceń.
+  uint64_t total_ns; ///< Łączny czas wykonania.
+  uint64_t max_ns; ///< Najdłuższy czas wykonania.
+  uint64_t buckets[PROFILE_BUCKETS]; /**< Histogram czasów: przedział
+  * każdej potęgi dwójki jest podzielony na 2^PROFILE_SUB_BITS części. */
+  profile_worst_t worst[PROFILE_WORST]; ///< Najwolniejsze, od najdłuższego.
+} command_profile_t;
+
+/** @struct profile
+ * Czasy wykonania poleceń wszystkich rodzajów, w kolejności BATCH_COMMANDS.
+ */
+typedef struct profile {
+  command_profile_t commands[PROFILE_COMMANDS]; ///< Czasy poleceń.
+} profile_t;
+
+/**
+ * Czasy poleceń zbierane z opcją --profile albo NULL.
+ */
+static profile_t *profile = NULL;
+
+/** @brief Zwraca numer przedziału histogramu dla czasu @p ns.
+ * Czasy mniejsze od 2^PROFILE_SUB_BITS mają własne przedziały, a większe
+ * trafiają do jednej z 2^PROFILE_SUB_BITS części swojej potęgi dwójki.
+ * @param[in] ns      – czas w nanosekundach.
+ * @return Numer przedziału.
+ */
+static uint32_t profile_bucket(uint64_t ns) {
+  if (ns < (1 << PROFILE_SUB_BITS)) {
+    return ns;
+  }
+
+  uint32_t exponent = 63 - __builtin_clzll(ns);
+  uint32_t part = (ns >> (exponent - PROFILE_SUB_BITS)) &
+    ((1 << PROFILE_SUB_BITS) - 1);
+
+  return ((exponent - PROFILE_SUB_BITS + 1) << PROFILE_SUB_BITS) + part;
+}
+
+/** @brief Zwraca największy czas należący do przedziału histogramu.
+ * @param[in] bucket  – numer przedziału.
+ * @return Czas w nanosekundach.
+ */
+static uint64_t profile_bucket_limit(uint32_t bucket) {
+  if (bucket < (1 << PROFILE_SUB_BITS)) {
+    return bucket;
+  }
+
+  uint32_t exponent = (bucket >> PROFILE_SUB_BITS) + PROFILE_SUB_BITS - 1;
+  uint64_t part = bucket & ((1 << PROFILE_SUB_BITS) - 1);
+  uint64_t width = UINT64_C(1) << (exponent - PROFILE_SUB_BITS);
+
+  return (((UINT64_C(1) << PROFILE_SUB_BITS) + part) * width) + width - 1;
+}
+
+/** @brief Dolicza jedno wywołanie polecenia.
+ * @param[in,out] command – czasy poleceń tego rodzaju,
+ * @param[in] ns          – czas wykonania w nanosekundach,
+ * @param[in] line_number – numer linijki polecenia.
+ */
+static void profile_record(command_profile_t *command, uint64_t ns,
+  unsigned long long int line_number) {
+
+  command->count++;
+  command->total_ns += ns;
+  if (ns > command->max_ns) {
+    command->max_ns = ns;
+  }
+  command->buckets[profile_bucket(ns)]++;
+
+  // wstawiamy do posortowanej listy najwolniejszych wywołań
+  uint32_t i = PROFILE_WORST;
+  while (i > 0 && command->worst[i - 1].ns < ns) {
+    if (i < PROFILE_WORST) {
+      command->worst[i] = command->worst[i - 1];
+    }
+    i--;
+  }
+  if (i < PROFILE_WORST) {
+    command->worst[i].ns = ns;
+    command->worst[i].line_number = line_number;
+  }
+}
+
+/** @brief Dolicza czasy z @p from do @p into.
+ * @param[in,out] into – czasy wszystkich poleceń,
+ * @param[in] from     – czasy poleceń jednego wątku.
+ */
+static void profile_merge(profile_t *into, const profile_t *from) {
+  for (size_t i = 0; i < PROFILE_COMMANDS; i++) {
+    command_profile_t *to = &into->commands[i];
+    const command_profile_t *command = &from->commands[i];
+
+    to->count += command->count;
+    to->total_ns += command->total_ns;
+    if (command->max_ns > to->max_ns) {
+      to->max_ns = command->max_ns;
+    }
+    for (uint32_t j = 0; j < PROFILE_BUCKETS; j++) {
+      to->buckets[j] += command->buckets[j];
+    }
+
+    // profile_record liczy też wywołanie, więc potem je odejmujemy
+    for (uint32_t j = 0; j < PROFILE_WORST && command->worst[j].ns > 0; j++) {
+      profile_record(to, command->worst[j].ns, command->worst[j].line_number);
+      to->count--;
+      to->total_ns -= command->worst[j].ns;
+      to->buckets[profile_bucket(command->worst[j].ns)]--;
+    }
+  }
+}
+
+/** @brief Zwraca czas, poniżej którego mieści się dana część wywołań.
+ * Percentyl to czas wywołania o randze ⌈permille · count / 1000⌉, liczonej
+ * w liczbach całkowitych bez zaokrągleń zmiennoprzecinkowych.
+ * @param[in] command  – czasy poleceń jednego rodzaju,
+ * @param[in] permille – część wywołań w tysięcznych, liczba z przedziału
+ *                       [1, 1000].
+ * @return Górna granica przedziału histogramu w nanosekundach, nie większa
+ * od najdłuższego czasu.
+ */
+static uint64_t profile_percentile(const command_profile_t *command,
+  uint64_t permille) {
+
+  // dzielenie z osobna całych tysięcy i reszty chroni przed przepełnieniem
+  uint64_t rank = command->count / 1000 * permille +
+    (command->count % 1000 * permille + 999) / 1000;
+  uint64_t seen = 0;
+
+  if (rank == 0) {
+    rank = 1;
+  }
+  if (rank > command->count) {
+    rank = command->count;
+  }
+  for (uint32_t i = 0; i < PROFILE_BUCKETS; i++) {
+    seen += command->buckets[i];
+    if (seen >= rank) {
+      uint64_t limit = profile_bucket_limit(i);
+      return limit < command->max_ns ? limit : command->max_ns;
+    }
+  }
+  return command->max_ns;
+}
+
+/** @brief Wypisuje raport czasów poleceń na wyjście błędów.
+ * Dla każdego wykonywanego rodzaju polecenia wypisuje linijkę z liczbą
+ * wywołań, percentylami p50, p99 i p999, najdłuższym czasem w nanosekundach
+ * i numerami linijek najwolniejszych wywołań w postaci linijka:czas.
+ */
+static void profile_report(void) {
+  if (profile == NULL) {
+    return;
+  }
+  // raport trafia za wcześniejsze wyniki i błędy
+  output_flush(&output);
+
+  for (size_t i = 0; i < PROFILE_COMMANDS; i++) {
+    const command_profile_t *command = &profile->commands[i];
+
+    if (command->count == 0) {
+      continue;
+    }
+    fprintf(stderr, "PROFILE %c count %" PRIu64 " total_ns %" PRIu64
+      " p50 %" PRIu64 " p99 %" PRIu64 " p999 %" PRIu64 " max %" PRIu64
+      " worst", BATCH_COMMANDS[i], command->count, command->total_ns,
+      profile_percentile(command, 500), profile_percentile(command, 990),
+      profile_percentile(command, 999), command->max_ns);
+    for (uint32_t j = 0; j < PROFILE_WORST && command->worst[j].ns > 0; j++) {
+      fprintf(stderr, " %llu:%" PRIu64, command->worst[j].line_number,
+        command->worst[j].ns);
+    }
+    fprintf(stderr, "\n");
+  }
+  free(profile);
+  profile = NULL;
+}
+
+/**
+ * Ścieżka pliku śladu podana opcją --trace albo NULL.
+ */
+static const char *trace_path = NULL;
+
+/** @brief Zapisuje ślad operacji silnika przy wyjściu z programu.
+ */
+static void trace_at_exit(void) {
+  if (!gamma_trace_dump(trace_path)) {
+    output_flush(&output);
+    fprintf(stderr, "ERROR, CANNOT WRITE TRACE %s\n", trace_path);
+  }
+}
+
+/** @brief Wykonuje polecenie trybu wsadowego, mierząc jego czas.
+ * @param[in,out] times    – czasy poleceń albo NULL, gdy ich nie mierzymy,
+ * @param[in,out] game     – wskaźnik na strukturę przechowującą stan gry,
+ * @param[in] command      – polecenie, litera 0 oznacza błędną linijkę,
+ * @param[out] result      – wynik polecenia,
+ * @param[in] line_number  – numer linijki lub rekordu polecenia.
+ */
+static void profiled_command(profile_t *times, gamma_t *game,
+  const command_t *command, result_t *result,
+  unsigned long long int line_number) {
+
+  const char *letter = NULL;
+
+  if (times != NULL && command->letter != 0) {
+    letter = strchr(BATCH_COMMANDS, command->letter);
+  }
+  if (letter == NULL) {
+    run_command(game, command, result);
+    return;
+  }
+
+  struct timespec begin;
+  struct timespec end;
+
+  clock_gettime(CLOCK_MONOTONIC, &begin);
+  run_command(game, command, result);
+  clock_gettime(CLOCK_MONOTONIC, &end);
+
+  uint64_t ns = (uint64_t)(end.tv_sec - begin.tv_sec) * 1000000000 +
+    end.tv_nsec - begin.tv_nsec;
+  profile_record(&times->commands[letter - BATCH_COMMANDS], ns, line_number);
+}
+
+/** @brief Wykonuje polecenie trybu wsadowego i wypisuje jego wynik.
+ * @param[in,out] game     – wskaźnik na strukturę przechowującą stan gry,
+ * @param[in] command      – polecenie,
+ * @param[in] binary       – czy wynik wypisać w formacie binarnym,
+ * @param[in] line_number  – numer linijki lub rekordu polecenia.
+ */
+static void execute_command(gamma_t *game, const command_t *command,
+  bool binary, unsigned long long int line_number) {
+
+  result_t result;
+
+  profiled_command(profile, game, command, &result, line_number);
+  emit_result(&output, &result, binary, line_number);
+}
+
 /** @brief Przeprowadza rozgrywkę w trybie wsadowym.
  * @param[in] game         – wskaźnik na strukturę przechowującą stan gry.
  * @param[in] line_number  – numer linijki.
  */
-void batch_mode(gamma_t *game, unsigned long long int line_number) {
-  while (true) {
-    char *line = NULL;
-    uint64_t char_number = 0;
-    uint64_t allocated_chars_number = 1;
-    int c = '0';
+void batch_mode(gamma_t *game, unsigned long long int line_number) {
+  while (true) {
+    const char *line;
+    uint64_t char_number;
+
+    // wzięcie linijki
+    int c = input_line(&input, &line, &char_number);
+    if (c == INPUT_NO_MEMORY) {
+      gamma_delete(game);
+      exit(1);
+    }
+
+    // koniec pliku
+    if (c == EOF) {
+      if (char_number != 0) {
+        if (line[0] != '#') {
+          output_error(&output, line_number);
+        }
+      }
+
+      gamma_delete(game);
+      return;
+    }
+
+    // wzięcie linii
+    if (char_number != 0) {
+      if (line[0] != '#') {
+        command_t command;
+
+        if (!parse_command(line, char_number, BATCH_COMMANDS, &command)) {
+          output_error(&output, line_number);
+        }
+        else {
+          execute_command(game, &command, false, line_number);
+        }
+      }
+    }
+
+    line_number++;
+  }
+}
+
+/**
+ * Liczba elementów kolejki między etapami trybu potokowego, potęga dwójki.
+ */
+#define PIPELINE_RING_SIZE 4096
+
+/** @struct pipeline_item
+ * Polecenie przekazywane między etapami trybu potokowego.
+ */
+typedef struct pipeline_item {
+  command_t command; ///< Polecenie, litera 0 oznacza błędną linijkę.
+  result_t result; ///< Wynik polecenia wypełniany przez etap silnika.
+  unsigned long long int line_number; ///< Numer linijki polecenia.
+  bool end; ///< Czy to ostatni element, po nim etap kończy pracę.
+  bool no_memory; ///< Czy wczytywanie skończyło się brakiem pamięci.
+} pipeline_item_t;
+
+/**
+ * Liczba prób w aktywnym oczekiwaniu na kolejkę, po nich wątek zasypia.
+ */
+#define PIPELINE_SPINS 256
+
+/** @struct ring
+ * Kolejka bez blokad dla jednego producenta i jednego konsumenta.
+ * Zamek i zmienna warunkowa służą tylko do uśpienia wątku, który zbyt
+ * długo czeka na drugą stronę.
+ */
+typedef struct ring {
+  pipeline_item_t items[PIPELINE_RING_SIZE]; ///< Elementy kolejki.
+  _Alignas(64) atomic_size_t head; ///< Liczba elementów zdjętych.
+  _Alignas(64) atomic_size_t tail; ///< Liczba elementów włożonych.
+  _Alignas(64) atomic_uint sleepers; ///< Liczba uśpionych wątków.
+  pthread_mutex_t lock; ///< Zamek do usypiania wątków.
+  pthread_cond_t wake; ///< Zmienna warunkowa do budzenia wątków.
+} ring_t;
+
+/** @struct pipeline
+ * Kolejki łączące etapy trybu potokowego.
+ */
+typedef struct pipeline {
+  ring_t commands; ///< Polecenia od wczytywania do silnika.
+  ring_t results; ///< Wyniki od silnika do wypisywania.
+} pipeline_t;
+
+/** @brief Inicjuje zamek i zmienną warunkową kolejki.
+ * @param[in,out] ring – wyzerowana kolejka.
+ * @return Wartość @p true, jeśli się udało, a @p false w przeciwnym wypadku.
+ */
+static bool ring_init(ring_t *ring) {
+  if (pthread_mutex_init(&ring->lock, NULL) != 0) {
+    return false;
+  }
+  if (pthread_cond_init(&ring->wake, NULL) != 0) {
+    pthread_mutex_destroy(&ring->lock);
+    return false;
+  }
+  return true;
+}
+
+/** @brief Zwalnia zamek i zmienną warunkową kolejki.
+ * @param[in,out] ring – kolejka.
+ */
+static void ring_destroy(ring_t *ring) {
+  pthread_cond_destroy(&ring->wake);
+  pthread_mutex_destroy(&ring->lock);
+}
+
+/** @brief Czeka, aż licznik kolejki będzie różny od podanej wartości.
+ * Najpierw czeka aktywnie, a po PIPELINE_SPINS próbach zasypia do czasu
+ * zmiany licznika przez drugą stronę kolejki.
+ * @param[in,out] ring   – kolejka,
+ * @param[in] counter    – licznik zmieniany przez drugą stronę,
+ * @param[in] blocked    – wartość licznika, przy której trzeba czekać.
+ */
+static void ring_wait(ring_t *ring, atomic_size_t *counter, size_t blocked) {
+  for (int i = 0; i < PIPELINE_SPINS; i++) {
+    if (atomic_load_explicit(counter, memory_order_acquire) != blocked) {
+      return;
+    }
+    sched_yield();
+  }
+
+  // sekwencyjne zwiększenie i odczyt łączą się z ring_wake: któraś strona
+  // zawsze zobaczy zmianę drugiej, więc sygnał nie może przepaść
+  pthread_mutex_lock(&ring->lock);
+  atomic_fetch_add(&ring->sleepers, 1);
+  while (atomic_load(counter) == blocked) {
+    pthread_cond_wait(&ring->wake, &ring->lock);
+  }
+  atomic_fetch_sub(&ring->sleepers, 1);
+  pthread_mutex_unlock(&ring->lock);
+}
+
+/** @brief Budzi wątek uśpiony w ring_wait po zmianie licznika kolejki.
+ * @param[in,out] ring – kolejka.
+ */
+static void ring_wake(ring_t *ring) {
+  if (atomic_load(&ring->sleepers) != 0) {
+    pthread_mutex_lock(&ring->lock);
+    pthread_cond_signal(&ring->wake);
+    pthread_mutex_unlock(&ring->lock);
+  }
+}
+
+/** @brief Wkłada element do kolejki, czekając na wolne miejsce.
+ * Może ją wywoływać tylko jeden wątek naraz.
+ * @param[in,out] ring – kolejka,
+ * @param[in] item     – wkładany element.
+ */
+static void ring_push(ring_t *ring, const pipeline_item_t *item) {
+  size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+
+  ring_wait(ring, &ring->head, tail - PIPELINE_RING_SIZE);
+  ring->items[tail & (PIPELINE_RING_SIZE - 1)] = *item;
+  atomic_store(&ring->tail, tail + 1);
+  ring_wake(ring);
+}
+
+/** @brief Zdejmuje element z kolejki, czekając, aż jakiś się pojawi.
+ * Może ją wywoływać tylko jeden wątek naraz.
+ * @param[in,out] ring – kolejka,
+ * @param[out] item    – zdjęty element.
+ */
+static void ring_pop(ring_t *ring, pipeline_item_t *item) {
+  size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+
+  ring_wait(ring, &ring->tail, head);
+  *item = ring->items[head & (PIPELINE_RING_SIZE - 1)];
+  atomic_store(&ring->head, head + 1);
+  ring_wake(ring);
+}
+
+/** @struct reader_stage
+ * Argument etapu wczytywania trybu potokowego.
+ */
+typedef struct reader_stage {
+  pipeline_t *pipeline; ///< Kolejki trybu potokowego.
+  unsigned long long int line_number; ///< Numer pierwszej linijki.
+} reader_stage_t;
+
+/** @brief Etap wczytywania: wczytuje i rozbiera linijki na polecenia.
+ * @param[in] arg     – wskaźnik na strukturę reader_stage_t.
+ * @return Wartość NULL.
+ */
+static void* reader_stage(void *arg) {
+  reader_stage_t *stage = arg;
+  pipeline_item_t item = { .line_number = stage->line_number };
+
+  while (!item.end) {
+    const char *line;
+    uint64_t char_number;
+
+    int c = input_line(&input, &line, &char_number);
+    if (c == INPUT_NO_MEMORY) {
+      item.end = true;
+      item.no_memory = true;
+      ring_push(&stage->pipeline->commands, &item);
+      break;
+    }
+
+    // linijka bez znaku końca linii jest błędna, nawet jeśli jest poleceniem
+    item.end = (c == EOF);
+    if (char_number != 0 && line[0] != '#') {
+      if (item.end ||
+        !parse_command(line, char_number, BATCH_COMMANDS, &item.command)) {
+
+        item.command.letter = 0;
+      }
+      ring_push(&stage->pipeline->commands, &item);
+    }
+    else if (item.end) {
+      // pusty element tylko kończy pracę kolejnych etapów
+      item.command.letter = '#';
+      ring_push(&stage->pipeline->commands, &item);
+    }
+    item.line_number++;
+  }
+  return NULL;
+}
+
+/** @brief Etap wypisywania: wypisuje wyniki w kolejności poleceń.
+ * @param[in] arg     – wskaźnik na strukturę pipeline_t.
+ * @return Wartość NULL.
+ */
+static void* writer_stage(void *arg) {
+  pipeline_t *pipeline = arg;
+  pipeline_item_t item;
+
+  do {
+    ring_pop(&pipeline->results, &item);
+    if (item.command.letter != '#' && !item.no_memory) {
+      emit_result(&output, &item.result, false, item.line_number);
+    }
+  } while (!item.end);
+
+  output_flush(&output);
+  return NULL;
+}
+
+/** @brief Przeprowadza rozgrywkę w trybie wsadowym w trzech etapach.
+ * Wczytywanie i rozbiór linijek, silnik gry oraz wypisywanie wyników
+ * działają w osobnych wątkach połączonych kolejkami ring_t, więc
+ * wyjście jest takie samo jak w batch_mode. Gdy nie uda się utworzyć
+ * wątków, rozgrywka przebiega w batch_mode.
+ * @param[in] game         – wskaźnik na strukturę przechowującą stan gry.
+ * @param[in] line_number  – numer linijki.
+ */
+static void pipelined_batch_mode(gamma_t *game,
+  unsigned long long int line_number) {
 
-    // wzięcie linijki
-    while (c != '\n' && c != EOF) {
-      c = getchar();
-
-      if (c != '\n' && c != EOF) {
-        if (char_number == 0) {
-          line = malloc(sizeof (char));
-          if (!line) {
-            gamma_delete(game);
-            exit(1);
-          }
-        }
+  pipeline_t *pipeline = calloc(1, sizeof(pipeline_t));
+  reader_stage_t stage = { .pipeline = pipeline, .line_number = line_number };
+  pthread_t reader, writer;
 
-        if (char_number == allocated_chars_number) {
-          allocated_chars_number = 2 * allocated_chars_number;
-          char *new_line = line =
-            realloc(line, allocated_chars_number *sizeof (char));
-          if (!new_line) {
-            free(line);
-            gamma_delete(game);
-            exit(1);
-          }
-          line = new_line;
+  if (pipeline == NULL) {
+    batch_mode(game, line_number);
+    return;
+  }
+  if (!ring_init(&pipeline->commands)) {
+    free(pipeline);
+    batch_mode(game, line_number);
+    return;
+  }
+  if (!ring_init(&pipeline->results)) {
+    ring_destroy(&pipeline->commands);
+    free(pipeline);
+    batch_mode(game, line_number);
+    return;
+  }
+  if (pthread_create(&reader, NULL, reader_stage, &stage) != 0) {
+    ring_destroy(&pipeline->results);
+    ring_destroy(&pipeline->commands);
+    free(pipeline);
+    batch_mode(game, line_number);
+    return;
+  }
+  // wczytywanie już trwa, więc bez wątku wypisywania wypisujemy tutaj
+  bool writing = (pthread_create(&writer, NULL, writer_stage, pipeline) == 0);
+
+  pipeline_item_t item;
+  do {
+    ring_pop(&pipeline->commands, &item);
+    bool command = (item.command.letter != '#' && !item.no_memory);
+
+    if (command) {
+      profiled_command(profile, game, &item.command, &item.result,
+        item.line_number);
+    }
+    if (writing) {
+      ring_push(&pipeline->results, &item);
+    }
+    else if (command) {
+      emit_result(&output, &item.result, false, item.line_number);
+    }
+  } while (!item.end);
+
+  pthread_join(reader, NULL);
+  if (writing) {
+    pthread_join(writer, NULL);
+  }
+  ring_destroy(&pipeline->results);
+  ring_destroy(&pipeline->commands);
+  free(pipeline);
+  gamma_delete(game);
+
+  if (item.no_memory) {
+    exit(1);
+  }
+}
+
+/**
+ * Liczba gier na wątek, które mogą czekać na wypisanie wyników.
+ */
+#define GAMES_IN_FLIGHT 4
+
+/** @struct game_task
+ * Jedna gra trybu wielu gier: linijki od polecenia B do następnego.
+ */
+typedef struct game_task {
+  const char *text; ///< Linijki gry razem ze znakami końca linii.
+  uint64_t length; ///< Liczba znaków linijek gry.
+  char *owned; ///< Kopia linijek, gdy wejście nie jest zmapowane, albo NULL.
+  uint64_t owned_capacity; ///< Liczba znaków, na które jest miejsce w owned.
+  unsigned long long int line_number; ///< Numer pierwszej linijki gry.
+  output_t *out; ///< Wyjście gry odłożone do wypisania w kolejności gier.
+  bool done; ///< Czy gra została rozegrana, chronione blokadą puli.
+  struct game_task *next; ///< Następna gra na wejściu.
+} game_task_t;
+
+/** @struct task_deque
+ * Kolejka gier jednego wątku puli. Wątek bierze gry z początku,
+ * a pozostałe wątki kradną z końca.
+ */
+typedef struct task_deque {
+  pthread_mutex_t lock; ///< Blokada kolejki.
+  game_task_t **tasks; ///< Gry w buforze cyklicznym.
+  size_t capacity; ///< Liczba gier, na które jest miejsce w tasks.
+  size_t head; ///< Pozycja pierwszej gry.
+  size_t count; ///< Liczba gier w kolejce.
+} task_deque_t;
+
+/** @struct game_pool
+ * Pula wątków rozgrywających gry z podkradaniem pracy.
+ */
+typedef struct game_pool {
+  uint32_t workers; ///< Liczba uruchomionych wątków.
+  task_deque_t *deques; ///< Kolejki gier, po jednej na wątek.
+  pthread_t *threads; ///< Wątki puli.
+  pthread_mutex_t lock; ///< Blokada liczników i flag puli.
+  pthread_cond_t work; ///< Sygnał dla wątków: pojawiła się gra.
+  pthread_cond_t finished; ///< Sygnał dla wypisywania: gra rozegrana.
+  size_t queued; /**< Liczba gier w kolejkach, których nie zarezerwował
+  * jeszcze żaden wątek. */
+  bool stopping; ///< Czy gier już nie przybędzie.
+  game_task_t *oldest; ///< Najstarsza gra czekająca na wypisanie.
+  game_task_t *newest; ///< Najnowsza gra czekająca na wypisanie.
+  uint64_t in_flight; ///< Liczba gier czekających na wypisanie.
+  uint64_t submitted; ///< Liczba gier przekazanych puli.
+} game_pool_t;
+
+/** @struct pool_worker
+ * Argument wątku puli.
+ */
+typedef struct pool_worker {
+  game_pool_t *pool; ///< Pula wątku.
+  uint32_t id; ///< Numer wątku, a zarazem jego kolejki.
+  profile_t *times; ///< Czasy poleceń wątku albo NULL.
+} pool_worker_t;
+
+/** @brief Dopisuje linijkę do kopii linijek gry.
+ * @param[in,out] task – gra,
+ * @param[in] line     – linijka,
+ * @param[in] length   – liczba znaków linijki,
+ * @param[in] newline  – czy linijka kończy się znakiem końca linii.
+ */
+static void task_append(game_task_t *task, const char *line, uint64_t length,
+  bool newline) {
+
+  uint64_t needed = task->length + length + newline;
+
+  if (needed > task->owned_capacity) {
+    uint64_t capacity = 2 * task->owned_capacity;
+    if (capacity < needed) {
+      capacity = needed;
+    }
+
+    char *owned = realloc(task->owned, capacity);
+    if (!owned) {
+      exit(1);
+    }
+    task->owned = owned;
+    task->owned_capacity = capacity;
+  }
+
+  memcpy(task->owned + task->length, line, length);
+  if (newline) {
+    task->owned[task->length + length] = '\n';
+  }
+  task->length = needed;
+}
+
+/** @brief Rozgrywa jedną grę trybu wielu gier.
+ * Pierwsza linijka gry to polecenie B. Po nieudanym utworzeniu gry,
+ * podobnie jak przed pierwszym poleceniem B, każda linijka poza
+ * komentarzami jest błędna.
+ * @param[in,out] task  – gra,
+ * @param[in,out] times – czasy poleceń wątku albo NULL.
+ */
+static void run_game_task(game_task_t *task, profile_t *times) {
+  const char *text = task->text;
+  uint64_t left = task->length;
+  unsigned long long int line_number = task->line_number;
+  gamma_t *game = NULL;
+  bool first = true;
+
+  while (left > 0) {
+    const char *newline = memchr(text, '\n', left);
+    uint64_t length = left;
+    command_t command;
+
+    if (newline != NULL) {
+      length = newline - text;
+    }
+
+    if (length != 0 && text[0] != '#') {
+      // linijka bez znaku końca linii jest błędna
+      if (newline == NULL) {
+        output_error(task->out, line_number);
+      }
+      else if (first && parse_command(text, length, "B", &command)) {
+        game = gamma_new(command.numbers[0], command.numbers[1],
+          command.numbers[2], command.numbers[3]);
+
+        if (game == NULL) {
+          output_error(task->out, line_number);
+        }
+        else {
+          // równoległość daje już pula, gra nie dzieli się na wątki
+          gamma_set_threads(game, 1);
+          output_chars(task->out, STDOUT_FILENO, "OK ", 3);
+          output_number(task->out, STDOUT_FILENO, line_number);
         }
+      }
+      else if (game != NULL &&
+        parse_command(text, length, BATCH_COMMANDS, &command)) {
+
+        result_t result;
+
+        profiled_command(times, game, &command, &result, line_number);
+        emit_result(task->out, &result, false, line_number);
+      }
+      else {
+        output_error(task->out, line_number);
+      }
+    }
+
+    first = false;
+    if (newline == NULL) {
+      break;
+    }
+    text = newline + 1;
+    left -= length + 1;
+    line_number++;
+  }
+
+  output_flush(task->out);
+  gamma_delete(game);
+}
+
+/** @brief Zdejmuje grę z kolejki.
+ * @param[in,out] deque – kolejka gier,
+ * @param[in] front     – czy zdjąć grę z początku, czy z końca.
+ * @return Zdjęta gra albo NULL, gdy kolejka jest pusta.
+ */
+static game_task_t* deque_take(task_deque_t *deque, bool front) {
+  game_task_t *task = NULL;
+
+  pthread_mutex_lock(&deque->lock);
+  if (deque->count > 0) {
+    if (front) {
+      task = deque->tasks[deque->head];
+      deque->head = (deque->head + 1) % deque->capacity;
+    }
+    else {
+      task = deque->tasks[(deque->head + deque->count - 1) % deque->capacity];
+    }
+    deque->count--;
+  }
+  pthread_mutex_unlock(&deque->lock);
+
+  return task;
+}
+
+/** @brief Dokłada grę na koniec kolejki.
+ * @param[in,out] deque – kolejka gier,
+ * @param[in] task      – gra.
+ */
+static void deque_push(task_deque_t *deque, game_task_t *task) {
+  pthread_mutex_lock(&deque->lock);
+  if (deque->count == deque->capacity) {
+    size_t capacity = 2 * deque->capacity + 1;
+    game_task_t **tasks = malloc(capacity * sizeof(game_task_t*));
+    if (!tasks) {
+      exit(1);
+    }
+
+    for (size_t i = 0; i < deque->count; i++) {
+      tasks[i] = deque->tasks[(deque->head + i) % deque->capacity];
+    }
+    free(deque->tasks);
+    deque->tasks = tasks;
+    deque->capacity = capacity;
+    deque->head = 0;
+  }
+  deque->tasks[(deque->head + deque->count) % deque->capacity] = task;
+  deque->count++;
+  pthread_mutex_unlock(&deque->lock);
+}
+
+/** @brief Wątek puli: rozgrywa gry ze swojej kolejki, a gdy jest pusta,
+ * podkrada gry z kolejek pozostałych wątków.
+ * @param[in] arg     – wskaźnik na strukturę pool_worker_t.
+ * @return Wartość NULL.
+ */
+static void* pool_worker(void *arg) {
+  pool_worker_t *worker = arg;
+  game_pool_t *pool = worker->pool;
+
+  while (true) {
+    pthread_mutex_lock(&pool->lock);
+    while (pool->queued == 0 && !pool->stopping) {
+      pthread_cond_wait(&pool->work, &pool->lock);
+    }
+    if (pool->queued == 0) {
+      pthread_mutex_unlock(&pool->lock);
+      return NULL;
+    }
+    // Rezerwujemy grę. Gra trafia do queued dopiero, gdy leży w kolejce,
+    // a zdejmują gry tylko wątki, które je zarezerwowały, więc w kolejkach
+    // jest co najmniej tyle gier, ilu wątków ich szuka.
+    pool->queued--;
+    pthread_mutex_unlock(&pool->lock);
+
+    game_task_t *task = deque_take(&pool->deques[worker->id], true);
+    for (uint32_t i = 1; task == NULL; i++) {
+      task = deque_take(&pool->deques[(worker->id + i) % pool->workers],
+        false);
+    }
+
+    run_game_task(task, worker->times);
+
+    pthread_mutex_lock(&pool->lock);
+    task->done = true;
+    pthread_cond_broadcast(&pool->finished);
+    pthread_mutex_unlock(&pool->lock);
+  }
+}
+
+/** @brief Wypisuje odłożone wyjście gry i zwalnia grę.
+ * @param[in,out] task – rozegrana gra.
+ */
+static void task_emit(game_task_t *task) {
+  output_t *out = task->out;
+  size_t position = 0;
+
+  while (position < out->memory_length) {
+    int fd = out->memory[position];
+    uint64_t length;
+
+    memcpy(&length, out->memory + position + 1, sizeof (uint64_t));
+    position += 1 + sizeof (uint64_t);
+    output_chars(&output, fd, out->memory + position, length);
+    position += length;
+  }
+
+  free(out->memory);
+  free(out);
+  free(task->owned);
+  free(task);
+}
+
+/** @brief Przekazuje kompletną grę puli wątków.
+ * Bez wątków puli gra jest rozgrywana od razu.
+ * @param[in,out] pool – pula wątków,
+ * @param[in,out] task – gra.
+ */
+static void pool_submit(game_pool_t *pool, game_task_t *task) {
+  if (task->owned != NULL) {
+    task->text = task->owned;
+  }
+  task->out = calloc(1, sizeof(output_t));
+  if (!task->out) {
+    exit(1);
+  }
+  task->out->fd = STDOUT_FILENO;
+  task->out->deferred = true;
+
+  if (pool->newest != NULL) {
+    pool->newest->next = task;
+  }
+  else {
+    pool->oldest = task;
+  }
+  pool->newest = task;
+  pool->in_flight++;
+
+  if (pool->workers == 0) {
+    run_game_task(task, profile);
+    task->done = true;
+  }
+  else {
+    pthread_mutex_lock(&pool->lock);
+    deque_push(&pool->deques[pool->submitted % pool->workers], task);
+    pool->queued++;
+    pthread_cond_signal(&pool->work);
+    pthread_mutex_unlock(&pool->lock);
+  }
+  pool->submitted++;
+}
+
+/** @brief Wypisuje wyniki rozegranych gier w kolejności wejścia.
+ * @param[in,out] pool – pula wątków,
+ * @param[in] limit    – liczba gier, które mogą dalej czekać na wypisanie;
+ *                       na rozegranie starszych gier funkcja czeka.
+ */
+static void pool_emit(game_pool_t *pool, uint64_t limit) {
+  while (pool->oldest != NULL) {
+    game_task_t *task = pool->oldest;
+
+    pthread_mutex_lock(&pool->lock);
+    if (!task->done && pool->in_flight <= limit) {
+      pthread_mutex_unlock(&pool->lock);
+      return;
+    }
+    while (!task->done) {
+      pthread_cond_wait(&pool->finished, &pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    pool->oldest = task->next;
+    if (pool->oldest == NULL) {
+      pool->newest = NULL;
+    }
+    pool->in_flight--;
+    task_emit(task);
+  }
+}
+
+/** @brief Tworzy pustą grę trybu wielu gier.
+ * @param[in] line_number  – numer pierwszej linijki gry.
+ * @return Wskaźnik na utworzoną grę.
+ */
+static game_task_t* task_new(unsigned long long int line_number) {
+  game_task_t *task = calloc(1, sizeof(game_task_t));
 
-        line[char_number] = c;
-        char_number++;
+  if (!task) {
+    exit(1);
+  }
+  task->line_number = line_number;
+  return task;
+}
+
+/** @brief Przeprowadza wiele niezależnych gier w trybie wsadowym.
+ * Każde poprawne polecenie B zaczyna nową grę, linijki przed pierwszym
+ * z nich są traktowane jak przed utworzeniem gry. Gry są rozgrywane przez
+ * pulę wątków z podkradaniem pracy, a wyniki gier wypisywane w kolejności
+ * wejścia, każda gra tak, jak wypisałby ją tryb wsadowy.
+ */
+static void multi_game_mode(void) {
+  game_pool_t pool = { .workers = 0 };
+  long cores = sysconf(_SC_NPROCESSORS_ONLN);
+  uint32_t threads = (cores > 1) ? cores : 1;
+  pool_worker_t *workers = calloc(threads, sizeof(pool_worker_t));
+
+  pool.deques = calloc(threads, sizeof(task_deque_t));
+  pool.threads = calloc(threads, sizeof(pthread_t));
+  if (!workers || !pool.deques || !pool.threads) {
+    exit(1);
+  }
+  pthread_mutex_init(&pool.lock, NULL);
+  pthread_cond_init(&pool.work, NULL);
+  pthread_cond_init(&pool.finished, NULL);
+  for (uint32_t i = 0; i < threads; i++) {
+    pthread_mutex_init(&pool.deques[i].lock, NULL);
+  }
+  for (uint32_t i = 0; i < threads; i++) {
+    workers[i] = (pool_worker_t){ .pool = &pool, .id = i };
+    if (profile != NULL) {
+      // każdy wątek mierzy osobno, czasy łączymy po zakończeniu puli
+      workers[i].times = calloc(1, sizeof(profile_t));
+      if (!workers[i].times) {
+        exit(1);
+      }
+    }
+    if (pthread_create(&pool.threads[i], NULL, pool_worker, &workers[i])
+      != 0) {
+
+      break;
+    }
+    pool.workers++;
+  }
+
+  uint64_t limit = GAMES_IN_FLIGHT * (pool.workers > 0 ? pool.workers : 1);
+  unsigned long long int line_number = 1;
+  game_task_t *task = task_new(line_number);
+
+  while (true) {
+    const char *line;
+    uint64_t char_number;
+    command_t command;
+
+    int c = input_line(&input, &line, &char_number);
+    if (c == INPUT_NO_MEMORY) {
+      exit(1);
+    }
+
+    if (c == '\n' && char_number != 0 && line[0] == 'B' &&
+      parse_command(line, char_number, "B", &command)) {
+
+      if (task->length != 0) {
+        pool_submit(&pool, task);
+      }
+      else {
+        free(task);
+      }
+      task = task_new(line_number);
+    }
+
+    if (c == '\n' || char_number != 0) {
+      if (input.mapped != NULL) {
+        // linijki zmapowanego pliku leżą w nim jedna za drugą
+        if (task->length == 0) {
+          task->text = line;
+        }
+        task->length = line + char_number + (c == '\n') - task->text;
       }
+      else {
+        task_append(task, line, char_number, c == '\n');
+      }
+    }
+
+    if (c == EOF) {
+      break;
+    }
+    pool_emit(&pool, limit);
+    line_number++;
+  }
+
+  if (task->length != 0) {
+    pool_submit(&pool, task);
+  }
+  else {
+    free(task);
+  }
+  pool_emit(&pool, 0);
+
+  pthread_mutex_lock(&pool.lock);
+  pool.stopping = true;
+  pthread_cond_broadcast(&pool.work);
+  pthread_mutex_unlock(&pool.lock);
+  for (uint32_t i = 0; i < pool.workers; i++) {
+    pthread_join(pool.threads[i], NULL);
+  }
+  for (uint32_t i = 0; i < threads; i++) {
+    if (workers[i].times != NULL) {
+      profile_merge(profile, workers[i].times);
+      free(workers[i].times);
     }
+  }
+
+  for (uint32_t i = 0; i < threads; i++) {
+    pthread_mutex_destroy(&pool.deques[i].lock);
+    free(pool.deques[i].tasks);
+  }
+  pthread_mutex_destroy(&pool.lock);
+  pthread_cond_destroy(&pool.work);
+  pthread_cond_destroy(&pool.finished);
+  free(pool.deques);
+  free(pool.threads);
+  free(workers);
+}
+
+/**
+ * Styl pola należącego do gracza, który ma ruch.
+ */
+#define STYLE_PLAYER 1
+
+/**
+ * Styl pola pod kursorem, gdy graczy jest więcej niż 9.
+ */
+#define STYLE_CURSOR 2
+
+/**
+ * Rozmiar bufora linijki stanu pod planszą.
+ */
+#define STATUS_SIZE 128
+
+/**
+ * Kody kolorów stylów pól, indeksowane sumą STYLE_PLAYER i STYLE_CURSOR.
+ */
+static const char *style_colors[4] = {
+  "", "\033[1;36m", "\033[1;45m", "\033[1;36;45m"
+};
+
+/** @struct screen_cell
+ * Pole planszy narysowane na ekranie.
+ */
+typedef struct screen_cell {
+  uint32_t owner; ///< Numer gracza na polu, 0 dla wolnego pola.
+  uint8_t style; ///< Styl pola: suma STYLE_PLAYER i STYLE_CURSOR.
+} screen_cell_t;
+
+/**
+ * Flaga ustawiana przez obsługę sygnału SIGWINCH: terminal zmienił rozmiar.
+ */
+static volatile sig_atomic_t terminal_resized = 0;
+
+/** @brief Obsługuje sygnał SIGWINCH.
+ * @param[in] signal – numer sygnału.
+ */
+static void terminal_resize_handler(int signal) {
+  (void)signal;
+  terminal_resized = 1;
+}
+
+/** @struct renderer
+ * Ekran trybu interaktywnego rysowany różnicowo. Pokazuje tylko okno
+ * planszy mieszczące się w terminalu, przesuwane za kursorem. Pamięta kopię
+ * tego, co jest na ekranie, i w każdej klatce wysyła tylko zmienione pola
+ * okna i linijkę stanu, wszystko jednym wywołaniem write.
+ */
+typedef struct renderer {
+  uint32_t width; ///< Szerokość planszy.
+  uint32_t height; ///< Wysokość planszy.
+  uint32_t digits; ///< Liczba cyfr numeru ostatniego gracza.
+  bool wide; /**< Czy graczy jest więcej niż 9: pola mają wtedy @p digits
+  * znaków i spację, a kursor jest zaznaczany tłem pola. */
+  uint32_t cell_width; ///< Liczba kolumn terminala zajmowanych przez pole.
+  uint32_t view_x; ///< Numer pierwszej kolumny planszy w oknie.
+  uint32_t view_y; ///< Numer najniższego wiersza planszy w oknie.
+  uint32_t view_columns; ///< Liczba kolumn planszy w oknie.
+  uint32_t view_rows; ///< Liczba wierszy planszy w oknie.
+  screen_cell_t *shadow; /**< Pola narysowane w oknie, wierszami od góry
+  * ekranu. */
+  bool drawn; ///< Czy na ekranie jest już okno planszy.
+  char status[STATUS_SIZE]; ///< Narysowana linijka stanu.
+  int status_length; ///< Liczba znaków narysowanej linijki stanu.
+  uint32_t row; ///< Wiersz terminala, w którym jest kursor po rysowaniu.
+  uint32_t column; ///< Kolumna terminala, w której jest kursor.
+  char *frame; ///< Sekwencje sterujące bieżącej klatki.
+  size_t length; ///< Liczba znaków klatki.
+  size_t capacity; ///< Liczba znaków, na które jest miejsce w klatce.
+} renderer_t;
+
+/** @brief Dopasowuje okno planszy do rozmiaru terminala.
+ * Pod oknem zostaje wiersz na linijkę stanu. Jeśli rozmiaru terminala nie
+ * da się odczytać, okno obejmuje całą planszę. Po zmianie rozmiaru cały
+ * ekran zostanie narysowany od nowa.
+ * @param[in,out] renderer – ekran.
+ */
+static void renderer_resize(renderer_t *renderer) {
+  struct winsize w;
+  uint32_t rows = renderer->height;
+  uint32_t columns = renderer->width;
+
+  if (ioctl(STDIN_FILENO, TIOCGWINSZ, &w) == 0 && w.ws_row > 0 &&
+    w.ws_col > 0) {
+
+    rows = (w.ws_row > 1) ? w.ws_row - 1 : 1;
+    columns = (w.ws_col > renderer->cell_width) ?
+      w.ws_col / renderer->cell_width : 1;
+  }
+  renderer->view_rows = (rows < renderer->height) ? rows : renderer->height;
+  renderer->view_columns = (columns < renderer->width) ?
+    columns : renderer->width;
+
+  screen_cell_t *shadow = realloc(renderer->shadow,
+    (size_t)renderer->view_rows * renderer->view_columns *
+    sizeof(screen_cell_t));
+  if (shadow == NULL) {
+    exit(1);
+  }
+  renderer->shadow = shadow;
+  renderer->drawn = false;
+}
 
-    // nasza linijka musi być stringiem, więc dodaje '\0'
-    if (char_number != 0) {
-      if (char_number == allocated_chars_number) {
-        allocated_chars_number = allocated_chars_number + 1;
-        char *new_line = line =
-          realloc(line, allocated_chars_number *sizeof (char));
-        if (!new_line) {
-          free(line);
-          gamma_delete(game);
-          exit(1);
-        }
-        line = new_line;
-      }
+/** @brief Przygotowuje ekran trybu interaktywnego.
+ * @param[out] renderer – ekran,
+ * @param[in] game      – wskaźnik na strukturę przechowującą stan gry.
+ */
+static void renderer_init(renderer_t *renderer, gamma_t *game) {
+  *renderer = (renderer_t){
+    .width = return_width(game),
+    .height = return_height(game),
+    .digits = number_of_digits(return_players(game)),
+    .wide = return_players(game) > 9
+  };
+  renderer->cell_width = renderer->wide ? renderer->digits + 1 : 1;
+  renderer_resize(renderer);
+}
 
-      line[char_number] = '\0';
-    }
+/** @brief Sprawdza, czy okno obejmuje całą planszę.
+ * @param[in] renderer – ekran.
+ * @return Wartość @p true, jeśli cała plansza mieści się w terminalu,
+ * a @p false w przeciwnym przypadku.
+ */
+static bool renderer_fits(const renderer_t *renderer) {
+  return renderer->view_columns == renderer->width &&
+    renderer->view_rows == renderer->height;
+}
 
-    // koniec pliku
-    if (c == EOF) {
-      if (char_number != 0) {
-        if (line[0] != '#') {
-          free(line);
-          fprintf(stderr, "ERROR %llu\n", line_number);
-          gamma_delete(game);
-          return;
-        }
-      }
+/** @brief Zwalnia pamięć ekranu trybu interaktywnego.
+ * Przywraca zawijanie wierszy, wyłączone na czas rysowania.
+ * @param[in,out] renderer – ekran.
+ */
+static void renderer_free(renderer_t *renderer) {
+  if (renderer->frame != NULL) {
+    write_all(STDOUT_FILENO, "\033[?7h", 5);
+  }
+  free(renderer->shadow);
+  free(renderer->frame);
+  renderer->shadow = NULL;
+  renderer->frame = NULL;
+}
 
-      if (char_number != 0) {
-        free(line);
-      }
-      gamma_delete(game);
-      return;
+/** @brief Dopisuje znaki do bieżącej klatki.
+ * @param[in,out] renderer – ekran,
+ * @param[in] chars        – znaki,
+ * @param[in] size         – liczba znaków.
+ */
+static void frame_append(renderer_t *renderer, const char *chars,
+  size_t size) {
+
+  if (renderer->length + size > renderer->capacity) {
+    size_t capacity = 2 * renderer->capacity + size + 256;
+    char *frame = realloc(renderer->frame, capacity);
+    if (frame == NULL) {
+      exit(1);
     }
+    renderer->frame = frame;
+    renderer->capacity = capacity;
+  }
+  memcpy(renderer->frame + renderer->length, chars, size);
+  renderer->length += size;
+}
 
-    // wzięcie linii
-    if (char_number != 0) {
-      if (line[0] != '#') {
-        if (line[0] != 'm' && line[0] != 'g' && line[0] != 'b' &&
-          line[0] != 'f' && line[0] != 'q' && line[0] != 'p') {
+/** @brief Przesuwa kursor terminala, chyba że już tam jest.
+ * @param[in,out] renderer – ekran,
+ * @param[in] row          – wiersz terminala, liczony od 1,
+ * @param[in] column       – kolumna terminala, liczona od 1.
+ */
+static void frame_move(renderer_t *renderer, uint32_t row, uint32_t column) {
+  if (row != renderer->row || column != renderer->column) {
+    char text[32];
+    int size = sprintf(text, "\033[%" PRIu32 ";%" PRIu32 "H", row, column);
+
+    frame_append(renderer, text, size);
+    renderer->row = row;
+    renderer->column = column;
+  }
+}
 
-          fprintf(stderr, "ERROR %llu\n", line_number);
-        }
-        else {
-          // sprawdzanie czy mamy '\0' bo to "rozwala" strtok
-          bool broken_sign = false;
-          for (uint32_t i = 1; i < char_number; i++) {
-            if (line[i] == '\0') {
-              broken_sign = true;
-            }
-          }
+/** @brief Dopisuje do klatki narysowanie pola okna.
+ * Pole zajmuje tyle znaków co w napisie z gamma_board, razem ze spacją
+ * za nim, gdy graczy jest więcej niż 9.
+ * @param[in,out] renderer – ekran,
+ * @param[in] row          – wiersz okna, liczony od 0 od góry,
+ * @param[in] column       – kolumna okna, liczona od 0,
+ * @param[in] cell         – zawartość pola.
+ */
+static void frame_cell(renderer_t *renderer, uint32_t row, uint32_t column,
+  screen_cell_t cell) {
 
-          if (broken_sign == true) {
-            fprintf(stderr, "ERROR %llu\n", line_number);
-          }
-          else {
-            char *words[5];
-            words[0] = strtok (line," \t\v\f\r");
-            for (int i = 1; i < 5; i++) {
-              words[i] = strtok (NULL," \t\v\f\r");
-            }
+  char text[32];
+  int size = 0;
 
-            if (words[0] == NULL) {
-              fprintf(stderr, "ERROR %llu\n", line_number);
-            }
-            else {
-              if (words[4] != NULL) {
-                fprintf(stderr, "ERROR %llu\n", line_number);   
-              }
-              else {
-                if (words[1] == NULL) {
-                  if (strcmp(words[0], "p") != 0) {
-                    fprintf(stderr, "ERROR %llu\n", line_number);
-                  }
-                  else {
-                    char *result = gamma_board(game);
+  frame_move(renderer, row + 1, column * renderer->cell_width + 1);
 
-                    if (result == NULL) {
-                      fprintf(stderr, "ERROR %llu\n", line_number);
-                    }
-                    else {
-                      printf("%s", result);
-                      free(result);
-                    }
-                  }
-                }
-                else {
-                  if (words[2] == NULL) {
-                    if ((strcmp(words[0], "b") != 0) &&
-                      (strcmp(words[0], "f") != 0) &&
-                      (strcmp(words[0], "q") != 0)) {
+  char number[16];
+  int length = (cell.owner == 0) ? sprintf(number, ".") :
+    sprintf(number, "%" PRIu32, cell.owner);
 
-                      fprintf(stderr, "ERROR %llu\n", line_number);
-                    }
-                    else {
-                      uint32_t number;
-                      bool error = false;
-      
-                      // sprawdzanie czy nasze drugie słowo jest liczbą
-                      char *not_numbers_word;
-                      not_numbers_word = strtok (words[1],"0123456789");
-                      if (not_numbers_word != NULL) {
-                        fprintf(stderr, "ERROR %llu\n", line_number);
-                        error = true;
-                      }
+  // wyrównanie do prawej bez stylu, styl ma tylko numer lub kropka
+  if (renderer->wide) {
+    size = sprintf(text, "%*s", (int)renderer->digits - length, "");
+  }
+  size += sprintf(text + size, "%s%s\033[0m%s", style_colors[cell.style],
+    number, renderer->wide ? " " : "");
+  frame_append(renderer, text, size);
+  renderer->column += renderer->cell_width;
+}
 
-                      if (error == false) {
-                        unsigned long long tmp = strtoull(words[1], NULL, 10);
-
-                        if (errno == ERANGE || tmp > UINT32_MAX) {
-                          fprintf(stderr, "ERROR %llu\n", line_number);
-                        }
-                        else {
-                          number = tmp;
-
-                          if (strcmp(words[0], "b") == 0) {
-                            printf("%li\n", gamma_busy_fields(game, number));
-                          }
-
-                          if (strcmp(words[0], "f") == 0) {
-                            printf("%li\n", gamma_free_fields(game, number));
-                          }
-
-                          if (strcmp(words[0], "q") == 0) {
-                            if (gamma_golden_possible(game, number)
-                              == false) {
-
-                              printf("0\n");
-                            }
-                            else {
-                              printf("1\n");
-                            }
-                          }
-                        }
-                      }
-                    }
-                  }
-                  else {
-                    if (words[3] == NULL) {
-                      fprintf(stderr, "ERROR %llu\n", line_number);
-                    }
-                    else {
-                      if ((strcmp(words[0], "m") != 0) &&
-                        (strcmp(words[0], "g") != 0)) {
+/** @brief Przesuwa okno planszy tak, żeby było w nim pole (@p x, @p y).
+ * Okno przesuwa się o tyle pól, o ile kursor z niego wyszedł, i nie
+ * wychodzi poza planszę.
+ * @param[in,out] renderer – ekran,
+ * @param[in] x            – numer kolumny pola pod kursorem,
+ * @param[in] y            – numer wiersza pola pod kursorem.
+ */
+static void renderer_follow(renderer_t *renderer, uint32_t x, uint32_t y) {
+  if (renderer->view_x > renderer->width - renderer->view_columns) {
+    renderer->view_x = renderer->width - renderer->view_columns;
+  }
+  if (renderer->view_y > renderer->height - renderer->view_rows) {
+    renderer->view_y = renderer->height - renderer->view_rows;
+  }
+  if (x < renderer->view_x) {
+    renderer->view_x = x;
+  }
+  else if (x - renderer->view_x >= renderer->view_columns) {
+    renderer->view_x = x - renderer->view_columns + 1;
+  }
+  if (y < renderer->view_y) {
+    renderer->view_y = y;
+  }
+  else if (y - renderer->view_y >= renderer->view_rows) {
+    renderer->view_y = y - renderer->view_rows + 1;
+  }
+}
 
-                        fprintf(stderr, "ERROR %llu\n", line_number);
-                      }
-                      else {
-                        uint32_t numbers[3];
-                        bool error = false;
-
-                        // sprawdzanie czy nasze słowa
-                        // (poza pierwszym) są liczbami
-                        char *not_numbers[3];
-                        for (int i = 0; i < 3; i++) {
-                          if (error == false) {
-                            not_numbers[i] =
-                              strtok (words[i + 1],"0123456789");
-                            if (not_numbers[i] != NULL) {
-                              fprintf(stderr, "ERROR %llu\n", line_number);
-                              error = true;
-                            }
-                          }
-                        }
-
-                        for (int i = 0; i < 3; i++) {
-                          if (error == false) {
-                            unsigned long long tmp =
-                              strtoull(words[i + 1], NULL, 10);
-
-                            if (errno == ERANGE || tmp > UINT32_MAX) {
-                              fprintf(stderr, "ERROR %llu\n", line_number);
-                              error = true;
-                            }
-                            else {
-                              numbers[i] = tmp;
-                            }
-                          }
-                        }
-
-                        if (error == false) {
-                          if (strcmp(words[0], "m") == 0) {
-                            if (gamma_move(game, numbers[0],
-                              numbers[1], numbers[2]) == false) {
-
-                              printf("0\n");
-                            }
-                            else {
-                              printf("1\n");
-                            }
-                          }
-                          else {
-                            if (gamma_golden_move(game, numbers[0],
-                              numbers[1], numbers[2]) == false) {
-
-                              printf("0\n");
-                            }
-                            else {
-                              printf("1\n");
-                            }
-                          }
-                        }
-                      }
-                    }
-                  }
-                }
-              }
-            }
-          }
-        }
+/** @brief Rysuje klatkę trybu interaktywnego.
+ * Za pierwszym razem i po zmianie rozmiaru terminala czyści ekran i rysuje
+ * całe okno planszy, później tylko pola okna, których właściciel lub styl
+ * się zmienił, także przez przesunięcie okna, i zmienioną linijkę stanu.
+ * Koszt klatki zależy od rozmiaru terminala, a nie planszy.
+ * @param[in,out] renderer – ekran,
+ * @param[in] game         – wskaźnik na strukturę przechowującą stan gry,
+ * @param[in] player       – numer gracza, który ma ruch,
+ * @param[in] x            – numer kolumny pola pod kursorem,
+ * @param[in] y            – numer wiersza pola pod kursorem.
+ */
+static void render_frame(renderer_t *renderer, gamma_t *game,
+  uint32_t player, uint32_t x, uint32_t y) {
+
+  renderer->length = 0;
+  if (!renderer->drawn) {
+    // bez zawijania za długa linijka stanu nie przewinie ekranu
+    frame_append(renderer, "\033[?25l\033[?7l\033[2J\033[H", 18);
+    renderer->row = 1;
+    renderer->column = 1;
+  }
+  renderer_follow(renderer, x, y);
+
+  // wiersze od góry, tak jak w napisie z gamma_board
+  uint32_t top = renderer->view_y + renderer->view_rows - 1;
+  for (uint32_t row = 0; row < renderer->view_rows; row++) {
+    for (uint32_t column = 0; column < renderer->view_columns; column++) {
+      uint32_t i = renderer->view_x + column;
+      uint32_t j = top - row;
+      screen_cell_t cell = { .owner = return_field_owner(game, i, j) };
+      screen_cell_t *shadow =
+        &renderer->shadow[(size_t)row * renderer->view_columns + column];
+
+      if (cell.owner == player) {
+        cell.style |= STYLE_PLAYER;
       }
-    }
+      if (renderer->wide && i == x && j == y) {
+        cell.style |= STYLE_CURSOR;
+      }
+      if (!renderer->drawn || cell.owner != shadow->owner ||
+        cell.style != shadow->style) {
 
-    if (char_number != 0) {
-      free(line);
+        frame_cell(renderer, row, column, cell);
+        *shadow = cell;
+      }
     }
-    line_number++;
   }
+
+  gamma_player_stats_t stats;
+  char status[STATUS_SIZE];
+
+  gamma_player_stats(game, player, 1, true, &stats);
+  int length = snprintf(status, sizeof(status),
+    "\033[0;36mPLAYER %" PRIu32 " \033[1;36m%" PRIu64 " \033[1;32m%" PRIu64
+    "%s\033[0m\033[K", player, stats.busy_fields,
+    return_free_fields_around(game, player),
+    stats.golden_possible ? "\033[1;33m G" : "");
+  if (!renderer->drawn || length != renderer->status_length ||
+    memcmp(status, renderer->status, length) != 0) {
+
+    frame_move(renderer, renderer->view_rows + 1, 1);
+    frame_append(renderer, status, length);
+    memcpy(renderer->status, status, length);
+    renderer->status_length = length;
+    // długości sekwencji sterujących nie śledzimy, więc kursor jest nieznany
+    renderer->row = 0;
+  }
+  renderer->drawn = true;
+
+  // przy co najwyżej 9 graczach kursorem jest kursor terminala
+  if (renderer->wide) {
+    frame_append(renderer, "\033[?25l", 6);
+  }
+  else {
+    frame_move(renderer, top - y + 1, x - renderer->view_x + 1);
+    frame_append(renderer, "\033[?25h", 6);
+  }
+
+  write_all(STDOUT_FILENO, renderer->frame, renderer->length);
 }
 
+/**
+ * Liczba graczy, których statystyki końcowe pobieramy naraz.
+ */
+#define SUMMARY_CHUNK 256
+
 /** @brief Przeprowadza rozgrywkę w trybie interaktywnym.
  * @param[in] game         – wskaźnik na strukturę przechowującą stan gry.
  */
 void interactive_mode(gamma_t *game) {
   bool game_over = false;
   uint32_t number_of_players = return_players(game);
-  uint32_t length_of_number = number_of_digits(number_of_players);
   uint32_t failed_rounds = 0;
   uint32_t current_player = 1;
-  uint32_t x_coordinate_cursor = return_height(game);
-  uint32_t y_coordinate_cursor = length_of_number;
   uint32_t x_coordinate = 0;
   uint32_t y_coordinate = 0;
 
-  // najpierw sprawdzamy, czy terminal jest wystarczająco duży do tej gry
-  struct winsize w;
-  ioctl(0, TIOCGWINSZ, &w);
-  if (w.ws_row < (return_height(game) + 1) ||
-    w.ws_col < (return_width(game) * (length_of_number + 1))) {
-
-    printf("ERROR, TOO SMALL TERMINAL\n");
-    gamma_delete(game);
-    exit(1);
-  }
+  // zmiana rozmiaru terminala może przerwać tylko czekanie na klawisz
+  struct sigaction resize = { .sa_handler = terminal_resize_handler };
+  sigset_t blocked, waiting;
+  sigemptyset(&resize.sa_mask);
+  sigaction(SIGWINCH, &resize, NULL);
+  sigemptyset(&blocked);
+  sigaddset(&blocked, SIGWINCH);
+  sigprocmask(SIG_BLOCK, &blocked, &waiting);
+  sigdelset(&waiting, SIGWINCH);
 
-  // gra się odbywa, terminal jest ok
   struct termios oldt, newt;
   tcgetattr(STDIN_FILENO, &oldt);
   newt = oldt;
   newt.c_lflag &= ~(ICANON|ECHO|ECHOK|ECHOE|ECHONL|ISIG|IEXTEN);
   tcsetattr(STDIN_FILENO, TCSANOW, &newt);
 
+  renderer_t renderer;
+  renderer_init(&renderer, game);
+
   while (game_over == false) {
+    gamma_player_stats_t stats;
+    gamma_player_stats(game, current_player, 1, true, &stats);
+
     // omijamy gracza, bo nie może zrobić ruchu
-    if (gamma_free_fields(game, current_player) == 0 &&
-      gamma_golden_possible(game, current_player) == false) {
+    if (stats.free_fields == 0 && stats.golden_possible == false) {
 
       failed_rounds++;
       if (failed_rounds == number_of_players) {
@@ -324,124 +2255,21 @@ void interactive_mode(gamma_t *game) {
       bool move_done = false;
       int arrow = 0;
       while (move_done == false) {
-        printf("\x1b[2J");
-        printf("\x1b[H");
-        // wyśweitlanie planszy z kolorowaniem pól gracza, która ma ruch
-        // i podświetlaniem kursora dla wielocyfrowej planszy
-        char *state_of_game = gamma_board(game);
-        // plasza z więcej niż 9 graczami
-        if (return_players(game) > 9) {
-          uint64_t i = 0;
-          while (state_of_game[i] != '\0') {
-            if (state_of_game[i] == ' ' || state_of_game[i] == '.' ||
-              state_of_game[i] == '\n') {
-              // kursor na pustym polu
-              if (state_of_game[i] == '.' &&
-                i % (return_width(game) * (length_of_number + 1) + 1)
-                == y_coordinate_cursor - 1 &&
-                i / (return_width(game) * (length_of_number + 1) + 1)
-                == x_coordinate_cursor - 1) {
-
-                printf("\033[1;45m");
-                printf("%c", state_of_game[i]);
-                printf("\033[0m");
-              }
-              else {
-                printf("\033[0m");
-                printf("%c", state_of_game[i]);
-              }
-              i++;
-            }
-            else {
-              uint32_t player_on_this_place = 0;
-              while (state_of_game[i] != ' ' && state_of_game[i] != '.' &&
-                state_of_game[i] != '\n') {
-
-                player_on_this_place = player_on_this_place * 10;
-                player_on_this_place = player_on_this_place +
-                  state_of_game[i] - '0';
-                i++;
-              }
-              // kursor na polu zajętym przez gracza, który ma ruch
-              if (player_on_this_place == current_player &&
-                (i - 1) % (return_width(game) * (length_of_number + 1) + 1)
-                == y_coordinate_cursor - 1 &&
-                (i - 1) / (return_width(game) * (length_of_number + 1) + 1)
-                == x_coordinate_cursor - 1) {
-
-                printf("\033[1;36;45m");
-              }
-              else {
-                // pole zajęte przez gracza, który ma ruch
-                if (player_on_this_place == current_player) {
-                  printf("\033[1;36m");
-                }
-                // pole z kursorem
-                if ((i - 1) % (return_width(game) * (length_of_number + 1)
-                + 1) == y_coordinate_cursor - 1 &&
-                (i - 1) / (return_width(game) * (length_of_number + 1)
-                +1) == x_coordinate_cursor - 1) {
-
-                  printf("\033[1;45m");
-                }
-              }
-              printf("%u", player_on_this_place);
-            }
-          }
-        }
-        // plansza z max 9 graczami
-        else {
-          uint64_t i = 0;
-          while (state_of_game[i] != '\0') {
-            if (state_of_game[i] == ' ' || state_of_game[i] == '.' ||
-              state_of_game[i] == '\n') {
-
-              printf("%c", state_of_game[i]);
-              i++;
-            }
-            else {
-              uint32_t player_on_this_place = state_of_game[i] - '0';
-              if (current_player == player_on_this_place) {
-                printf("\033[1;36m");
-                printf("%c", state_of_game[i]);
-                printf("\033[0m");
-                i++;
-              }
-              else {
-                printf("%c", state_of_game[i]);
-                i++;
-              }
-            }
+        render_frame(&renderer, game, current_player,
+          x_coordinate, y_coordinate);
+        while (!input_wait(&input, &waiting)) {
+          if (terminal_resized) {
+            terminal_resized = 0;
+            renderer_resize(&renderer);
+            render_frame(&renderer, game, current_player,
+              x_coordinate, y_coordinate);
           }
         }
-        free(state_of_game);
-        printf("\033[0;36m");
-        printf("PLAYER ");
-        printf("%u", current_player);
-        printf(" ");
-        printf("\033[1;36m");
-        printf("%lu", return_fields_taken(game, current_player));
-        printf(" ");
-        if (gamma_golden_possible(game, current_player) == true) {
-          printf("\033[1;32m");
-          printf("%lu", return_free_fields_around(game, current_player));
-          printf("\033[1;33m");
-          printf(" G\n");
-        }
-        else {
-          printf("\033[1;32m");
-          printf("%lu\n", return_free_fields_around(game, current_player));
-        }
-        printf("\033[0m");
 
-        printf("\033[?25h");
-        printf("\033[%d;%dH", x_coordinate_cursor, y_coordinate_cursor);
-        if (return_players(game) > 9) {
-          printf("\033[?25l");
-        }
-        int c = getchar();
+        int c = input_getc(&input);
         if (c == EOF) {
           tcsetattr(STDIN_FILENO, TCSANOW, &oldt);
+          renderer_free(&renderer);
           gamma_delete(game);
           exit(1);
         }
@@ -484,40 +2312,24 @@ void interactive_mode(gamma_t *game) {
                     if (arrow == 2 && c == 'A') {
                       if (y_coordinate != (return_height(game) - 1)) {
                         y_coordinate++;
-                        x_coordinate_cursor--;
                       }
                     }
 
                     if (arrow == 2 && c == 'B') {
                       if (y_coordinate != 0) {
                         y_coordinate--;
-                        x_coordinate_cursor++;
                       }
                     }
 
                     if (arrow == 2 && c == 'C') {
                       if (x_coordinate != (return_width(game) - 1)) {
                         x_coordinate++;
-                        if (length_of_number == 1) {
-                          y_coordinate_cursor++;
-                        }
-                        else {
-                          y_coordinate_cursor = y_coordinate_cursor +
-                            length_of_number + 1;
-                        }
                       }
                     }
 
                     if (arrow == 2 && c == 'D') {
                       if (x_coordinate != 0) {
                         x_coordinate--;
-                        if (length_of_number == 1) {
-                          y_coordinate_cursor--;
-                        }
-                        else {
-                          y_coordinate_cursor = y_coordinate_cursor -
-                            length_of_number - 1;
-                        }
                       }
                     }
 
@@ -529,8 +2341,6 @@ void interactive_mode(gamma_t *game) {
           }
         }
       }
-
-      printf("\033[?25l");
     }
 
     if (current_player == number_of_players) {
@@ -541,39 +2351,62 @@ void interactive_mode(gamma_t *game) {
     }
   }
 
-  // koniec trybu interaktywnego, wyświetlenie końcowej planszy
-  printf("\x1b[2J");
-  printf("\x1b[H");
-  char *result = gamma_board(game);
-  printf("%s", result);
-  free(result);
-  // szukanie zwycięscy/zwycięsców
+  // koniec trybu interaktywnego, wyświetlenie końcowej planszy, a jeśli
+  // nie mieści się w terminalu, zostawiamy ostatnie okno nad podsumowaniem
+  bool fits = renderer_fits(&renderer);
+  uint32_t status_row = renderer.view_rows + 1;
+  renderer_free(&renderer);
+  if (fits) {
+    printf("\x1b[2J");
+    printf("\x1b[H");
+    char *result = gamma_board(game);
+    printf("%s", result);
+    free(result);
+  }
+  else {
+    printf("\x1b[%" PRIu32 ";1H\x1b[J", status_row);
+  }
+  // szukanie zwycięscy/zwycięsców, statystyki pobieramy paczkami, bez
+  // sprawdzania złotych ruchów
+  gamma_player_stats_t stats[SUMMARY_CHUNK];
   uint64_t max_fields_taken = 0;
-  for (uint32_t i = 1; i <= number_of_players; i++) {
-    if (return_fields_taken(game, i) > max_fields_taken) {
-      max_fields_taken = return_fields_taken(game, i);
+  for (uint32_t first = 1; first <= number_of_players;
+    first += SUMMARY_CHUNK) {
+
+    uint32_t count = gamma_player_stats(game, first, SUMMARY_CHUNK, false,
+      stats);
+    for (uint32_t i = 0; i < count; i++) {
+      if (stats[i].busy_fields > max_fields_taken) {
+        max_fields_taken = stats[i].busy_fields;
+      }
     }
   }
   // końcowe podsumowanie
-  for (uint32_t i = 1; i <= number_of_players; i++) {
-    if (return_fields_taken(game, i) < max_fields_taken) {
-      printf("\033[0;31m");
-    }
-    else {
-      printf("\033[1;32m");
-    }
-    printf("PLAYER ");
-    printf("%u", i);
-    printf(" ");
-    if (return_fields_taken(game, i) < max_fields_taken) {
-      printf("%lu\n", return_fields_taken(game, i));
-    }
-    else {
-      printf("%lu", return_fields_taken(game, i));
-      printf("\033[1;33m");
-      printf(" VICTORY\n");
+  for (uint32_t first = 1; first <= number_of_players;
+    first += SUMMARY_CHUNK) {
+
+    uint32_t count = gamma_player_stats(game, first, SUMMARY_CHUNK, false,
+      stats);
+    for (uint32_t i = 0; i < count; i++) {
+      if (stats[i].busy_fields < max_fields_taken) {
+        printf("\033[0;31m");
+      }
+      else {
+        printf("\033[1;32m");
+      }
+      printf("PLAYER ");
+      printf("%u", first + i);
+      printf(" ");
+      if (stats[i].busy_fields < max_fields_taken) {
+        printf("%" PRIu64 "\n", stats[i].busy_fields);
+      }
+      else {
+        printf("%" PRIu64, stats[i].busy_fields);
+        printf("\033[1;33m");
+        printf(" VICTORY\n");
+      }
+      printf("\033[0m");
     }
-    printf("\033[0m");
   }
   printf("\033[?25h");
   tcsetattr(STDIN_FILENO, TCSANOW, &oldt);
@@ -581,184 +2414,340 @@ void interactive_mode(gamma_t *game) {
   return;
 }
 
+/** @brief Przeprowadza rozgrywkę zapisaną w binarnym skrypcie.
+ * Błędny nagłówek i ucięty ostatni rekord są zgłaszane na wyjściu błędów
+ * tak jak błędne linijki, rekordy numerujemy od 2, nagłówek ma numer 1.
+ * @return Zero, gdy gra przebiegła poprawnie, a 1, gdy nagłówek jest
+ * błędny lub nie udało się utworzyć gry.
+ */
+static int binary_mode(void) {
+  unsigned char header[BINARY_HEADER_SIZE];
+  unsigned char record[BINARY_RECORD_SIZE];
+  unsigned long long int record_number = 2;
+  gamma_t *game = NULL;
+  size_t size;
+
+  if (input_bytes(&input, header, BINARY_HEADER_SIZE) == BINARY_HEADER_SIZE &&
+    memcmp(header, BINARY_MAGIC, 4) == 0) {
+
+    game = gamma_new(load_u32(header + 4), load_u32(header + 8),
+      load_u32(header + 12), load_u32(header + 16));
+  }
+  if (game == NULL) {
+    output_error(&output, 1);
+    return 1;
+  }
+
+  while ((size = input_bytes(&input, record, BINARY_RECORD_SIZE)) ==
+    BINARY_RECORD_SIZE) {
+
+    command_t command;
+    command.letter = record[0];
+    command.numbers[0] = load_u32(record + 4);
+    command.numbers[1] = load_u32(record + 8);
+    command.numbers[2] = load_u32(record + 12);
+
+    execute_command(game, &command, true, record_number);
+    record_number++;
+  }
+  if (size != 0) {
+    output_error(&output, record_number);
+  }
+
+  gamma_delete(game);
+  return 0;
+}
+
+/** @brief Zamienia tekstowy skrypt trybu wsadowego na binarny.
+ * Komentarze i puste linijki są pomijane, błędne linijki przed poleceniem
+ * B są zgłaszane na wyjściu błędów, a po nim stają się rekordami
+ * z nieznaną literą polecenia, więc wyniki obu skryptów odpowiadają sobie.
+ * Numery w komunikatach OK i ERROR odpowiadają sobie tylko wtedy, gdy skrypt
+ * zaczyna się od polecenia B i nie ma komentarzy ani pustych linijek.
+ * @return Zero, gdy skrypt zawierał polecenie B, a 1 w przeciwnym
+ * przypadku.
+ */
+static int encode_script(void) {
+  unsigned long long int line_number = 1;
+  bool header = false;
+
+  while (true) {
+    const char *line;
+    uint64_t char_number;
+    command_t command;
+    unsigned char bytes[BINARY_RECORD_SIZE] = { 0 };
+
+    int c = input_line(&input, &line, &char_number);
+    if (c == INPUT_NO_MEMORY) {
+      exit(1);
+    }
+
+    if (char_number != 0 && line[0] != '#') {
+      if (!header) {
+        // gamma_new odrzuca zerowe parametry, więc tryb wsadowy szuka wtedy
+        // kolejnego polecenia B
+        if (c == '\n' && parse_command(line, char_number, "B", &command) &&
+          command.numbers[0] != 0 && command.numbers[1] != 0 &&
+          command.numbers[2] != 0 && command.numbers[3] != 0) {
+
+          memcpy(bytes, BINARY_MAGIC, 4);
+          for (uint8_t i = 0; i < 4; i++) {
+            store_le(bytes + 4 + 4 * i, command.numbers[i], 4);
+          }
+          output_chars(&output, STDOUT_FILENO, (char*)bytes,
+            BINARY_HEADER_SIZE);
+          header = true;
+        }
+        else {
+          output_error(&output, line_number);
+        }
+      }
+      else {
+        // linijka bez znaku końca linii jest błędna w trybie wsadowym
+        if (c == '\n' &&
+          parse_command(line, char_number, BATCH_COMMANDS, &command)) {
+
+          bytes[0] = command.letter;
+          for (uint8_t i = 0; i < command.count; i++) {
+            store_le(bytes + 4 + 4 * i, command.numbers[i], 4);
+          }
+        }
+        output_chars(&output, STDOUT_FILENO, (char*)bytes,
+          BINARY_RECORD_SIZE);
+      }
+    }
+
+    if (c == EOF) {
+      return header ? 0 : 1;
+    }
+    line_number++;
+  }
+}
+
+/** @brief Zamienia binarny skrypt trybu wsadowego na tekstowy.
+ * Rekord z nieznaną literą polecenia staje się błędną linijką "?",
+ * a ucięty ostatni rekord linijką "?" bez znaku końca linii.
+ * @return Zero, gdy nagłówek był poprawny, a 1 w przeciwnym przypadku.
+ */
+static int decode_script(void) {
+  unsigned char header[BINARY_HEADER_SIZE];
+  unsigned char record[BINARY_RECORD_SIZE];
+  char line[64];
+  size_t size;
+
+  if (input_bytes(&input, header, BINARY_HEADER_SIZE) != BINARY_HEADER_SIZE ||
+    memcmp(header, BINARY_MAGIC, 4) != 0) {
+
+    output_error(&output, 1);
+    return 1;
+  }
+  size = sprintf(line, "B %" PRIu32 " %" PRIu32 " %" PRIu32 " %" PRIu32 "\n",
+    load_u32(header + 4), load_u32(header + 8), load_u32(header + 12),
+    load_u32(header + 16));
+  output_chars(&output, STDOUT_FILENO, line, size);
+
+  while ((size = input_bytes(&input, record, BINARY_RECORD_SIZE)) ==
+    BINARY_RECORD_SIZE) {
+
+    char letter = record[0];
+
+    if (letter == 'm' || letter == 'g') {
+      size = sprintf(line, "%c %" PRIu32 " %" PRIu32 " %" PRIu32 "\n", letter,
+        load_u32(record + 4), load_u32(record + 8), load_u32(record + 12));
+    }
+    else if (letter == 'b' || letter == 'f' || letter == 'q') {
+      size = sprintf(line, "%c %" PRIu32 "\n", letter, load_u32(record + 4));
+    }
+    else if (letter == 'p' || letter == 's' || letter == 'c') {
+      size = sprintf(line, "%c\n", letter);
+    }
+    else {
+      size = sprintf(line, "?\n");
+    }
+    output_chars(&output, STDOUT_FILENO, line, size);
+  }
+  if (size != 0) {
+    output_chars(&output, STDOUT_FILENO, "?", 1);
+  }
+  return 0;
+}
+
 /** @brief Przeprowadza grę w gamma.
  * Wczytuje wejście decydując czy tryb gry jest wsadowy czy interaktywny
- * następnie przeprowadza rozgrywkę w wybranym trybie.
+ * następnie przeprowadza rozgrywkę w wybranym trybie. Opcje:
+ * -f plik   wejście jest czytane z pliku zamiast ze standardowego wejścia,
+ * -b        wejście jest binarnym skryptem trybu wsadowego,
+ * -e        zamienia tekstowy skrypt trybu wsadowego na binarny; komentarze,
+ *           puste linijki i linijki przed poleceniem B nie trafiają do
+ *           skryptu binarnego, więc numery w komunikatach ERROR trybu -b
+ *           oraz OK i ERROR skryptu zamienionego z powrotem przez -d są
+ *           numerami rekordów, a nie linijek pierwotnego skryptu,
+ * -d        zamienia binarny skrypt trybu wsadowego na tekstowy,
+ * -P        tryb wsadowy działa potokowo w trzech wątkach,
+ * -M        każde polecenie B zaczyna nową grę, gry są rozgrywane
+ *           równolegle, a ich wyniki wypisywane w kolejności wejścia,
+ * --profile mierzy czas każdego polecenia trybu wsadowego i na koniec
+ *           wypisuje na wyjście błędów percentyle czasów i numery linijek
+ *           najwolniejszych poleceń,
+ * --trace plik  przy wyjściu zapisuje ślad operacji silnika w formacie
+ *           Chrome trace, jeśli silnik zbudowano z GAMMA_TRACE.
+ * @param[in] argc    – liczba argumentów programu,
+ * @param[in] argv    – argumenty programu.
  * @return Zero, gdy gra przebiegła poprawnie,
  * a w przeciwnym przypadku kod zakończenia programu jest kodem błędu.
  */
-int main() {
+int main(int argc, char *argv[]) {
   bool batch = false;
   bool interactive = false;
   unsigned long long int line_number = 1;
-  gamma_t *game;
+  gamma_t *game = NULL;
 
-  // sprawdzanie czy tryb gry jest interaktywny czy wsadowy
-  while (batch == false && interactive == false) {
-    char *line = NULL;
-    uint64_t char_number = 0;
-    uint64_t allocated_chars_number = 1;
-    int c = '0';
+  atexit(output_flush_at_exit);
 
-    // wzięcie linijki
-    while (c != '\n' && c != EOF) {
-      c = getchar();
-
-      if (c != '\n' && c != EOF) {
-        if (char_number == 0) {
-          line = malloc(sizeof (char));
-          if (!line) {
-            exit(1);
-          }
-        }
+  int option;
+  int mode = 0;
+  const char *path = NULL;
+  bool pipelined = false;
+  static const struct option long_options[] = {
+    { "profile", no_argument, NULL, 'R' },
+    { "trace", required_argument, NULL, 'T' },
+    { NULL, 0, NULL, 0 }
+  };
 
-        if (char_number == allocated_chars_number) {
-          allocated_chars_number = 2 * allocated_chars_number;
-          char *new_line = line =
-            realloc(line, allocated_chars_number *sizeof (char));
-          if (!new_line) {
-            free(line);
-            exit(1);
-          }
-          line = new_line;
-        }
+  while ((option = getopt_long(argc, argv, "bedf:PM", long_options, NULL))
+    != -1) {
 
-        line[char_number] = c;
-        char_number++;
+    if (option == 'f') {
+      path = optarg;
+    }
+    else if (option == 'T') {
+      if (trace_path == NULL) {
+        atexit(trace_at_exit);
       }
+      trace_path = optarg;
     }
-
-    // nasza linijka musi być stringiem, więc dodaje '\0'
-    if (char_number != 0) {
-      if (char_number == allocated_chars_number) {
-        allocated_chars_number = allocated_chars_number + 1;
-        char *new_line = line =
-          realloc(line, allocated_chars_number *sizeof (char));
-        if (!new_line) {
-          free(line);
+    else if (option == 'R') {
+      if (profile == NULL) {
+        profile = calloc(1, sizeof(profile_t));
+        if (profile == NULL) {
           exit(1);
         }
-        line = new_line;
+        atexit(profile_report);
       }
+    }
+    else if (option == 'P') {
+      pipelined = true;
+    }
+    else if (option == '?' || mode != 0) {
+      fprintf(stderr, "USAGE: %s [-b | -e | -d | -M | -P] [-f FILE] "
+        "[--profile] [--trace FILE]\n", argv[0]);
+      return 1;
+    }
+    else {
+      mode = option;
+    }
+  }
+  // tryb potokowy dotyczy tylko tekstowej rozgrywki wsadowej, więc nie
+  // łączy się z -b, -M, -e ani -d
+  if (optind != argc || (pipelined && mode != 0)) {
+    fprintf(stderr, "USAGE: %s [-b | -e | -d | -M | -P] [-f FILE] "
+      "[--profile] [--trace FILE]\n", argv[0]);
+    return 1;
+  }
+  if (path != NULL && !input_open(&input, path)) {
+    fprintf(stderr, "ERROR, CANNOT OPEN %s\n", path);
+    return 1;
+  }
+
+  if (mode != 0) {
+    int result;
+
+    if (mode == 'b') {
+      result = binary_mode();
+    }
+    else if (mode == 'M') {
+      multi_game_mode();
+      result = 0;
+    }
+    else if (mode == 'e') {
+      result = encode_script();
+    }
+    else {
+      result = decode_script();
+    }
+    input_close(&input);
+    return result;
+  }
+
+  // sprawdzanie czy tryb gry jest interaktywny czy wsadowy
+  while (batch == false && interactive == false) {
+    const char *line;
+    uint64_t char_number;
 
-      line[char_number] = '\0';
+    // wzięcie linijki
+    int c = input_line(&input, &line, &char_number);
+    if (c == INPUT_NO_MEMORY) {
+      exit(1);
     }
 
     // koniec pliku
     if (c == EOF) {
       if (char_number != 0) {
         if (line[0] != '#') {
-          free(line);
-          fprintf(stderr, "ERROR %llu\n", line_number);
-          return 0;
+          output_error(&output, line_number);
         }
       }
 
-      if (char_number != 0) {
-        free(line);
-      }
+      input_close(&input);
       return 0;
     }
 
     // koniec linii
     if (char_number != 0) {
       if (line[0] != '#') {
-        if (line[0] != 'B' && line[0] != 'I') {
-          fprintf(stderr, "ERROR %llu\n", line_number);
+        command_t command;
+
+        if (!parse_command(line, char_number, "BI", &command)) {
+          output_error(&output, line_number);
         }
         else {
-          // sprawdzanie czy mamy '\0' bo to "rozwala" strtok
-          bool broken_sign = false;
-          for (uint32_t i = 1; i < char_number; i++) {
-            if (line[i] == '\0') {
-              broken_sign = true;
-            }
-          }
+          game = gamma_new(command.numbers[0], command.numbers[1],
+            command.numbers[2], command.numbers[3]);
 
-          if (broken_sign == true) {
-            fprintf(stderr, "ERROR %llu\n", line_number);
+          if (game == NULL) {
+            output_error(&output, line_number);
           }
           else {
-            char *words[6];
-            words[0] = strtok (line," \t\v\f\r");
-            for (int i = 1; i < 6; i++) {
-              words[i] = strtok (NULL," \t\v\f\r");
-            }
-
-            if (words[4] == NULL || words[5] != NULL) {
-              fprintf(stderr, "ERROR %llu\n", line_number);   
+            if (command.letter == 'B') {
+              output_chars(&output, STDOUT_FILENO, "OK ", 3);
+              output_number(&output, STDOUT_FILENO, line_number);
+              batch = true;
             }
             else {
-              if (strcmp(words[0], "B") != 0 && strcmp(words[0], "I") != 0) {
-                fprintf(stderr, "ERROR %llu\n", line_number);
-              }
-              else {
-                uint32_t numbers[4];
-                bool error = false;
-
-                // sprawdzanie czy nasze słowa (poza pierwszym) są liczbami
-                char *not_numbers[4];
-                for (int i = 0; i < 4; i++) {
-                  if (error == false) {
-                    not_numbers[i] = strtok (words[i + 1],"0123456789");
-                    if (not_numbers[i] != NULL) {
-                      fprintf(stderr, "ERROR %llu\n", line_number);
-                      error = true;
-                    }
-                  }
-                }
-
-                for (int i = 0; i < 4; i++) {
-                  if (error == false) {
-                    unsigned long long tmp = strtoull(words[i + 1], NULL, 10);
-
-                    if (errno == ERANGE || tmp > UINT32_MAX) {
-                      fprintf(stderr, "ERROR %llu\n", line_number);
-                      error = true;
-                    }
-                    else {
-                      numbers[i] = tmp;
-                    }
-                  }
-                }
-
-                if (error == false) {
-                  game = gamma_new(numbers[0], numbers[1],
-                    numbers[2], numbers[3]);
-
-                  if (game == NULL) {
-                    fprintf(stderr, "ERROR %llu\n", line_number);
-                  }
-                  else {
-                    if (strcmp(words[0], "B") == 0) {
-                      printf("OK %llu\n", line_number);
-                      batch = true;
-                    }
-                    else {
-                      interactive = true;
-                    }
-                  }
-                }
-              }
+              interactive = true;
             }
           }
         }
       }
     }
 
-    if (char_number != 0) {
-      free(line);
-    }
     line_number++;
   }
 
   if (batch == true) {
-    batch_mode(game, line_number);
+    if (pipelined) {
+      pipelined_batch_mode(game, line_number);
+    }
+    else {
+      batch_mode(game, line_number);
+    }
   }
 
   if (interactive == true) {
+    output_flush(&output);
     interactive_mode(game);
   }
 
+  input_close(&input);
   return 0;
 }
@@ -11,11 +11,17 @@
 #undef NDEBUG
 #endif
 
+// pthread_barrier_t
+#define _GNU_SOURCE
+
 #include "gamma.h"
 #include <assert.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
 
 /**
  * Tak ma wyglądać plansza po wykonaniu wszystkich testów.
@@ -32,6 +38,1295 @@ static const char board[] =
   "1221......\n"
   "1.........\n";
 
+/** @brief Testuje rzadką planszę.
+ * Obie plansze mają więcej niż 2^26 pól, więc silnik trzyma tylko zajęte
+ * pola w tablicy haszującej.
+ */
+static void test_sparse(void) {
+  const uint64_t fields = UINT64_C(100000) * 100000;
+  gamma_t *g = gamma_new(100000, 100000, 3, 2);
+  assert(g != NULL);
+
+  assert(gamma_move(g, 1, 0, 0));
+  assert(gamma_move(g, 1, 99999, 99999));
+  assert(!gamma_move(g, 1, 50000, 50000));
+  assert(!gamma_move(g, 1, 100000, 0));
+  assert(!gamma_move(g, 2, 0, 0));
+  assert(gamma_busy_fields(g, 1) == 2);
+  assert(gamma_free_fields(g, 1) == 4);
+  assert(gamma_free_fields(g, 2) == fields - 2);
+  assert(gamma_move(g, 1, 1, 0));
+  assert(gamma_free_fields(g, 1) == 5);
+  assert(gamma_move(g, 2, 0, 1));
+  assert(gamma_free_fields(g, 1) == 4);
+  assert(gamma_free_fields(g, 2) == fields - 4);
+
+  assert(gamma_golden_possible(g, 2));
+  assert(gamma_golden_move(g, 2, 1, 0));
+  assert(gamma_busy_fields(g, 1) == 2);
+  assert(gamma_busy_fields(g, 2) == 2);
+  assert(gamma_free_fields(g, 1) == 2);
+  assert(gamma_free_fields(g, 2) == 3);
+  assert(!gamma_golden_move(g, 2, 0, 0));
+  assert(!gamma_golden_possible(g, 2));
+
+  assert(gamma_golden_possible(g, 3));
+  assert(gamma_golden_move(g, 3, 99999, 99999));
+  assert(gamma_busy_fields(g, 1) == 1);
+  assert(gamma_busy_fields(g, 3) == 1);
+  assert(gamma_free_fields(g, 1) == fields - 4);
+  assert(gamma_golden_possible(g, 1));
+  assert(gamma_golden_move(g, 1, 0, 1));
+  assert(gamma_busy_fields(g, 1) == 2);
+  assert(gamma_busy_fields(g, 2) == 1);
+  assert(gamma_free_fields(g, 2) == fields - 4);
+  gamma_delete(g);
+
+  // napis planszy: najmniejsza kwadratowa plansza powyżej progu
+  const uint32_t side = 8193;
+  const uint64_t line = side + 1;
+  g = gamma_new(side, side, 2, 1);
+  assert(g != NULL);
+  assert(gamma_move(g, 1, 0, 0));
+  assert(gamma_move(g, 1, 1, 0));
+  assert(gamma_move(g, 2, side - 1, side - 1));
+  assert(!gamma_move(g, 2, side - 1, 0));
+  assert(!gamma_golden_move(g, 2, 1, 0));
+  assert(!gamma_golden_move(g, 2, 0, 0));
+  assert(gamma_move(g, 2, side - 2, side - 1));
+
+  char *expected = malloc(line * side + 1);
+  assert(expected != NULL);
+  memset(expected, '.', line * side);
+  for (uint64_t i = 1; i <= side; i++) {
+    expected[i * line - 1] = '\n';
+  }
+  expected[line * side] = '\0';
+  // wiersz y jest w napisie (side - 1 - y)-ty od góry
+  expected[(side - 1) * line + 0] = '1';
+  expected[(side - 1) * line + 1] = '1';
+  expected[side - 2] = '2';
+  expected[side - 1] = '2';
+
+  char *p = gamma_board(g);
+  assert(p != NULL);
+  assert(strcmp(p, expected) == 0);
+  free(p);
+  free(expected);
+  gamma_delete(g);
+}
+
+/** @brief Podaje liczbę obszarów gracza.
+ * @param[in] g       – wskaźnik na strukturę przechowującą stan gry,
+ * @param[in] player  – numer gracza.
+ * @return Liczba obszarów zajętych przez gracza.
+ */
+static uint32_t areas_of(gamma_t *g, uint32_t player) {
+  gamma_player_stats_t stats;
+
+  assert(gamma_player_stats(g, player, 1, false, &stats) == 1);
+  return stats.areas;
+}
+
+/** @brief Testuje cofanie nieudanych złotych ruchów.
+ * Gracz 1 ma poziomą linię w wierszu 2 i pole (0, 0), gracz 2 – pola nad
+ * środkiem linii i pole (4, 0). Zabranie środkowego pola linii rozcina ją
+ * na dwa kawałki, czyli daje graczowi 1 trzeci obszar.
+ * Napisy planszy porównujemy tylko na małych planszach.
+ * @param[in] width   – szerokość planszy, co najmniej 5,
+ * @param[in] height  – wysokość planszy, co najmniej 5.
+ */
+static void test_golden_rollback(uint32_t width, uint32_t height) {
+  bool small = (uint64_t)width * height <= 1000;
+  gamma_t *g = gamma_new(width, height, 2, 2);
+  assert(g != NULL);
+
+  for (uint32_t x = 0; x < 5; x++) {
+    assert(gamma_move(g, 1, x, 2));
+  }
+  assert(gamma_move(g, 1, 0, 0));
+  assert(gamma_move(g, 2, 1, 3));
+  assert(gamma_move(g, 2, 2, 3));
+  assert(gamma_move(g, 2, 3, 3));
+  assert(gamma_move(g, 2, 4, 0));
+  assert(areas_of(g, 1) == 2);
+  assert(areas_of(g, 2) == 2);
+  char *before = small ? gamma_board(g) : NULL;
+  assert(before != NULL || !small);
+
+  // każda próba rozcina ten sam obszar i jest cofana
+  assert(!gamma_golden_possible(g, 2));
+  for (uint32_t round = 0; round < 3; round++) {
+    for (uint32_t x = 1; x < 4; x++) {
+      assert(!gamma_golden_move(g, 2, x, 2));
+    }
+  }
+  assert(gamma_busy_fields(g, 1) == 6);
+  assert(gamma_busy_fields(g, 2) == 4);
+  assert(areas_of(g, 1) == 2);
+  assert(areas_of(g, 2) == 2);
+  if (small) {
+    char *after = gamma_board(g);
+    assert(after != NULL);
+    assert(strcmp(before, after) == 0);
+    free(before);
+    free(after);
+  }
+
+  // find&union po cofnięciu jest spójne: ruchy stykające się z różnymi
+  // częściami linii nie zmniejszają liczby obszarów
+  for (uint32_t x = 1; x < 5; x++) {
+    assert(gamma_move(g, 1, x, 1));
+    assert(areas_of(g, 1) == 2);
+  }
+  assert(gamma_move(g, 1, 0, 1));
+  assert(areas_of(g, 1) == 1);
+
+  // teraz obszar gracza 1 nie rozpada się i złoty ruch się udaje
+  assert(gamma_golden_move(g, 2, 2, 2));
+  assert(gamma_busy_fields(g, 1) == 10);
+  assert(gamma_busy_fields(g, 2) == 5);
+  assert(areas_of(g, 1) == 1);
+  assert(areas_of(g, 2) == 2);
+  assert(!gamma_golden_move(g, 2, 1, 2));
+  gamma_delete(g);
+}
+
+/** @brief Sprawdza, na ile kawałków rozpada się obszar po złotym ruchu.
+ * Gracz 1 zajmuje podane pola, które tworzą jeden obszar, a gracz 2
+ * zabiera mu pole (x, y). Limit obszarów jest tak duży, że złoty ruch
+ * zawsze się udaje.
+ * @param[in] width   – szerokość planszy,
+ * @param[in] height  – wysokość planszy,
+ * @param[in] fields  – pola gracza 1, pierwsza współrzędna to kolumna,
+ * @param[in] count   – liczba pól gracza 1,
+ * @param[in] x       – numer kolumny zabieranego pola,
+ * @param[in] y       – numer wiersza zabieranego pola,
+ * @param[in] pieces  – oczekiwana liczba obszarów gracza 1 po ruchu.
+ * @return Wskaźnik na stan gry po złotym ruchu.
+ */
+static gamma_t *check_steal(uint32_t width, uint32_t height,
+  const uint32_t fields[][2], uint32_t count, uint32_t x, uint32_t y,
+  uint32_t pieces) {
+
+  gamma_t *g = gamma_new(width, height, 2, count);
+  assert(g != NULL);
+
+  for (uint32_t i = 0; i < count; i++) {
+    assert(gamma_move(g, 1, fields[i][0], fields[i][1]));
+  }
+  assert(areas_of(g, 1) == 1);
+  assert(gamma_golden_move(g, 2, x, y));
+  assert(areas_of(g, 1) == pieces);
+  assert(areas_of(g, 2) == 1);
+  assert(gamma_busy_fields(g, 1) == count - 1);
+  assert(gamma_busy_fields(g, 2) == 1);
+  return g;
+}
+
+/** @brief Testuje rozpadanie się obszaru po złotym ruchu.
+ * Zabrane pole ma od 2 do 4 sąsiadów gracza 1, także na brzegu planszy
+ * i na planszach o szerokości lub wysokości 1.
+ * @param[in] width   – szerokość planszy, co najmniej 5,
+ * @param[in] height  – wysokość planszy, co najmniej 5.
+ */
+static void test_steal_split(uint32_t width, uint32_t height) {
+  // krzyż wokół pola (2, 2) rozpada się na 4 ramiona
+  static const uint32_t cross[][2] = {
+    {2, 2}, {1, 2}, {3, 2}, {2, 1}, {2, 3}
+  };
+  gamma_t *g = check_steal(width, height, cross, 5, 2, 2, 4);
+  // ramiona są osobnymi obszarami, dopóki ich nie połączymy
+  assert(gamma_move(g, 1, 1, 1));
+  assert(areas_of(g, 1) == 3);
+  assert(gamma_move(g, 1, 3, 1));
+  assert(areas_of(g, 1) == 2);
+  assert(gamma_move(g, 1, 3, 3));
+  assert(areas_of(g, 1) == 1);
+  assert(gamma_move(g, 1, 1, 3));
+  assert(areas_of(g, 1) == 1);
+  gamma_delete(g);
+
+  // krzyż bez jednego ramienia rozpada się na 3 kawałki
+  gamma_delete(check_steal(width, height, cross, 4, 2, 2, 3));
+
+  // dwa ramiona połączone przez róg są jednym kawałkiem
+  static const uint32_t cross_corner[][2] = {
+    {2, 2}, {1, 2}, {3, 2}, {2, 1}, {2, 3}, {1, 1}
+  };
+  gamma_delete(check_steal(width, height, cross_corner, 6, 2, 2, 3));
+
+  // pozioma linia rozpada się na 2 kawałki
+  static const uint32_t line[][2] = {{1, 2}, {2, 2}, {3, 2}};
+  gamma_delete(check_steal(width, height, line, 3, 2, 2, 2));
+
+  // pierścień wokół pola (2, 2) z zabranym bokiem pozostaje w całości
+  static const uint32_t ring[][2] = {
+    {1, 1}, {2, 1}, {3, 1}, {3, 2}, {3, 3}, {2, 3}, {1, 3}, {1, 2}
+  };
+  gamma_delete(check_steal(width, height, ring, 8, 2, 1, 1));
+
+  // brzeg planszy: pole (0, 2) ma tylko trzech sąsiadów
+  static const uint32_t edge[][2] = {{0, 2}, {0, 1}, {0, 3}, {1, 2}};
+  gamma_delete(check_steal(width, height, edge, 4, 0, 2, 3));
+
+  // róg planszy: pole (0, 0) ma tylko dwóch sąsiadów
+  static const uint32_t corner[][2] = {{0, 0}, {1, 0}, {0, 1}};
+  gamma_delete(check_steal(width, height, corner, 3, 0, 0, 2));
+
+  // przeciwległy róg planszy
+  const uint32_t far[][2] = {
+    {width - 1, height - 1}, {width - 2, height - 1}, {width - 1, height - 2}
+  };
+  gamma_delete(check_steal(width, height, far, 3, width - 1, height - 1, 2));
+
+  // plansze 1xN i Nx1: środek linii rozcina ją, koniec linii nie
+  static const uint32_t column[][2] = {{0, 0}, {0, 1}, {0, 2}, {0, 3}};
+  static const uint32_t row[][2] = {{0, 0}, {1, 0}, {2, 0}, {3, 0}};
+  gamma_delete(check_steal(1, height, column, 4, 0, 2, 2));
+  gamma_delete(check_steal(1, height, column, 4, 0, 0, 1));
+  gamma_delete(check_steal(width, 1, row, 4, 1, 0, 2));
+  gamma_delete(check_steal(width, 1, row, 4, 3, 0, 1));
+}
+
+/** @brief Testuje wykonywanie paczki ruchów.
+ * Niepoprawne rekordy w środku paczki dają wyzerowany bit i nie przerywają
+ * wykonywania kolejnych ruchów.
+ * @param[in] width   – szerokość planszy, co najmniej 3,
+ * @param[in] height  – wysokość planszy, co najmniej 3.
+ */
+static void test_apply_moves(uint32_t width, uint32_t height) {
+  const gamma_move_record_t moves[] = {
+    { GAMMA_MOVE_NORMAL, 1, 0, 0 },      // wykonany
+    { GAMMA_MOVE_NORMAL, 2, 0, 0 },      // pole zajęte
+    { GAMMA_MOVE_NORMAL, 0, 1, 1 },      // gracz 0
+    { GAMMA_MOVE_NORMAL, 3, 1, 1 },      // za duży numer gracza
+    { GAMMA_MOVE_NORMAL, 2, width, 0 },  // poza planszą
+    { 7, 2, 1, 1 },                      // nieznany rodzaj ruchu
+    { GAMMA_MOVE_NORMAL, 2, 1, 1 },      // wykonany
+    { GAMMA_MOVE_NORMAL, 1, 2, 2 },      // drugi obszar przy limicie 1
+    { GAMMA_MOVE_NORMAL, 1, 1, 0 },      // wykonany
+    { GAMMA_MOVE_GOLDEN, 2, 1, 0 },      // wykonany
+    { GAMMA_MOVE_GOLDEN, 2, 0, 0 },      // złoty ruch już wykorzystany
+    { GAMMA_MOVE_GOLDEN, 1, 0, height }, // poza planszą
+    { GAMMA_MOVE_NORMAL, 1, 0, 1 }       // wykonany
+  };
+  const uint64_t count = sizeof(moves) / sizeof(moves[0]);
+  uint8_t results[3] = { 0xff, 0xff, 0xaa };
+
+  gamma_t *g = gamma_new(width, height, 2, 1);
+  assert(g != NULL);
+  assert(gamma_apply_moves(NULL, moves, count, results) == 0);
+  assert(gamma_apply_moves(g, NULL, count, results) == 0);
+  assert(gamma_apply_moves(g, moves, 0, results) == 0);
+  assert(results[0] == 0xff);
+
+  assert(gamma_apply_moves(g, moves, count, results) == 5);
+  assert(results[0] == 0x41);
+  assert(results[1] == 0x13);
+  assert(results[2] == 0xaa);
+  assert(gamma_busy_fields(g, 1) == 2);
+  assert(gamma_busy_fields(g, 2) == 2);
+  assert(!gamma_golden_possible(g, 2));
+  gamma_delete(g);
+
+  // bez mapy bitowej wynik jest taki sam
+  g = gamma_new(width, height, 2, 1);
+  assert(g != NULL);
+  assert(gamma_apply_moves(g, moves, count, NULL) == 5);
+  assert(gamma_busy_fields(g, 1) == 2);
+  assert(gamma_busy_fields(g, 2) == 2);
+  gamma_delete(g);
+}
+
+/** @brief Sprawdza statystyki jednego gracza.
+ * Porównuje je też z wynikami pojedynczych funkcji silnika.
+ * @param[in] g           – wskaźnik na strukturę przechowującą stan gry,
+ * @param[in] player      – numer gracza,
+ * @param[in] busy_fields – oczekiwana liczba pól zajętych,
+ * @param[in] free_fields – oczekiwana liczba pól, jakie gracz może zająć,
+ * @param[in] areas       – oczekiwana liczba obszarów,
+ * @param[in] golden      – czy gracz może wykonać złoty ruch.
+ */
+static void check_stats(gamma_t *g, uint32_t player, uint64_t busy_fields,
+  uint64_t free_fields, uint32_t areas, bool golden) {
+
+  gamma_player_stats_t stats;
+
+  assert(gamma_player_stats(g, player, 1, true, &stats) == 1);
+  assert(stats.busy_fields == busy_fields);
+  assert(stats.free_fields == free_fields);
+  assert(stats.areas == areas);
+  assert(stats.golden_possible == golden);
+  assert(gamma_busy_fields(g, player) == busy_fields);
+  assert(gamma_free_fields(g, player) == free_fields);
+  assert(gamma_golden_possible(g, player) == golden);
+}
+
+/** @brief Testuje statystyki graczy po zwykłych i złotych ruchach.
+ * Gracz 1 ma dwa obszary przy limicie 2, więc może zająć tylko pola
+ * sąsiednie. Złoty ruch gracza 3 zabiera mu pole (1, 0), po czym gracz 1
+ * może je odebrać, bo łączy się ono z jego polem (0, 0).
+ * @param[in] width   – szerokość planszy, co najmniej 5,
+ * @param[in] height  – wysokość planszy, co najmniej 5.
+ */
+static void test_player_stats(uint32_t width, uint32_t height) {
+  uint64_t fields = (uint64_t)width * height;
+  gamma_player_stats_t stats[3];
+
+  gamma_t *g = gamma_new(width, height, 3, 2);
+  assert(g != NULL);
+  assert(gamma_player_stats(NULL, 1, 3, true, stats) == 0);
+  assert(gamma_player_stats(g, 1, 3, true, NULL) == 0);
+  assert(gamma_player_stats(g, 0, 3, true, stats) == 0);
+  assert(gamma_player_stats(g, 4, 1, true, stats) == 0);
+
+  // liczba statystyk nie wychodzi poza ostatniego gracza
+  assert(gamma_player_stats(g, 2, 10, true, stats) == 2);
+  for (uint32_t i = 0; i < 2; i++) {
+    assert(stats[i].busy_fields == 0);
+    assert(stats[i].free_fields == fields);
+    assert(stats[i].areas == 0);
+    assert(!stats[i].golden_possible);
+  }
+
+  assert(gamma_move(g, 1, 0, 0));
+  assert(gamma_move(g, 1, 1, 0));
+  assert(gamma_move(g, 1, 3, 3));
+  assert(gamma_move(g, 2, 4, 4));
+  check_stats(g, 1, 3, 7, 2, false);
+  check_stats(g, 2, 1, fields - 4, 1, true);
+  check_stats(g, 3, 0, fields - 4, 0, true);
+
+  assert(gamma_golden_move(g, 3, 1, 0));
+  check_stats(g, 1, 2, 5, 2, true);
+  check_stats(g, 2, 1, fields - 4, 1, true);
+  check_stats(g, 3, 1, fields - 4, 1, false);
+
+  // cała tablica naraz daje to samo co pojedyncze wywołania
+  assert(gamma_player_stats(g, 1, 3, true, stats) == 3);
+  assert(stats[0].busy_fields == 2 && stats[0].areas == 2);
+  assert(stats[1].busy_fields == 1 && stats[1].golden_possible);
+  assert(stats[2].free_fields == fields - 4 && !stats[2].golden_possible);
+
+  // bez złotych ruchów reszta statystyk jest taka sama, a golden_possible
+  // jest false
+  gamma_player_stats_t counters[3];
+  assert(gamma_player_stats(g, 1, 3, false, counters) == 3);
+  for (uint32_t i = 0; i < 3; i++) {
+    assert(counters[i].busy_fields == stats[i].busy_fields);
+    assert(counters[i].free_fields == stats[i].free_fields);
+    assert(counters[i].areas == stats[i].areas);
+    assert(!counters[i].golden_possible);
+  }
+  gamma_delete(g);
+}
+
+/** @brief Testuje złote ruchy wielu graczy sprawdzane naraz.
+ * Gracze 1 i 3 mają po polu obok kwadratów 2x2 graczy 2 i 4 przy limicie
+ * jednego obszaru, więc rozstrzyga ich dopiero poziom 3, a graczy 2 i 4
+ * poziom 2. Statystyki bez złotych ruchów nie sprawdzają żadnego poziomu.
+ * @param[in] width   – szerokość planszy, co najmniej 5,
+ * @param[in] height  – wysokość planszy, co najmniej 5.
+ */
+static void test_player_stats_range(uint32_t width, uint32_t height) {
+  gamma_player_stats_t stats[4];
+
+  gamma_t *g = gamma_new(width, height, 4, 1);
+  assert(g != NULL);
+  for (uint32_t y = 0; y < 4; y += 3) {
+    uint32_t player = 1 + 2 * (y != 0);
+
+    assert(gamma_move(g, player, 1, y));
+    assert(gamma_move(g, player + 1, 2, y));
+    assert(gamma_move(g, player + 1, 3, y));
+    assert(gamma_move(g, player + 1, 2, y + 1));
+    assert(gamma_move(g, player + 1, 3, y + 1));
+  }
+
+  assert(gamma_player_stats(g, 1, 4, false, stats) == 4);
+  for (uint32_t tier = 0; tier < GAMMA_GOLDEN_TIERS; tier++) {
+    assert(return_golden_tier_hits(g, tier) == 0);
+  }
+
+  assert(gamma_player_stats(g, 1, 4, true, stats) == 4);
+  for (uint32_t i = 0; i < 4; i++) {
+    assert(stats[i].golden_possible);
+  }
+  assert(return_golden_tier_hits(g, 2) == 2);
+  assert(return_golden_tier_hits(g, 3) == 2);
+#ifdef GAMMA_STATS
+  // indeks punktów artykulacji przebudowany raz dla obu graczy
+  gamma_stats_t counters;
+  assert(gamma_stats(g, &counters));
+  assert(counters.split_rebuilds == 1);
+#endif
+
+  // odpowiedzi zostały zapamiętane
+  assert(gamma_player_stats(g, 1, 4, true, stats) == 4);
+  assert(return_golden_tier_hits(g, 1) == 4);
+  gamma_delete(g);
+}
+
+#ifdef GAMMA_BINARY
+/** @brief Uruchamia potok poleceń powłoki z programem gamma.
+ * W potoku program gamma jest dostępny jako "$GAMMA".
+ * @param[in] input    – polecenia przekazywane na wejście potoku,
+ *                       bez apostrofów,
+ * @param[in] pipeline – potok poleceń powłoki,
+ * @param[in] errors   – czy zebrać wyjście błędów zamiast standardowego,
+ * @param[out] got     – bufor na zebrane wyjście,
+ * @param[in] size     – rozmiar bufora.
+ * @return Kod zakończenia ostatniego polecenia potoku.
+ */
+static int run_pipeline(const char *input, const char *pipeline, bool errors,
+  char *got, size_t size) {
+
+  char command[512];
+
+  assert(setenv("GAMMA", GAMMA_BINARY, 1) == 0);
+  int length = snprintf(command, sizeof(command), "printf '%s' | { %s; } %s",
+    input, pipeline, errors ? "2>&1 >/dev/null" : "2>/dev/null");
+  assert(length > 0 && (size_t)length < sizeof(command));
+
+  FILE *program = popen(command, "r");
+  assert(program != NULL);
+  size_t read = fread(got, 1, size - 1, program);
+  got[read] = '\0';
+  int status = pclose(program);
+  assert(status != -1 && WIFEXITED(status));
+  return WEXITSTATUS(status);
+}
+
+/** @brief Uruchamia program gamma w trybie wsadowym.
+ * @param[in] input    – polecenia przekazywane na wejście programu,
+ *                       bez apostrofów,
+ * @param[in] errors   – czy zebrać wyjście błędów zamiast standardowego,
+ * @param[out] got     – bufor na zebrane wyjście,
+ * @param[in] size     – rozmiar bufora.
+ */
+static void run_batch(const char *input, bool errors, char *got,
+  size_t size) {
+
+  assert(run_pipeline(input, "\"$GAMMA\"", errors, got, size) == 0);
+}
+
+/** @brief Sprawdza wyjście potoku poleceń powłoki z programem gamma.
+ * @param[in] input    – polecenia przekazywane na wejście potoku,
+ *                       bez apostrofów,
+ * @param[in] pipeline – potok poleceń powłoki, program to "$GAMMA",
+ * @param[in] errors   – czy sprawdzić wyjście błędów zamiast standardowego,
+ * @param[in] expected – oczekiwane wyjście.
+ */
+static void check_pipeline_output(const char *input, const char *pipeline,
+  bool errors, const char *expected) {
+
+  char got[512];
+
+  assert(run_pipeline(input, pipeline, errors, got, sizeof(got)) == 0);
+  assert(strcmp(got, expected) == 0);
+}
+
+/** @brief Sprawdza wyjście programu gamma w trybie wsadowym.
+ * @param[in] input    – polecenia przekazywane na wejście programu,
+ *                       bez apostrofów,
+ * @param[in] errors   – czy sprawdzić wyjście błędów zamiast standardowego,
+ * @param[in] expected – oczekiwane wyjście.
+ */
+static void check_batch_output(const char *input, bool errors,
+  const char *expected) {
+
+  check_pipeline_output(input, "\"$GAMMA\"", errors, expected);
+}
+
+/** @brief Testuje wyjście polecenia s w trybie wsadowym.
+ * To ta sama rozgrywka co w test_player_stats na planszy 5x5.
+ */
+static void test_stats_command(void) {
+  check_batch_output(
+    "B 5 5 3 2\\nm 1 0 0\\nm 1 1 0\\nm 1 3 3\\nm 2 4 4\\ns\\n"
+    "g 3 1 0\\ns\\n", false,
+    "OK 1\n1\n1\n1\n1\n"
+    "1 3 7 2 0\n2 1 21 1 1\n3 0 21 0 1\n"
+    "1\n"
+    "1 2 5 2 1\n2 1 21 1 1\n3 1 21 1 0\n");
+}
+
+/** @brief Testuje wyjście polecenia c w trybie wsadowym.
+ * Czasy wywołań są różne przy każdym uruchomieniu, więc sprawdzamy tylko
+ * liczby wywołań i pozostałe liczniki. Bez GAMMA_STATS polecenie jest
+ * błędne.
+ */
+static void test_counters_command(void) {
+  static const char input[] =
+    "B 5 5 2 2\\nm 1 0 0\\nm 1 2 0\\nm 1 1 0\\nq 2\\nc\\n";
+#ifdef GAMMA_STATS
+  static const char prefix[] = "OK 1\n1\n1\n1\n1\ncall gamma_move 3 ";
+  char got[4096];
+
+  run_batch(input, false, got, sizeof(got));
+  assert(strncmp(got, prefix, sizeof(prefix) - 1) == 0);
+  assert(strstr(got, "\ncall gamma_golden_move 0 0\n") != NULL);
+  assert(strstr(got, "\ncall gamma_golden_possible 1 ") != NULL);
+  assert(strstr(got, "\ncall gamma_board 0 0\n") != NULL);
+  assert(strstr(got, "\nfind_depth 15 0\n") != NULL);
+  assert(strstr(got, "\nunions 2\nsplit_rebuilds ") != NULL);
+  assert(strstr(got, "\ngolden_scan_cells ") != NULL);
+#else
+  check_batch_output(input, false, "OK 1\n1\n1\n1\n1\n");
+  check_batch_output(input, true, "ERROR 6\n");
+#endif
+}
+
+/**
+ * Skrypt testu formatu binarnego: komentarz, pusta linijka, błędna linijka
+ * i wszystkie polecenia trybu wsadowego, które nie zależą od czasu.
+ */
+#define BINARY_SCRIPT \
+  "# gra\\n\\nB 5 5 2 2\\nm 1 0 0\\nx\\nm 1 1 0\\ng 2 1 0\\nb 1\\nf 2\\n" \
+  "q 1\\np\\ns\\n"
+
+/** @brief Testuje binarny format skryptów.
+ * Skrypt zamieniony przez -e i z powrotem przez -d daje te same wyniki co
+ * tekstowy, a tryb -b wykonuje go bez błędów. Komentarz i pusta linijka nie
+ * trafiają do skryptu binarnego, więc polecenie B z linijki 3 ma numer 1,
+ * a błędna linijka 5 staje się rekordem 3. Ucięty ostatni rekord i błędny
+ * nagłówek są zgłaszane jako błędy.
+ */
+static void test_binary_script(void) {
+  char text[512];
+  char got[512];
+
+  run_batch(BINARY_SCRIPT, false, text, sizeof(text));
+  assert(run_pipeline(BINARY_SCRIPT,
+    "\"$GAMMA\" -e | \"$GAMMA\" -d | \"$GAMMA\"", false, got,
+    sizeof(got)) == 0);
+  assert(strncmp(text, "OK 3\n", 5) == 0);
+  assert(strncmp(got, "OK 1\n", 5) == 0);
+  assert(strcmp(got + 5, text + 5) == 0);
+
+  check_batch_output(BINARY_SCRIPT, true, "ERROR 5\n");
+  check_pipeline_output(BINARY_SCRIPT,
+    "\"$GAMMA\" -e | \"$GAMMA\" -d | \"$GAMMA\"", true, "ERROR 3\n");
+  check_pipeline_output(BINARY_SCRIPT, "\"$GAMMA\" -e | \"$GAMMA\" -b", true,
+    "");
+
+  // nagłówek ma 20 bajtów, a rekordy po 16, więc 45 bajtów to nagłówek,
+  // pierwszy rekord i początek drugiego
+  static const char truncated[] = "B 5 5 2 2\\nm 1 0 0\\nm 2 1 1\\n";
+  check_pipeline_output(truncated,
+    "\"$GAMMA\" -e | head -c 45 | \"$GAMMA\" -b", false, "\001");
+  check_pipeline_output(truncated,
+    "\"$GAMMA\" -e | head -c 45 | \"$GAMMA\" -b", true, "ERROR 3\n");
+  check_pipeline_output(truncated,
+    "\"$GAMMA\" -e | head -c 45 | \"$GAMMA\" -d | \"$GAMMA\"", true,
+    "ERROR 3\n");
+
+  // błędny znacznik formatu i za krótki nagłówek
+  static const char *headers[] = {
+    "GMB2                    ", "GMB1", ""
+  };
+  for (size_t i = 0; i < sizeof(headers) / sizeof(headers[0]); i++) {
+    assert(run_pipeline(headers[i], "\"$GAMMA\" -b", true, got,
+      sizeof(got)) == 1);
+    assert(strcmp(got, "ERROR 1\n") == 0);
+    assert(run_pipeline(headers[i], "\"$GAMMA\" -d", true, got,
+      sizeof(got)) == 1);
+    assert(strcmp(got, "ERROR 1\n") == 0);
+  }
+  // skrypt bez polecenia B nie ma nagłówka
+  assert(run_pipeline("m 1 0 0\\n", "\"$GAMMA\" -e", true, got,
+    sizeof(got)) == 1);
+  assert(strcmp(got, "ERROR 1\n") == 0);
+}
+
+/**
+ * Dwie gry z komentarzem między nimi i błędną linijką przed pierwszą grą.
+ */
+#define MULTI_GAME_SCRIPT \
+  "m 1 0 0\\nB 3 3 2 2\\nm 1 0 0\\nx\\nq 1\\n# druga gra\\n" \
+  "B 2 2 2 1\\nm 2 1 1\\nm 2 0 0\\nb 2\\n"
+
+/** @brief Testuje rozgrywanie wielu gier naraz w trybie -M.
+ * Każda gra numeruje OK i ERROR linijkami całego wejścia, a wyniki gier
+ * są wypisywane w kolejności wejścia, także gdy pierwsza gra ma błędy.
+ */
+static void test_multi_game(void) {
+  check_pipeline_output(MULTI_GAME_SCRIPT, "\"$GAMMA\" -M", false,
+    "OK 2\n1\n0\nOK 7\n1\n0\n1\n");
+  check_pipeline_output(MULTI_GAME_SCRIPT, "\"$GAMMA\" -M", true,
+    "ERROR 1\nERROR 4\n");
+}
+#endif
+
+/** @brief Testuje liczniki wewnętrzne silnika.
+ * Ruch na pole (1, 0) łączy dwa obszary gracza 1 z nowym polem, co daje
+ * dwa połączenia. Bez GAMMA_STATS liczniki są zawsze zerami.
+ */
+static void test_stats(void) {
+  gamma_stats_t stats;
+  gamma_stats_t zero;
+
+  memset(&zero, 0, sizeof(zero));
+  assert(!gamma_stats(NULL, &stats));
+
+  gamma_t *g = gamma_new(5, 5, 2, 2);
+  assert(g != NULL);
+  assert(!gamma_stats(g, NULL));
+
+#ifdef GAMMA_STATS
+  assert(gamma_stats(g, &stats));
+  assert(memcmp(&stats, &zero, sizeof(stats)) == 0);
+
+  assert(gamma_move(g, 1, 0, 0));
+  assert(gamma_move(g, 1, 2, 0));
+  assert(gamma_move(g, 1, 1, 0));
+  assert(!gamma_move(g, 2, 1, 0));
+  assert(gamma_busy_fields(g, 1) == 3);
+  assert(gamma_golden_possible(g, 2));
+
+  assert(gamma_stats(g, &stats));
+  assert(stats.calls[GAMMA_CALL_MOVE] == 4);
+  assert(stats.calls[GAMMA_CALL_BUSY_FIELDS] == 1);
+  assert(stats.calls[GAMMA_CALL_GOLDEN_POSSIBLE] == 1);
+  assert(stats.calls[GAMMA_CALL_GOLDEN_MOVE] == 0);
+  assert(stats.unions == 2);
+
+  uint64_t finds = 0;
+  for (uint32_t i = 0; i < GAMMA_STATS_FIND_DEPTHS; i++) {
+    finds += stats.find_depth[i];
+  }
+  assert(finds > 0);
+
+  gamma_stats_reset(g);
+  assert(gamma_stats(g, &stats));
+  assert(memcmp(&stats, &zero, sizeof(stats)) == 0);
+
+  // po wyzerowaniu liczniki liczą od nowa
+  assert(gamma_golden_move(g, 2, 1, 0));
+  assert(gamma_stats(g, &stats));
+  assert(stats.calls[GAMMA_CALL_GOLDEN_MOVE] == 1);
+  assert(stats.calls[GAMMA_CALL_MOVE] == 0);
+#else
+  assert(gamma_move(g, 1, 0, 0));
+  gamma_stats_reset(g);
+  assert(!gamma_stats(g, &stats));
+  assert(memcmp(&stats, &zero, sizeof(stats)) == 0);
+#endif
+  gamma_stats_reset(NULL);
+  gamma_delete(g);
+}
+
+#ifdef GAMMA_TRACE
+/**
+ * Największa liczba wątków i zagnieżdżonych zdarzeń w teście śladu.
+ */
+#define TRACE_DEPTH 16
+
+/** @brief Wykonuje ruchy w drugim wątku, żeby ślad miał dwa bufory.
+ * @param[in] arg     – wskaźnik na grę.
+ * @return Wartość NULL.
+ */
+static void* trace_thread(void *arg) {
+  gamma_t *g = arg;
+
+  assert(gamma_move(g, 2, 4, 4));
+  assert(gamma_golden_possible(g, 2));
+  return NULL;
+}
+#endif
+
+/** @brief Testuje zapis śladu operacji.
+ * Ruchy, złoty ruch, zapytanie i wypisanie planszy wykonują dwa wątki,
+ * a potem zapisujemy ślad do pliku tymczasowego i sprawdzamy, że w każdym
+ * wątku zdarzenia początku i końca tworzą poprawnie zagnieżdżone pary
+ * o tych samych nazwach. Test musi zostać wywołany, zanim bufory wątków
+ * się zapełnią. Bez GAMMA_TRACE zapis śladu zawsze się nie udaje.
+ */
+static void test_trace(void) {
+  char path[] = "/tmp/gamma_trace_XXXXXX";
+  int fd = mkstemp(path);
+  assert(fd >= 0);
+  close(fd);
+
+#ifdef GAMMA_TRACE
+  gamma_t *g = gamma_new(5, 5, 2, 2);
+  assert(g != NULL);
+  assert(gamma_move(g, 1, 0, 0));
+  assert(gamma_move(g, 1, 2, 0));
+
+  pthread_t thread;
+  assert(pthread_create(&thread, NULL, trace_thread, g) == 0);
+  assert(pthread_join(thread, NULL) == 0);
+
+  assert(gamma_golden_move(g, 2, 0, 0));
+  assert(gamma_golden_possible(g, 1));
+  char *p = gamma_board(g);
+  assert(p != NULL);
+  free(p);
+  gamma_delete(g);
+
+  assert(gamma_trace_dump(path));
+  FILE *file = fopen(path, "r");
+  assert(file != NULL);
+
+  char names[TRACE_DEPTH][TRACE_DEPTH][32];
+  uint32_t depth[TRACE_DEPTH] = { 0 };
+  bool seen[TRACE_DEPTH] = { false };
+  uint64_t pairs = 0;
+  char line[512];
+  assert(fgets(line, sizeof(line), file) != NULL);
+  assert(strncmp(line, "{\"displayTimeUnit\"", 18) == 0);
+  while (fgets(line, sizeof(line), file) != NULL) {
+    char name[32];
+    char phase;
+    unsigned tid;
+
+    if (strcmp(line, "]}\n") == 0) {
+      break;
+    }
+    const char *tid_at = strstr(line, "\"tid\":");
+    assert(tid_at != NULL);
+    assert(sscanf(line, "{\"name\":\"%31[^\"]\",\"ph\":\"%c\"", name,
+      &phase) == 2);
+    assert(sscanf(tid_at, "\"tid\":%u", &tid) == 1);
+    assert(tid > 0 && tid <= TRACE_DEPTH);
+
+    seen[tid - 1] = true;
+    uint32_t *level = &depth[tid - 1];
+    if (phase == 'B') {
+      assert(*level < TRACE_DEPTH);
+      strcpy(names[tid - 1][(*level)++], name);
+    }
+    else {
+      assert(phase == 'E');
+      assert(*level > 0);
+      assert(strcmp(names[tid - 1][--(*level)], name) == 0);
+      pairs++;
+    }
+  }
+  assert(strcmp(line, "]}\n") == 0);
+  fclose(file);
+
+  uint32_t threads = 0;
+  for (uint32_t i = 0; i < TRACE_DEPTH; i++) {
+    assert(depth[i] == 0);
+    threads += seen[i] ? 1 : 0;
+  }
+  // cztery ruchy, dwa zapytania i plansza, nie licząc zagnieżdżonych
+  assert(pairs >= 7);
+  assert(threads >= 2);
+#else
+  assert(!gamma_trace_dump(path));
+#endif
+  remove(path);
+}
+
+/** @brief Daje kolejną liczbę pseudolosową.
+ * @param[in,out] state – stan generatora.
+ * @return Liczba pseudolosowa.
+ */
+static uint32_t next_random(uint64_t *state) {
+  *state = *state * 6364136223846793005u + 1442695040888963407u;
+  return (uint32_t)(*state >> 33);
+}
+
+/** @brief Wykonuje pseudolosowy ruch lub złoty ruch w lewym dolnym rogu
+ * planszy o boku @p side.
+ * @param[in,out] g     – wskaźnik na strukturę przechowującą stan gry,
+ * @param[in,out] state – stan generatora,
+ * @param[in] players   – liczba graczy,
+ * @param[in] side      – bok zajmowanego kwadratu.
+ */
+static void random_move(gamma_t *g, uint64_t *state, uint32_t players,
+  uint32_t side) {
+
+  uint32_t player = next_random(state) % players + 1;
+  uint32_t x = next_random(state) % side;
+  uint32_t y = next_random(state) % side;
+
+  if (next_random(state) % 16 == 0) {
+    gamma_golden_move(g, player, x, y);
+  }
+  else {
+    gamma_move(g, player, x, y);
+  }
+}
+
+/** @brief Testuje zapytania tylko do odczytu z pamięcią roboczą wywołującego.
+ * Po każdym ruchu porównuje odpowiedzi gamma_query_* z odpowiedziami
+ * zwykłych funkcji, z tą samą pamięcią roboczą dla wszystkich zapytań
+ * i bez niej.
+ * @param[in] width   – szerokość planszy, co najmniej 6,
+ * @param[in] height  – wysokość planszy, co najmniej 6.
+ */
+static void test_query(uint32_t width, uint32_t height) {
+  bool small = (uint64_t)width * height <= 1000;
+  uint64_t state = 2020;
+  gamma_scratch_t *scratch = gamma_scratch_new();
+  gamma_t *g = gamma_new(width, height, 3, 2);
+  assert(scratch != NULL && g != NULL);
+
+  assert(gamma_query_busy_fields(NULL, 1) == 0);
+  assert(gamma_query_free_fields(NULL, 1) == 0);
+  assert(!gamma_query_golden_possible(NULL, 1, scratch));
+  assert(gamma_query_board(NULL) == NULL);
+  assert(gamma_query_busy_fields(g, 4) == 0);
+  assert(gamma_query_free_fields(g, 0) == 0);
+  assert(!gamma_query_golden_possible(g, 0, scratch));
+  assert(!gamma_query_golden_possible(g, 4, scratch));
+
+  for (uint32_t step = 0; step < 400; step++) {
+    random_move(g, &state, 3, 6);
+    for (uint32_t player = 1; player <= 3; player++) {
+      assert(gamma_query_busy_fields(g, player) ==
+        gamma_busy_fields(g, player));
+      assert(gamma_query_free_fields(g, player) ==
+        gamma_free_fields(g, player));
+      // zapytanie bez zapamiętanej odpowiedzi, potem z nią
+      bool possible = gamma_query_golden_possible(g, player, scratch);
+      assert(gamma_golden_possible(g, player) == possible);
+      assert(gamma_query_golden_possible(g, player, scratch) == possible);
+      assert(gamma_query_golden_possible(g, player, NULL) == possible);
+    }
+    if (small) {
+      char *expected = gamma_board(g);
+      char *got = gamma_query_board(g);
+      assert(expected != NULL && got != NULL);
+      assert(strcmp(expected, got) == 0);
+      free(expected);
+      free(got);
+    }
+  }
+  gamma_delete(g);
+  gamma_scratch_delete(scratch);
+}
+
+/**
+ * Liczba wątków w teście zapytań współbieżnych.
+ */
+#define QUERY_THREADS 4
+
+/**
+ * Liczba graczy w teście zapytań współbieżnych.
+ */
+#define QUERY_PLAYERS 4
+
+/**
+ * Stan gry i oczekiwane odpowiedzi dzielone przez wątki zapytań.
+ */
+typedef struct query_round {
+  gamma_t *g;                           ///< gra, o którą pytają wątki
+  bool expected[QUERY_PLAYERS];         ///< oczekiwane odpowiedzi
+  pthread_barrier_t start;              ///< wspólny start wątków
+} query_round_t;
+
+/**
+ * Zadanie jednego wątku zapytań.
+ */
+typedef struct query_task {
+  query_round_t *round;                 ///< wspólny stan rundy
+  uint32_t first;                       ///< gracz, od którego wątek zaczyna
+} query_task_t;
+
+/** @brief Pyta o złoty ruch wszystkich graczy i sprawdza odpowiedzi.
+ * @param[in] arg     – wskaźnik na strukturę query_task_t.
+ * @return Wartość NULL.
+ */
+static void* query_thread(void *arg) {
+  const query_task_t *task = arg;
+  query_round_t *round = task->round;
+  gamma_scratch_t *scratch = gamma_scratch_new();
+  assert(scratch != NULL);
+
+  pthread_barrier_wait(&round->start);
+  for (uint32_t i = 0; i < QUERY_PLAYERS; i++) {
+    uint32_t player = (task->first + i) % QUERY_PLAYERS + 1;
+
+    assert(gamma_golden_possible(round->g, player) ==
+      round->expected[player - 1]);
+    assert(gamma_query_golden_possible(round->g, player, scratch) ==
+      round->expected[player - 1]);
+  }
+  gamma_scratch_delete(scratch);
+  return NULL;
+}
+
+/** @brief Testuje zapytania o złoty ruch wielu wątków naraz.
+ * Gracze 1 i 2 mają sąsiadujące kwadraty, gracz 3 pojedyncze pole obok
+ * środka pionowej linii gracza 4, a limit obszarów wynosi 1. Tylko gracza 4
+ * rozstrzyga poziom 2, więc wątki zaczynające od różnych graczy jednocześnie
+ * potrzebują indeksu punktów artykulacji albo liczą kawałki w pamięci
+ * roboczej. Każda runda zaczyna od nowej gry.
+ */
+static void test_concurrent_queries(void) {
+  const uint32_t side = 32;
+  query_round_t round = { .expected = { true, true, false, true } };
+  query_task_t tasks[QUERY_THREADS];
+  pthread_t threads[QUERY_THREADS];
+
+  assert(pthread_barrier_init(&round.start, NULL, QUERY_THREADS) == 0);
+  for (uint32_t step = 0; step < 200; step++) {
+    round.g = gamma_new(2 * side, side + 4, QUERY_PLAYERS, 1);
+    assert(round.g != NULL);
+    gamma_set_threads(round.g, QUERY_THREADS);
+    for (uint32_t y = 0; y < side; y++) {
+      for (uint32_t x = 0; x < side; x++) {
+        assert(gamma_move(round.g, 1, x, y));
+        assert(gamma_move(round.g, 2, side + x, y));
+      }
+    }
+    assert(gamma_move(round.g, 3, 1, side + 2));
+    for (uint32_t y = side + 1; y < side + 4; y++) {
+      assert(gamma_move(round.g, 4, 2, y));
+    }
+    for (uint32_t i = 0; i < QUERY_THREADS; i++) {
+      tasks[i] = (query_task_t){ &round, i };
+      assert(pthread_create(&threads[i], NULL, query_thread, &tasks[i]) == 0);
+    }
+    for (uint32_t i = 0; i < QUERY_THREADS; i++) {
+      assert(pthread_join(threads[i], NULL) == 0);
+    }
+    // każde zapytanie rozstrzygnął dokładnie jeden poziom
+    uint64_t hits = 0;
+    for (uint32_t tier = 0; tier < GAMMA_GOLDEN_TIERS; tier++) {
+      hits += return_golden_tier_hits(round.g, tier);
+    }
+    assert(hits == QUERY_THREADS * QUERY_PLAYERS);
+    gamma_delete(round.g);
+  }
+  pthread_barrier_destroy(&round.start);
+}
+
+/**
+ * Bok planszy w teście wątków pomocniczych; lista kandydatów gracza ma
+ * wtedy ponad milion pól.
+ */
+#define POOL_SIDE 1024
+
+/** @brief Testuje przeglądanie kandydatów przez wątki pomocnicze.
+ * Gracze 1 i 2 mają na przemian po 512 kolumn przy limicie 512 obszarów.
+ * Zabranie pola ze środka cudzej kolumny ją rozcina, więc złoty ruch daje
+ * tylko pole z pierwszego lub ostatniego wiersza. Te wiersze wypełniamy na
+ * końcu, więc takie pola leżą na końcu list kandydatów i znajduje je
+ * ostatni wątek pomocniczy. Wynik porównujemy z zapytaniem tylko do
+ * odczytu, które przegląda kandydatów w jednym wątku.
+ */
+static void test_scan_pool(void) {
+  gamma_t *g = gamma_new(POOL_SIDE, POOL_SIDE, 2, POOL_SIDE / 2);
+  assert(g != NULL);
+  gamma_set_threads(g, 4);
+
+  for (uint32_t x = 0; x < POOL_SIDE; x++) {
+    for (uint32_t y = 1; y + 1 < POOL_SIDE; y++) {
+      assert(gamma_move(g, 1 + x % 2, x, y));
+    }
+  }
+  for (uint32_t y = 0; y < POOL_SIDE; y += POOL_SIDE - 1) {
+    for (uint32_t x = 0; x < POOL_SIDE; x++) {
+      assert(gamma_move(g, 1 + x % 2, x, y));
+    }
+  }
+
+  for (uint32_t player = 1; player <= 2; player++) {
+    assert(gamma_golden_possible(g, player));
+    assert(gamma_query_golden_possible(g, player, NULL));
+  }
+  assert(return_golden_tier_hits(g, 2) == 2);
+
+  // zmiana liczby wątków tworzy pulę od nowa przy następnym przeglądaniu
+  gamma_set_threads(g, 3);
+  assert(gamma_golden_move(g, 1, 1, 0));
+  assert(!gamma_golden_possible(g, 1));
+  assert(gamma_golden_possible(g, 2));
+  assert(gamma_query_golden_possible(g, 2, NULL));
+  gamma_delete(g);
+}
+
+/** @brief Testuje liczniki poziomów sprawdzania złotego ruchu.
+ * Każde zapytanie rozstrzyga dokładnie jeden poziom, a jego licznik rośnie
+ * o jeden.
+ * @param[in] width   – szerokość planszy, co najmniej 5,
+ * @param[in] height  – wysokość planszy, co najmniej 5.
+ */
+static void test_golden_tiers(uint32_t width, uint32_t height) {
+  gamma_t *g = gamma_new(width, height, 2, 1);
+  uint64_t expected[GAMMA_GOLDEN_TIERS] = {0};
+  assert(g != NULL);
+
+  // poziom 0: na planszy nie ma cudzych pionków
+  assert(!gamma_golden_possible(g, 1));
+  expected[0]++;
+
+  // gracz 2 ma kwadrat 2x2 obok pola gracza 1; zabranie jego rogu ma
+  // dwóch sąsiadów, więc poziom 2 nie rozstrzyga, a poziom 3 tak
+  assert(gamma_move(g, 1, 1, 0));
+  assert(gamma_move(g, 2, 3, 0));
+  assert(gamma_move(g, 2, 3, 1));
+  assert(gamma_move(g, 2, 2, 1));
+  assert(gamma_move(g, 2, 2, 0));
+  assert(gamma_golden_possible(g, 1));
+  expected[3]++;
+
+  // poziom 1: plansza się nie zmieniła
+  assert(gamma_golden_possible(g, 1));
+  expected[1]++;
+
+  // poziom 2: pojedyncze pole gracza 1 można zabrać bez rozcinania
+  assert(gamma_golden_possible(g, 2));
+  expected[2]++;
+
+  for (uint32_t tier = 0; tier < GAMMA_GOLDEN_TIERS; tier++) {
+    assert(return_golden_tier_hits(g, tier) == expected[tier]);
+  }
+  assert(return_golden_tier_hits(g, GAMMA_GOLDEN_TIERS) == 0);
+  assert(return_golden_tier_hits(NULL, 0) == 0);
+  gamma_delete(g);
+}
+
+/**
+ * Największa liczba pól planszy w teście wyczerpującym.
+ */
+#define MODEL_FIELDS 9
+
+/**
+ * Największa liczba graczy w teście wyczerpującym.
+ */
+#define MODEL_PLAYERS 3
+
+/**
+ * Prosty model gry do sprawdzania silnika metodą siłową.
+ */
+typedef struct {
+  uint32_t width;                 ///< szerokość planszy
+  uint32_t height;                ///< wysokość planszy
+  uint32_t players;               ///< liczba graczy
+  uint32_t areas;                 ///< maksymalna liczba obszarów gracza
+  uint32_t owner[MODEL_FIELDS];   ///< numer gracza na polu albo 0
+  bool golden[MODEL_PLAYERS];     ///< czy gracz wykonał już złoty ruch
+} model_t;
+
+/** @brief Liczy obszary gracza w modelu przeszukiwaniem w głąb.
+ * @param[in] m       – wskaźnik na model gry,
+ * @param[in] player  – numer gracza.
+ * @return Liczba obszarów gracza.
+ */
+static uint32_t model_areas(const model_t *m, uint32_t player) {
+  uint32_t fields = m->width * m->height;
+  bool seen[MODEL_FIELDS] = {false};
+  uint32_t stack[MODEL_FIELDS];
+  uint32_t areas = 0;
+
+  for (uint32_t start = 0; start < fields; start++) {
+    if (m->owner[start] != player || seen[start]) {
+      continue;
+    }
+    areas++;
+    uint32_t top = 0;
+    seen[start] = true;
+    stack[top++] = start;
+    while (top > 0) {
+      uint32_t field = stack[--top];
+      uint32_t x = field % m->width;
+      uint32_t y = field / m->width;
+      uint32_t next[4];
+      uint32_t count = 0;
+
+      if (x != 0) {
+        next[count++] = field - 1;
+      }
+      if (x != m->width - 1) {
+        next[count++] = field + 1;
+      }
+      if (y != 0) {
+        next[count++] = field - m->width;
+      }
+      if (y != m->height - 1) {
+        next[count++] = field + m->width;
+      }
+      for (uint32_t i = 0; i < count; i++) {
+        if (m->owner[next[i]] == player && !seen[next[i]]) {
+          seen[next[i]] = true;
+          stack[top++] = next[i];
+        }
+      }
+    }
+  }
+  return areas;
+}
+
+/** @brief Sprawdza w modelu, czy gracz może zająć pole zwykłym ruchem.
+ * @param[in] m       – wskaźnik na model gry,
+ * @param[in] player  – numer gracza,
+ * @param[in] field   – numer pola.
+ * @return Wartość @p true, jeśli ruch jest legalny.
+ */
+static bool model_move_ok(const model_t *m, uint32_t player, uint32_t field) {
+  if (m->owner[field] != 0) {
+    return false;
+  }
+  model_t after = *m;
+  after.owner[field] = player;
+  return model_areas(&after, player) <= m->areas;
+}
+
+/** @brief Sprawdza w modelu, czy gracz może zabrać pole złotym ruchem.
+ * @param[in] m       – wskaźnik na model gry,
+ * @param[in] player  – numer gracza,
+ * @param[in] field   – numer pola.
+ * @return Wartość @p true, jeśli złoty ruch jest legalny.
+ */
+static bool model_golden_ok(const model_t *m, uint32_t player,
+  uint32_t field) {
+
+  uint32_t robbed = m->owner[field];
+  if (m->golden[player - 1] || robbed == 0 || robbed == player) {
+    return false;
+  }
+  model_t after = *m;
+  after.owner[field] = player;
+  return model_areas(&after, player) <= m->areas &&
+    model_areas(&after, robbed) <= m->areas;
+}
+
+/** @brief Sprawdza w modelu, czy gracz ma jakikolwiek legalny złoty ruch.
+ * @param[in] m       – wskaźnik na model gry,
+ * @param[in] player  – numer gracza.
+ * @return Wartość @p true, jeśli gracz może wykonać złoty ruch.
+ */
+static bool model_golden_possible(const model_t *m, uint32_t player) {
+  for (uint32_t field = 0; field < m->width * m->height; field++) {
+    if (model_golden_ok(m, player, field)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/** @brief Tworzy grę o stanie planszy z modelu.
+ * Pola każdego obszaru zajmuje w kolejności przeszukiwania w głąb, więc
+ * gracz nigdy chwilowo nie przekracza limitu obszarów.
+ * @param[in] m       – wskaźnik na model gry bez wykonanych złotych ruchów.
+ * @return Wskaźnik na nową grę.
+ */
+static gamma_t *model_game(const model_t *m) {
+  uint32_t fields = m->width * m->height;
+  bool placed[MODEL_FIELDS] = {false};
+  uint32_t stack[MODEL_FIELDS];
+  gamma_t *g = gamma_new(m->width, m->height, m->players, m->areas);
+  assert(g != NULL);
+
+  for (uint32_t start = 0; start < fields; start++) {
+    uint32_t player = m->owner[start];
+    if (player == 0 || placed[start]) {
+      continue;
+    }
+    uint32_t top = 0;
+    placed[start] = true;
+    stack[top++] = start;
+    while (top > 0) {
+      uint32_t field = stack[--top];
+      uint32_t x = field % m->width;
+      uint32_t y = field / m->width;
+
+      assert(gamma_move(g, player, x, y));
+      for (uint32_t other = 0; other < fields; other++) {
+        uint32_t ox = other % m->width;
+        uint32_t oy = other / m->width;
+        bool adjacent = (ox == x && (oy + 1 == y || y + 1 == oy)) ||
+          (oy == y && (ox + 1 == x || x + 1 == ox));
+        if (adjacent && m->owner[other] == player && !placed[other]) {
+          placed[other] = true;
+          stack[top++] = other;
+        }
+      }
+    }
+  }
+  return g;
+}
+
+/** @brief Porównuje odpowiedź silnika z modelem dla wszystkich graczy.
+ * @param[in] g       – wskaźnik na stan gry,
+ * @param[in] m       – wskaźnik na model tej samej gry.
+ */
+static void check_golden_possible(gamma_t *g, const model_t *m) {
+  for (uint32_t player = 1; player <= m->players; player++) {
+    assert(gamma_golden_possible(g, player) ==
+      model_golden_possible(m, player));
+  }
+}
+
+/** @brief Sprawdza wyczerpująco @ref gamma_golden_possible na małej planszy.
+ * Przechodzi po wszystkich osiągalnych planszach i limitach obszarów.
+ * Porównuje odpowiedź z zimną pamięcią podręczną, z ciepłą oraz po
+ * dowolnym jednym ruchu lub złotym ruchu wykonanym przy ciepłej pamięci.
+ * @param[in] width   – szerokość planszy,
+ * @param[in] height  – wysokość planszy,
+ * @param[in] players – liczba graczy.
+ */
+static void test_golden_exhaustive(uint32_t width, uint32_t height,
+  uint32_t players) {
+
+  uint32_t fields = width * height;
+  uint64_t boards = 1;
+  assert(fields <= MODEL_FIELDS && players <= MODEL_PLAYERS);
+  for (uint32_t i = 0; i < fields; i++) {
+    boards *= players + 1;
+  }
+
+  for (uint32_t areas = 1; areas <= 3; areas++) {
+    for (uint64_t code = 0; code < boards; code++) {
+      model_t m = {width, height, players, areas, {0}, {false}};
+      uint64_t rest = code;
+      bool reachable = true;
+
+      for (uint32_t i = 0; i < fields; i++) {
+        m.owner[i] = rest % (players + 1);
+        rest /= players + 1;
+      }
+      for (uint32_t player = 1; player <= players; player++) {
+        if (model_areas(&m, player) > areas) {
+          reachable = false;
+        }
+      }
+      if (!reachable) {
+        continue;
+      }
+
+      gamma_t *g = model_game(&m);
+      check_golden_possible(g, &m);
+      check_golden_possible(g, &m);
+      gamma_delete(g);
+
+      for (uint32_t field = 0; field < fields; field++) {
+        for (uint32_t player = 1; player <= players; player++) {
+          model_t after = m;
+          uint32_t x = field % width;
+          uint32_t y = field / width;
+          bool legal;
+
+          g = model_game(&m);
+          check_golden_possible(g, &m);
+          if (m.owner[field] == 0) {
+            legal = model_move_ok(&m, player, field);
+            assert(gamma_move(g, player, x, y) == legal);
+          }
+          else {
+            legal = model_golden_ok(&m, player, field);
+            assert(gamma_golden_move(g, player, x, y) == legal);
+            after.golden[player - 1] = legal;
+          }
+          if (legal) {
+            after.owner[field] = player;
+          }
+          check_golden_possible(g, &after);
+          gamma_delete(g);
+        }
+      }
+    }
+  }
+}
+
 /** @brief Testuje silnik gry gamma.
  * Przeprowadza przykładowe testy silnika gry gamma.
  * @return Zero, gdy wszystkie testy przebiegły poprawnie,
@@ -94,5 +1389,34 @@ int main() {
   free(p);
 
   gamma_delete(g);
+
+  test_trace();
+  test_sparse();
+  test_golden_rollback(5, 5);
+  test_golden_rollback(100000, 100000);
+  test_steal_split(5, 5);
+  test_steal_split(100000, 100000);
+  test_apply_moves(3, 3);
+  test_apply_moves(100000, 100000);
+  test_player_stats(5, 5);
+  test_player_stats(100000, 100000);
+  test_player_stats_range(5, 5);
+  test_player_stats_range(100000, 100000);
+#ifdef GAMMA_BINARY
+  test_stats_command();
+  test_counters_command();
+  test_binary_script();
+  test_multi_game();
+#endif
+  test_stats();
+  test_query(6, 6);
+  test_query(100000, 100000);
+  test_concurrent_queries();
+  test_scan_pool();
+  test_golden_tiers(5, 5);
+  test_golden_tiers(100000, 100000);
+  test_golden_exhaustive(3, 3, 2);
+  test_golden_exhaustive(3, 2, 3);
+  test_golden_exhaustive(1, 5, 3);
   return 0;
 }